@@ -333,6 +333,9 @@ public:
   inline void writeTCell(ldat len, dat x, dat y, ldat Len, const tcell *Attr) const {
     TwWriteTCellWindow(Id, x, y, Len, Attr);
   }
+  inline void appendRows(ldat len, const trune *text) const {
+    TwAppendRowsWindow(Id, len, text);
+  }
   /* backward compatibility. will be removed */
   inline void writeRow(const char *text) const {
     writeAscii(text);
@@ -144,6 +144,7 @@
 #define TW_WINDOWFL_ROWS_INSERT 0x0100
 #define TW_WINDOWFL_ROWS_DEFCOL 0x0200
 #define TW_WINDOWFL_ROWS_SELCURRENT 0x0400
+#define TW_WINDOWFL_BACKSTORE 0x1000
 
 #define TW_WINDOWFL_NOTVISIBLE TW_WIDGETFL_NOTVISIBLE
 
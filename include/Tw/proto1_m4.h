@@ -83,6 +83,7 @@
 #define TwWriteStringWindow(a1, a2, a3)		Tw_WriteStringWindow(Tw_DefaultD, a1, a2, a3)
 #define TwWriteTRuneWindow(a1, a2, a3)		Tw_WriteTRuneWindow(Tw_DefaultD, a1, a2, a3)
 #define TwWriteTCellWindow(a1, a2, a3, a4, a5)		Tw_WriteTCellWindow(Tw_DefaultD, a1, a2, a3, a4, a5)
+#define TwAppendRowsWindow(a1, a2, a3)		Tw_AppendRowsWindow(Tw_DefaultD, a1, a2, a3)
 
 #define TwGotoXYWindow(a1, a2, a3)		Tw_GotoXYWindow(Tw_DefaultD, a1, a2, a3)
 #define TwSetTitleWindow(a1, a2, a3)		Tw_SetTitleWindow(Tw_DefaultD, a1, a2, a3)
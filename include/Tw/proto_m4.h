@@ -112,6 +112,9 @@ void  Tw_WriteStringWindow(tdisplay TwD, twindow W, uldat len, TW_CONST char *st
 void  Tw_WriteTRuneWindow(tdisplay TwD, twindow W, uldat len, TW_CONST trune *textfont);
 void  Tw_WriteTCellWindow(tdisplay TwD, twindow W, dat x, dat y, uldat len, TW_CONST tcell *textattr);
 
+/** append the newline-separated lines in textfont after the last row of a row window */
+void  Tw_AppendRowsWindow(tdisplay TwD, twindow W, uldat len, TW_CONST trune *textfont);
+
 void  Tw_GotoXYWindow(tdisplay TwD, twindow W, ldat x, ldat y);
 void  Tw_SetTitleWindow(tdisplay TwD, twindow W, dat titlelen, TW_CONST char *title);
 void  Tw_SetColTextWindow(tdisplay TwD, twindow W, tcolor coltext);
@@ -60,6 +60,19 @@
 #endif
 #endif
 
+/*
+ * thread-local variables. the globals used by display drivers are declared THREAD_LOCAL
+ * so that their FlushVideo() can run on a worker thread, see hw_multi.c
+ */
+#ifndef THREAD_LOCAL
+#if defined(__GNUC__) && defined(TW_HAVE_PTHREAD_H) && defined(TW_HAVE_PTHREAD_CREATE)
+#define THREAD_LOCAL __thread
+#define HAVE_THREAD_LOCAL
+#else
+#define THREAD_LOCAL
+#endif
+#endif
+
 #ifndef EXTERN_C
 #ifdef __cplusplus
 #define EXTERN_C extern "C"
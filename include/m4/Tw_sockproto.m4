@@ -137,6 +137,8 @@ PROTO(void,v,  WriteAscii  ,Window,0, window,x,W, uldat,_,len, char,V(A(2)),asci
 PROTO(void,v,  WriteString ,Window,0, window,x,W, uldat,_,len, char,V(A(2)),string)
 PROTO(void,v,  WriteTRune, Window,0, window,x,W, uldat,_,len, trune,V(A(2)),textfont)
 PROTO(void,v,  WriteTCell ,Window,0, window,x,W,   dat,_,x, dat,_,y, uldat,_,len, tcell,V(A(4)),textattr)
+c_doxygen(/** append the newline-separated lines in textfont after the last row of a row window */)
+PROTO(void,v,  AppendRows ,Window,0, window,x,W, uldat,_,len, trune,V(A(2)),textfont)
 
 PROTO(void,v,        GotoXY,Window,2, window,x,W, ldat,_,x, ldat,_,y)
 PROTO(void,v,      SetTitle,Window,0, window,x,W, dat,_,titlelen, char,V(A(2)),title)
@@ -104,6 +104,8 @@ EL(WriteStringWindow)
 EL(WriteTRuneWindow)
 EL(WriteTCellWindow)
 
+EL(AppendRowsWindow)
+
 EL(GotoXYWindow)
 EL(SetTitleWindow)
 EL(SetColTextWindow)
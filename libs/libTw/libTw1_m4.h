@@ -139,6 +139,9 @@
 { Tw_WriteTCellWindow, 16,
 12, "Tw_WriteTCellWindow", "0" "v" TWS_void_STR"x" magic_id_STR(window)"_" TWS_dat_STR"_" TWS_dat_STR"_" TWS_uldat_STR"V" TWS_tcell_STR },
 
+{ Tw_AppendRowsWindow, 16,
+8, "Tw_AppendRowsWindow", "0" "v" TWS_void_STR"x" magic_id_STR(window)"_" TWS_uldat_STR"V" TWS_trune_STR },
+
 { Tw_GotoXYWindow, 12,
 8, "Tw_GotoXYWindow", "2" "v" TWS_void_STR"x" magic_id_STR(window)"_" TWS_ldat_STR"_" TWS_ldat_STR },
 { Tw_SetTitleWindow, 14,
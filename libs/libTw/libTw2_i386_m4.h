@@ -446,11 +446,22 @@ Tw_WriteTCellWindow:
 
 
 
+	.align 4
+.globl Tw_AppendRowsWindow
+	.type	 Tw_AppendRowsWindow,@function
+Tw_AppendRowsWindow:
+	pushl $37
+	jmp _Tw_i386_call_2
+.L_AppendRowsWindow:
+	.size	 Tw_AppendRowsWindow,.L_AppendRowsWindow-Tw_AppendRowsWindow
+
+
+
 	.align 4
 .globl Tw_GotoXYWindow
 	.type	 Tw_GotoXYWindow,@function
 Tw_GotoXYWindow:
-	pushl $37
+	pushl $38
 	jmp _Tw_i386_call_2
 .L_GotoXYWindow:
 	.size	 Tw_GotoXYWindow,.L_GotoXYWindow-Tw_GotoXYWindow
@@ -460,7 +471,7 @@ Tw_GotoXYWindow:
 .globl Tw_SetTitleWindow
 	.type	 Tw_SetTitleWindow,@function
 Tw_SetTitleWindow:
-	pushl $38
+	pushl $39
 	jmp _Tw_i386_call_2
 .L_SetTitleWindow:
 	.size	 Tw_SetTitleWindow,.L_SetTitleWindow-Tw_SetTitleWindow
@@ -470,7 +481,7 @@ Tw_SetTitleWindow:
 .globl Tw_SetColTextWindow
 	.type	 Tw_SetColTextWindow,@function
 Tw_SetColTextWindow:
-	pushl $39
+	pushl $40
 	jmp _Tw_i386_call_2
 .L_SetColTextWindow:
 	.size	 Tw_SetColTextWindow,.L_SetColTextWindow-Tw_SetColTextWindow
@@ -480,7 +491,7 @@ Tw_SetColTextWindow:
 .globl Tw_SetColorsWindow
 	.type	 Tw_SetColorsWindow,@function
 Tw_SetColorsWindow:
-	pushl $40
+	pushl $41
 	jmp _Tw_i386_call_2
 .L_SetColorsWindow:
 	.size	 Tw_SetColorsWindow,.L_SetColorsWindow-Tw_SetColorsWindow
@@ -490,7 +501,7 @@ Tw_SetColorsWindow:
 .globl Tw_ConfigureWindow
 	.type	 Tw_ConfigureWindow,@function
 Tw_ConfigureWindow:
-	pushl $41
+	pushl $42
 	jmp _Tw_i386_call_2
 .L_ConfigureWindow:
 	.size	 Tw_ConfigureWindow,.L_ConfigureWindow-Tw_ConfigureWindow
@@ -500,23 +511,13 @@ Tw_ConfigureWindow:
 .globl Tw_FindRowByCodeWindow
 	.type	 Tw_FindRowByCodeWindow,@function
 Tw_FindRowByCodeWindow:
-	pushl $42
+	pushl $43
 	jmp _Tw_i386_call_0
 .L_FindRowByCodeWindow:
 	.size	 Tw_FindRowByCodeWindow,.L_FindRowByCodeWindow-Tw_FindRowByCodeWindow
 
 
 
-	.align 4
-.globl Tw_CreateGroup
-	.type	 Tw_CreateGroup,@function
-Tw_CreateGroup:
-	pushl $43
-	jmp _Tw_i386_call_0
-.L_CreateGroup:
-	.size	 Tw_CreateGroup,.L_CreateGroup-Tw_CreateGroup
-
-
   
 	.align 4
 	.type	 _Tw_i386_call_2,@function
@@ -542,11 +543,21 @@ _Tw_i386_call_0:
 	.size	 _Tw_i386_call_0,.L_i386_call_0-_Tw_i386_call_0
 
 
+	.align 4
+.globl Tw_CreateGroup
+	.type	 Tw_CreateGroup,@function
+Tw_CreateGroup:
+	pushl $44
+	jmp _Tw_i386_call_0
+.L_CreateGroup:
+	.size	 Tw_CreateGroup,.L_CreateGroup-Tw_CreateGroup
+
+
 	.align 4
 .globl Tw_InsertGadgetGroup
 	.type	 Tw_InsertGadgetGroup,@function
 Tw_InsertGadgetGroup:
-	pushl $44
+	pushl $45
 	jmp _Tw_i386_call_2
 .L_InsertGadgetGroup:
 	.size	 Tw_InsertGadgetGroup,.L_InsertGadgetGroup-Tw_InsertGadgetGroup
@@ -556,7 +567,7 @@ Tw_InsertGadgetGroup:
 .globl Tw_RemoveGadgetGroup
 	.type	 Tw_RemoveGadgetGroup,@function
 Tw_RemoveGadgetGroup:
-	pushl $45
+	pushl $46
 	jmp _Tw_i386_call_2
 .L_RemoveGadgetGroup:
 	.size	 Tw_RemoveGadgetGroup,.L_RemoveGadgetGroup-Tw_RemoveGadgetGroup
@@ -567,7 +578,7 @@ Tw_RemoveGadgetGroup:
 .globl Tw_GetSelectedGadgetGroup
 	.type	 Tw_GetSelectedGadgetGroup,@function
 Tw_GetSelectedGadgetGroup:
-	pushl $46
+	pushl $47
 	jmp _Tw_i386_call_0
 .L_GetSelectedGadgetGroup:
 	.size	 Tw_GetSelectedGadgetGroup,.L_GetSelectedGadgetGroup-Tw_GetSelectedGadgetGroup
@@ -577,7 +588,7 @@ Tw_GetSelectedGadgetGroup:
 .globl Tw_SetSelectedGadgetGroup
 	.type	 Tw_SetSelectedGadgetGroup,@function
 Tw_SetSelectedGadgetGroup:
-	pushl $47
+	pushl $48
 	jmp _Tw_i386_call_2
 .L_SetSelectedGadgetGroup:
 	.size	 Tw_SetSelectedGadgetGroup,.L_SetSelectedGadgetGroup-Tw_SetSelectedGadgetGroup
@@ -588,7 +599,7 @@ Tw_SetSelectedGadgetGroup:
 .globl Tw_RaiseRow
 	.type	 Tw_RaiseRow,@function
 Tw_RaiseRow:
-	pushl $48
+	pushl $49
 	jmp _Tw_i386_call_2
 .L_RaiseRow:
 	.size	 Tw_RaiseRow,.L_RaiseRow-Tw_RaiseRow
@@ -598,7 +609,7 @@ Tw_RaiseRow:
 .globl Tw_LowerRow
 	.type	 Tw_LowerRow,@function
 Tw_LowerRow:
-	pushl $49
+	pushl $50
 	jmp _Tw_i386_call_2
 .L_LowerRow:
 	.size	 Tw_LowerRow,.L_LowerRow-Tw_LowerRow
@@ -608,7 +619,7 @@ Tw_LowerRow:
 .globl Tw_RestackChildrenRow
 	.type	 Tw_RestackChildrenRow,@function
 Tw_RestackChildrenRow:
-	pushl $50
+	pushl $51
 	jmp _Tw_i386_call_2
 .L_RestackChildrenRow:
 	.size	 Tw_RestackChildrenRow,.L_RestackChildrenRow-Tw_RestackChildrenRow
@@ -618,7 +629,7 @@ Tw_RestackChildrenRow:
 .globl Tw_CirculateChildrenRow
 	.type	 Tw_CirculateChildrenRow,@function
 Tw_CirculateChildrenRow:
-	pushl $51
+	pushl $52
 	jmp _Tw_i386_call_2
 .L_CirculateChildrenRow:
 	.size	 Tw_CirculateChildrenRow,.L_CirculateChildrenRow-Tw_CirculateChildrenRow
@@ -629,7 +640,7 @@ Tw_CirculateChildrenRow:
 .globl Tw_Create4MenuAny
 	.type	 Tw_Create4MenuAny,@function
 Tw_Create4MenuAny:
-	pushl $52
+	pushl $53
 	jmp _Tw_i386_call_0
 .L_Create4MenuAny:
 	.size	 Tw_Create4MenuAny,.L_Create4MenuAny-Tw_Create4MenuAny
@@ -640,7 +651,7 @@ Tw_Create4MenuAny:
 .globl Tw_Create4MenuCommonMenuItem
 	.type	 Tw_Create4MenuCommonMenuItem,@function
 Tw_Create4MenuCommonMenuItem:
-	pushl $53
+	pushl $54
 	jmp _Tw_i386_call_0
 .L_Create4MenuCommonMenuItem:
 	.size	 Tw_Create4MenuCommonMenuItem,.L_Create4MenuCommonMenuItem-Tw_Create4MenuCommonMenuItem
@@ -651,7 +662,7 @@ Tw_Create4MenuCommonMenuItem:
 .globl Tw_CreateMenu
 	.type	 Tw_CreateMenu,@function
 Tw_CreateMenu:
-	pushl $54
+	pushl $55
 	jmp _Tw_i386_call_0
 .L_CreateMenu:
 	.size	 Tw_CreateMenu,.L_CreateMenu-Tw_CreateMenu
@@ -661,7 +672,7 @@ Tw_CreateMenu:
 .globl Tw_SetInfoMenu
 	.type	 Tw_SetInfoMenu,@function
 Tw_SetInfoMenu:
-	pushl $55
+	pushl $56
 	jmp _Tw_i386_call_2
 .L_SetInfoMenu:
 	.size	 Tw_SetInfoMenu,.L_SetInfoMenu-Tw_SetInfoMenu
@@ -672,7 +683,7 @@ Tw_SetInfoMenu:
 .globl Tw_CreateMsgPort
 	.type	 Tw_CreateMsgPort,@function
 Tw_CreateMsgPort:
-	pushl $56
+	pushl $57
 	jmp _Tw_i386_call_0
 .L_CreateMsgPort:
 	.size	 Tw_CreateMsgPort,.L_CreateMsgPort-Tw_CreateMsgPort
@@ -682,7 +693,7 @@ Tw_CreateMsgPort:
 .globl Tw_FindMsgPort
 	.type	 Tw_FindMsgPort,@function
 Tw_FindMsgPort:
-	pushl $57
+	pushl $58
 	jmp _Tw_i386_call_0
 .L_FindMsgPort:
 	.size	 Tw_FindMsgPort,.L_FindMsgPort-Tw_FindMsgPort
@@ -693,7 +704,7 @@ Tw_FindMsgPort:
 .globl Tw_BgImageScreen
 	.type	 Tw_BgImageScreen,@function
 Tw_BgImageScreen:
-	pushl $58
+	pushl $59
 	jmp _Tw_i386_call_2
 .L_BgImageScreen:
 	.size	 Tw_BgImageScreen,.L_BgImageScreen-Tw_BgImageScreen
@@ -704,7 +715,7 @@ Tw_BgImageScreen:
 .globl Tw_PrevObj
 	.type	 Tw_PrevObj,@function
 Tw_PrevObj:
-	pushl $59
+	pushl $60
 	jmp _Tw_i386_call_0
 .L_PrevObj:
 	.size	 Tw_PrevObj,.L_PrevObj-Tw_PrevObj
@@ -714,7 +725,7 @@ Tw_PrevObj:
 .globl Tw_NextObj
 	.type	 Tw_NextObj,@function
 Tw_NextObj:
-	pushl $60
+	pushl $61
 	jmp _Tw_i386_call_0
 .L_NextObj:
 	.size	 Tw_NextObj,.L_NextObj-Tw_NextObj
@@ -724,7 +735,7 @@ Tw_NextObj:
 .globl Tw_ParentObj
 	.type	 Tw_ParentObj,@function
 Tw_ParentObj:
-	pushl $61
+	pushl $62
 	jmp _Tw_i386_call_0
 .L_ParentObj:
 	.size	 Tw_ParentObj,.L_ParentObj-Tw_ParentObj
@@ -735,7 +746,7 @@ Tw_ParentObj:
 .globl Tw_FirstScreen
 	.type	 Tw_FirstScreen,@function
 Tw_FirstScreen:
-	pushl $62
+	pushl $63
 	jmp _Tw_i386_call_0
 .L_FirstScreen:
 	.size	 Tw_FirstScreen,.L_FirstScreen-Tw_FirstScreen
@@ -745,7 +756,7 @@ Tw_FirstScreen:
 .globl Tw_FirstWidget
 	.type	 Tw_FirstWidget,@function
 Tw_FirstWidget:
-	pushl $63
+	pushl $64
 	jmp _Tw_i386_call_0
 .L_FirstWidget:
 	.size	 Tw_FirstWidget,.L_FirstWidget-Tw_FirstWidget
@@ -755,7 +766,7 @@ Tw_FirstWidget:
 .globl Tw_FirstMsgPort
 	.type	 Tw_FirstMsgPort,@function
 Tw_FirstMsgPort:
-	pushl $64
+	pushl $65
 	jmp _Tw_i386_call_0
 .L_FirstMsgPort:
 	.size	 Tw_FirstMsgPort,.L_FirstMsgPort-Tw_FirstMsgPort
@@ -765,7 +776,7 @@ Tw_FirstMsgPort:
 .globl Tw_FirstMenu
 	.type	 Tw_FirstMenu,@function
 Tw_FirstMenu:
-	pushl $65
+	pushl $66
 	jmp _Tw_i386_call_0
 .L_FirstMenu:
 	.size	 Tw_FirstMenu,.L_FirstMenu-Tw_FirstMenu
@@ -775,7 +786,7 @@ Tw_FirstMenu:
 .globl Tw_FirstW
 	.type	 Tw_FirstW,@function
 Tw_FirstW:
-	pushl $66
+	pushl $67
 	jmp _Tw_i386_call_0
 .L_FirstW:
 	.size	 Tw_FirstW,.L_FirstW-Tw_FirstW
@@ -785,7 +796,7 @@ Tw_FirstW:
 .globl Tw_FirstGroup
 	.type	 Tw_FirstGroup,@function
 Tw_FirstGroup:
-	pushl $67
+	pushl $68
 	jmp _Tw_i386_call_0
 .L_FirstGroup:
 	.size	 Tw_FirstGroup,.L_FirstGroup-Tw_FirstGroup
@@ -795,7 +806,7 @@ Tw_FirstGroup:
 .globl Tw_FirstMutex
 	.type	 Tw_FirstMutex,@function
 Tw_FirstMutex:
-	pushl $68
+	pushl $69
 	jmp _Tw_i386_call_0
 .L_FirstMutex:
 	.size	 Tw_FirstMutex,.L_FirstMutex-Tw_FirstMutex
@@ -805,7 +816,7 @@ Tw_FirstMutex:
 .globl Tw_FirstMenuItem
 	.type	 Tw_FirstMenuItem,@function
 Tw_FirstMenuItem:
-	pushl $69
+	pushl $70
 	jmp _Tw_i386_call_0
 .L_FirstMenuItem:
 	.size	 Tw_FirstMenuItem,.L_FirstMenuItem-Tw_FirstMenuItem
@@ -815,7 +826,7 @@ Tw_FirstMenuItem:
 .globl Tw_FirstGadget
 	.type	 Tw_FirstGadget,@function
 Tw_FirstGadget:
-	pushl $70
+	pushl $71
 	jmp _Tw_i386_call_0
 .L_FirstGadget:
 	.size	 Tw_FirstGadget,.L_FirstGadget-Tw_FirstGadget
@@ -826,7 +837,7 @@ Tw_FirstGadget:
 .globl Tw_GetDisplayWidth
 	.type	 Tw_GetDisplayWidth,@function
 Tw_GetDisplayWidth:
-	pushl $71
+	pushl $72
 	jmp _Tw_i386_call_0
 .L_GetDisplayWidth:
 	.size	 Tw_GetDisplayWidth,.L_GetDisplayWidth-Tw_GetDisplayWidth
@@ -836,7 +847,7 @@ Tw_GetDisplayWidth:
 .globl Tw_GetDisplayHeight
 	.type	 Tw_GetDisplayHeight,@function
 Tw_GetDisplayHeight:
-	pushl $72
+	pushl $73
 	jmp _Tw_i386_call_0
 .L_GetDisplayHeight:
 	.size	 Tw_GetDisplayHeight,.L_GetDisplayHeight-Tw_GetDisplayHeight
@@ -846,7 +857,7 @@ Tw_GetDisplayHeight:
 .globl Tw_GetAll
 	.type	 Tw_GetAll,@function
 Tw_GetAll:
-	pushl $73
+	pushl $74
 	jmp _Tw_i386_call_0
 .L_GetAll:
 	.size	 Tw_GetAll,.L_GetAll-Tw_GetAll
@@ -857,7 +868,7 @@ Tw_GetAll:
 .globl Tw_SendToMsgPort
 	.type	 Tw_SendToMsgPort,@function
 Tw_SendToMsgPort:
-	pushl $74
+	pushl $75
 	jmp _Tw_i386_call_0
 .L_SendToMsgPort:
 	.size	 Tw_SendToMsgPort,.L_SendToMsgPort-Tw_SendToMsgPort
@@ -867,7 +878,7 @@ Tw_SendToMsgPort:
 .globl Tw_BlindSendToMsgPort
 	.type	 Tw_BlindSendToMsgPort,@function
 Tw_BlindSendToMsgPort:
-	pushl $75
+	pushl $76
 	jmp _Tw_i386_call_2
 .L_BlindSendToMsgPort:
 	.size	 Tw_BlindSendToMsgPort,.L_BlindSendToMsgPort-Tw_BlindSendToMsgPort
@@ -878,7 +889,7 @@ Tw_BlindSendToMsgPort:
 .globl Tw_GetOwnerSelection
 	.type	 Tw_GetOwnerSelection,@function
 Tw_GetOwnerSelection:
-	pushl $76
+	pushl $77
 	jmp _Tw_i386_call_0
 .L_GetOwnerSelection:
 	.size	 Tw_GetOwnerSelection,.L_GetOwnerSelection-Tw_GetOwnerSelection
@@ -888,7 +899,7 @@ Tw_GetOwnerSelection:
 .globl Tw_SetOwnerSelection
 	.type	 Tw_SetOwnerSelection,@function
 Tw_SetOwnerSelection:
-	pushl $77
+	pushl $78
 	jmp _Tw_i386_call_2
 .L_SetOwnerSelection:
 	.size	 Tw_SetOwnerSelection,.L_SetOwnerSelection-Tw_SetOwnerSelection
@@ -898,7 +909,7 @@ Tw_SetOwnerSelection:
 .globl Tw_RequestSelection
 	.type	 Tw_RequestSelection,@function
 Tw_RequestSelection:
-	pushl $78
+	pushl $79
 	jmp _Tw_i386_call_2
 .L_RequestSelection:
 	.size	 Tw_RequestSelection,.L_RequestSelection-Tw_RequestSelection
@@ -908,7 +919,7 @@ Tw_RequestSelection:
 .globl Tw_NotifySelection
 	.type	 Tw_NotifySelection,@function
 Tw_NotifySelection:
-	pushl $79
+	pushl $80
 	jmp _Tw_i386_call_2
 .L_NotifySelection:
 	.size	 Tw_NotifySelection,.L_NotifySelection-Tw_NotifySelection
@@ -919,7 +930,7 @@ Tw_NotifySelection:
 .globl Tw_SetServerUid
 	.type	 Tw_SetServerUid,@function
 Tw_SetServerUid:
-	pushl $80
+	pushl $81
 	jmp _Tw_i386_call_0
 .L_SetServerUid:
 	.size	 Tw_SetServerUid,.L_SetServerUid-Tw_SetServerUid
@@ -930,7 +941,7 @@ Tw_SetServerUid:
 .globl Tw_OpenExtension
 	.type	 Tw_OpenExtension,@function
 Tw_OpenExtension:
-	pushl $81
+	pushl $82
 	jmp _Tw_i386_call_0
 .L_OpenExtension:
 	.size	 Tw_OpenExtension,.L_OpenExtension-Tw_OpenExtension
@@ -940,7 +951,7 @@ Tw_OpenExtension:
 .globl Tw_CallBExtension
 	.type	 Tw_CallBExtension,@function
 Tw_CallBExtension:
-	pushl $82
+	pushl $83
 	jmp _Tw_i386_call_0
 .L_CallBExtension:
 	.size	 Tw_CallBExtension,.L_CallBExtension-Tw_CallBExtension
@@ -950,7 +961,7 @@ Tw_CallBExtension:
 .globl Tw_CloseExtension
 	.type	 Tw_CloseExtension,@function
 Tw_CloseExtension:
-	pushl $83
+	pushl $84
 	jmp _Tw_i386_call_2
 .L_CloseExtension:
 	.size	 Tw_CloseExtension,.L_CloseExtension-Tw_CloseExtension
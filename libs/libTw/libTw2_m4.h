@@ -332,6 +332,14 @@ void Tw_WriteTCellWindow(tw_d TwD, twindow a1, dat a2, dat a3, uldat a4, TW_CONS
 }
 
 
+void Tw_AppendRowsWindow(tw_d TwD, twindow a1, uldat a2, TW_CONST trune *a3) {
+    _Tw_EncodeCall(ENCODE_FL_VOID, order_AppendRowsWindow, TwD 
+    , n(a1)
+    , n(a2)
+    , n((a2) * sizeof(trune)), N(a3));
+}
+
+
 void Tw_GotoXYWindow(tw_d TwD, twindow a1, ldat a2, ldat a3) {
     _Tw_EncodeCall(ENCODE_FL_VOID, order_GotoXYWindow, TwD 
     , n(a1)
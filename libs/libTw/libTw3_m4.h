@@ -185,6 +185,12 @@
     }
     break;
 
+  case order_AppendRowsWindow:
+    switch (n) {
+      case 3: L = (a[2]._) * sizeof(trune); break;
+    }
+    break;
+
 
   case order_SetTitleWindow:
     switch (n) {
@@ -0,0 +1,233 @@
+/*
+ *  bench_mouse.c  --  headless benchmark of finding the widget under the mouse
+ *
+ *  Copyright (C) 2000-2020 by Massimiliano Ghilardi
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ */
+
+/*
+ * maps many windows on the screen of a twin server without displays, then feeds it
+ * mouse motion events: for each one, finds the widget under the mouse as WManagerH()
+ * in wm.c does before acting on the event, i.e. FindWidgetAt() on the screen
+ * and RecursiveFindWidgetAt() inside the window found.
+ *
+ * the mouse is moved across the screen three times:
+ *   hover  nothing changes between events
+ *   raise  every few events, the window under the mouse is raised
+ *   drag   the topmost window is dragged along with the mouse
+ * and reports how many draw_ctx the redraws that follow took from their pool, see draw.c.
+ * not built by default: "make bench_mouse" in the server directory,
+ * then run ./bench_mouse [-n windows] [-e events]
+ */
+
+#include <time.h>
+
+#include "twin.h"
+#include "algo.h"
+#include "alloc.h"
+#include "data.h"
+#include "methods.h"
+#include "builtin.h"
+#include "draw.h"
+#include "hw.h"
+#include "hw_private.h"
+#include "main.h"
+#include "resize.h"
+#include "scroller.h"
+#include "util.h"
+
+#include <Tw/Tw.h>
+
+/* the globals of main.c */
+fd_set save_rfds, save_wfds;
+int max_fds;
+byte lenTWDisplay;
+char *TWDisplay, *origTWDisplay, *origTERM, *origHW, *HOME;
+char **main_argv, **orig_argv;
+uldat main_argv_usable_len;
+byte flag_secure, flag_envrc;
+CONST char *flag_secure_msg = "bench_mouse: cannot exec() external programs.\n";
+
+int (*OverrideSelect)(int n, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+                      struct timeval *timeout) = select;
+
+void Quit(int status) {
+  if (status < 0)
+    return;
+  exit(status);
+}
+
+void NoOp(void) {
+}
+
+byte AlwaysTrue(void) {
+  return ttrue;
+}
+
+byte AlwaysFalse(void) {
+  return tfalse;
+}
+
+void *AlwaysNull(void) {
+  return NULL;
+}
+
+#define BENCH_WIDTH 200
+#define BENCH_HEIGHT 60
+
+/* how often "raise" raises the window under the mouse */
+#define BENCH_RAISE_EVERY 16
+
+enum { BENCH_HOVER, BENCH_RAISE, BENCH_DRAG };
+
+static uldat seed = 1;
+
+static uldat rnd(uldat n) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % n;
+}
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* what flushing to displays would do: forget the damage of Video[] and start a new frame */
+static void flush_video(void) {
+  dat y;
+
+  for (y = 0; y < DisplayHeight; y++)
+    ChangedVideo[y].N = 0;
+  ChangedVideoFlag = tfalse;
+  FrameDrawCtxStats();
+}
+
+/* the widget under the mouse at display coords (i, j), as InitCtx() and DetailCtx() find it */
+static widget find(dat i, dat j) {
+  screen Screen;
+  widget W;
+  ldat Left, Up;
+
+  if (!(Screen = Do(Find, Screen)(j)) || Screen != All->FirstScreen || Screen->YLimit >= j ||
+      !(W = Act(FindWidgetAt, Screen)(Screen, i, j - Screen->YLimit)))
+    return NULL;
+
+  Left = (ldat)W->Left - Screen->XLogic;
+  Up = (ldat)W->Up - Screen->YLogic + (ldat)Screen->YLimit;
+  return RecursiveFindWidgetAt(W, i - Left, j - Up);
+}
+
+static void motion(CONST char *name, byte mode, uldat events) {
+  widget W;
+  double t, total = 0, ctx = 0;
+  uldat e, found = 0;
+  dat i, j, di = 1, dj = 1;
+
+  i = BENCH_WIDTH / 2;
+  j = BENCH_HEIGHT / 2;
+  /* as the window manager does while dragging */
+  All->State = mode == BENCH_DRAG ? STATE_DRAG : STATE_DEFAULT;
+  for (e = 0; e < events; e++) {
+    /* bounce around the screen, below the menu row */
+    if (i + di < 0 || i + di >= BENCH_WIDTH)
+      di = -di;
+    if (j + dj < 1 || j + dj >= BENCH_HEIGHT)
+      dj = -dj;
+    i += di;
+    j += dj;
+
+    if (mode == BENCH_DRAG && IS_WINDOW(All->FirstScreen->FirstW))
+      DragFirstWindow(di, dj);
+
+    t = now();
+    W = find(i, j);
+    total += now() - t;
+
+    if (W)
+      found++;
+    if (mode == BENCH_RAISE && W && e % BENCH_RAISE_EVERY == 0)
+      RaiseWidget(NonScreenParent(W), tfalse);
+    flush_video();
+    ctx += DrawCtxStats.LastAllocs;
+  }
+  printf("%-8s %10u %10u %12.3f %12.1f %10.1f\n", name, (unsigned)events, (unsigned)found,
+         total * 1e3, total * 1e9 / events, ctx / events);
+}
+
+/* many windows of random size, scattered on the screen */
+static byte bench_windows(uldat n) {
+  msgport MsgPort;
+  menu Menu;
+  window W;
+  uldat k;
+
+  if (!(MsgPort = Do(Create, MsgPort)(FnMsgPort, 11, "bench_mouse", (uldat)0, (udat)0, (byte)0,
+                                      (void (*)(msgport))NoOp)) ||
+      !(Menu = Do(Create, Menu)(FnMenu, MsgPort, COL(BLACK, WHITE), COL(BLACK, GREEN),
+                                COL(HIGH | BLACK, WHITE), COL(HIGH | BLACK, BLACK), COL(RED, WHITE),
+                                COL(RED, GREEN), (byte)0)))
+    return tfalse;
+
+  for (k = 0; k < n; k++) {
+    if (!(W = Do(Create, Window)(FnWindow, MsgPort, 11, "bench_mouse", NULL, Menu,
+                                 COL(WHITE, BLUE), NOCURSOR, WINDOW_DRAG | WINDOW_RESIZE,
+                                 WINDOWFL_USEROWS, (dat)(10 + rnd(50)), (dat)(4 + rnd(16)), 0)))
+      return tfalse;
+    W->Left = (dat)rnd(BENCH_WIDTH) - 5;
+    W->Up = (dat)rnd(BENCH_HEIGHT) - 2;
+    Act(Map, W)(W, (widget)All->FirstScreen);
+  }
+  QueuedDrawArea2FullScreen = tfalse;
+  DrawArea2(FULL_SCREEN);
+  flush_video();
+  return ttrue;
+}
+
+int main(int argc, char *argv[]) {
+  static char *no_args[] = {NULL}, display[] = ":bench";
+  uldat windows = 1000, events = 100000;
+
+  for (; argc > 2; argc -= 2, argv += 2) {
+    if (!strcmp(argv[1], "-n"))
+      windows = (uldat)atoi(argv[2]);
+    else if (!strcmp(argv[1], "-e"))
+      events = (uldat)atoi(argv[2]);
+    else
+      break;
+  }
+  if (argc > 1 || !events) {
+    fputs("usage: bench_mouse [-n windows] [-e events]\n", stderr);
+    return 1;
+  }
+
+  main_argv = orig_argv = no_args;
+  TWDisplay = display;
+  lenTWDisplay = strlen(display);
+  InstantNow(&All->Now);
+
+  /* a display-less server, with a Video[] to draw into */
+  All->DisplayWidth = DisplayWidth = BENCH_WIDTH;
+  All->DisplayHeight = DisplayHeight = BENCH_HEIGHT;
+  if (!(Video = (tcell *)AllocMem((ldat)DisplayWidth * DisplayHeight * sizeof(tcell))) ||
+      !(ChangedVideo = (dirty_row *)AllocMem0(sizeof(dirty_row), DisplayHeight)) || !InitData() ||
+      !InitScroller() || !InitBuiltin() || !bench_windows(windows)) {
+    fputs("bench_mouse: initialization failed\n", stderr);
+    return 1;
+  }
+
+  printf("%u windows\n", (unsigned)windows);
+  printf("%-8s %10s %10s %12s %12s %10s\n", "motion", "events", "found", "find ms", "ns/event",
+         "ctx/event");
+  motion("hover", BENCH_HOVER, events);
+  motion("raise", BENCH_RAISE, events);
+  motion("drag", BENCH_DRAG, events);
+  printf("draw_ctx pool: %u chunks allocated, at most %u in use\n",
+         (unsigned)DrawCtxStats.Chunks, (unsigned)DrawCtxStats.Peak);
+  return 0;
+}
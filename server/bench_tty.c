@@ -0,0 +1,349 @@
+/*
+ *  bench_tty.c  --  headless benchmark of the terminal emulator
+ *
+ *  Copyright (C) 2000-2020 by Massimiliano Ghilardi
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ */
+
+/*
+ * replays UTF-8 byte streams into a terminal window of a twin server without displays:
+ * windows are drawn into Video[] as usual, which is then never sent anywhere.
+ *
+ * streams are fed in chunks of TW_BIGBUFF - 1 bytes, as TwinTermIO() reads them
+ * from a pty. each chunk is parsed with TtyDeferDraw set, then its damage is counted
+ * and drawn with DrawTtyDirty() as flush_tty() would do, so parsing and drawing
+ * are timed separately.
+ *
+ * without arguments, replays a few synthetic streams: ls -lR, colour logs, UTF-8 text,
+ * a full-screen editor session and scroll regions. otherwise replays the files given,
+ * for example recorded with script(1). not built by default:
+ * "make bench_tty" in the server directory, then run ./bench_tty [-l loops] [file ...]
+ */
+
+#include <time.h>
+
+#include "twin.h"
+#include "algo.h"
+#include "alloc.h"
+#include "data.h"
+#include "methods.h"
+#include "builtin.h"
+#include "draw.h"
+#include "hw.h"
+#include "hw_private.h"
+#include "main.h"
+#include "scroller.h"
+#include "tty.h"
+#include "util.h"
+
+#include <Tw/Tw.h>
+
+/* the globals of main.c */
+fd_set save_rfds, save_wfds;
+int max_fds;
+byte lenTWDisplay;
+char *TWDisplay, *origTWDisplay, *origTERM, *origHW, *HOME;
+char **main_argv, **orig_argv;
+uldat main_argv_usable_len;
+byte flag_secure, flag_envrc;
+CONST char *flag_secure_msg = "bench_tty: cannot exec() external programs.\n";
+
+int (*OverrideSelect)(int n, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+                      struct timeval *timeout) = select;
+
+void Quit(int status) {
+  if (status < 0)
+    return;
+  exit(status);
+}
+
+void NoOp(void) {
+}
+
+byte AlwaysTrue(void) {
+  return ttrue;
+}
+
+byte AlwaysFalse(void) {
+  return tfalse;
+}
+
+void *AlwaysNull(void) {
+  return NULL;
+}
+
+#define BENCH_WIDTH 132
+#define BENCH_HEIGHT 50
+
+/* a growable byte stream */
+typedef struct {
+  char *data;
+  uldat len, max;
+} stream;
+
+static void put(stream *s, CONST char *data, uldat len) {
+  if (s->len + len > s->max) {
+    s->max = (s->len + len) * 2;
+    if (!(s->data = (char *)ReAllocMem(s->data, s->max))) {
+      fputs("bench_tty: out of memory\n", stderr);
+      exit(1);
+    }
+  }
+  CopyMem(data, s->data + s->len, len);
+  s->len += len;
+}
+
+static void putf(stream *s, CONST char *fmt, ...) {
+  char buf[TW_BIGBUFF];
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  put(s, buf, len);
+}
+
+static uldat seed = 1;
+
+static uldat rnd(uldat n) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % n;
+}
+
+static CONST char *CONST words[] = {"twin",   "server", "window", "screen", "display", "socket",
+                                    "module", "kernel", "buffer", "cursor", "scroll",  "render"};
+#define WORD() words[rnd(sizeof(words) / sizeof(words[0]))]
+
+static void gen_ls(stream *s, uldat size) {
+  uldat i = 0;
+
+  while (s->len < size) {
+    if (i++ % 40 == 0)
+      putf(s, "\r\n./%s/%s:\r\ntotal %u\r\n", WORD(), WORD(), (unsigned)rnd(4000));
+    putf(s, "%crw-r--r-- 1 %-8s %-8s %8u Oct %2u %02u:%02u %s_%s.%s\r\n", rnd(8) ? '-' : 'd',
+         WORD(), WORD(), (unsigned)rnd(1000000), (unsigned)rnd(31) + 1, (unsigned)rnd(24),
+         (unsigned)rnd(60), WORD(), WORD(), rnd(2) ? "c" : "h");
+  }
+}
+
+static void gen_log(stream *s, uldat size) {
+  static CONST char *CONST level[] = {"\033[32mINFO\033[0m", "\033[1;33mWARN\033[0m",
+                                      "\033[1;31mERROR\033[0m", "\033[2mDEBUG\033[0m"};
+
+  while (s->len < size)
+    putf(s,
+         "\033[36m2026-10-18 %02u:%02u:%02u.%03u\033[0m %s [\033[3%u;4%um%s-%u\033[0m] "
+         "%s %s \033[1m%u\033[0m ms\r\n",
+         (unsigned)rnd(24), (unsigned)rnd(60), (unsigned)rnd(60), (unsigned)rnd(1000),
+         level[rnd(4)], (unsigned)rnd(8), (unsigned)rnd(8), WORD(), (unsigned)rnd(16), WORD(),
+         WORD(), (unsigned)rnd(5000));
+}
+
+static void gen_utf8(stream *s, uldat size) {
+  static CONST char *CONST lines[] = {
+      "le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter\r\n",
+      "┌──────────┬──────────┐\r\n│ Größe    │ Name     │\r\n└──────────┴──────────┘\r\n",
+      "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏\r\n",
+      "Съешь же ещё этих мягких французских булок, да выпей чаю\r\n",
+  };
+  CONST char *line;
+
+  while (s->len < size) {
+    line = lines[rnd(sizeof(lines) / sizeof(lines[0]))];
+    put(s, line, strlen(line));
+  }
+}
+
+/* a full-screen editor: typing, cursor motion, status line, occasional scrolls and redraws */
+static void gen_vim(stream *s, uldat size) {
+  uldat y, x, n = 0;
+
+  while (s->len < size) {
+    if (n++ % 500 == 0) {
+      put(s, "\033[H\033[2J", 7);
+      for (y = 1; y < BENCH_HEIGHT - 2; y++)
+        putf(s, "\033[%u;1H\033[33m%4u\033[0m %s(%s, %s);", (unsigned)y, (unsigned)(y + n),
+             WORD(), WORD(), WORD());
+    }
+    y = rnd(BENCH_HEIGHT - 3) + 1;
+    x = rnd(40) + 6;
+    putf(s, "\033[%u;%uH%s\033[K", (unsigned)y, (unsigned)x, WORD());
+    if (rnd(8) == 0)
+      putf(s, "\033[1;%ur\033[%u;1H\n\033[33m%4u\033[0m %s\033[r", BENCH_HEIGHT - 3,
+           BENCH_HEIGHT - 3, (unsigned)n, WORD());
+    putf(s, "\033[%u;1H\033[7m %s.c [+] %u,%u \033[0m\033[K\033[%u;%uH", BENCH_HEIGHT - 2,
+         WORD(), (unsigned)y, (unsigned)x, (unsigned)y, (unsigned)x);
+  }
+}
+
+/* scroll regions: line feeds, reverse index, insert and delete lines */
+static void gen_scroll(stream *s, uldat size) {
+  uldat t, b;
+
+  while (s->len < size) {
+    t = rnd(BENCH_HEIGHT / 2) + 1;
+    b = t + rnd(BENCH_HEIGHT / 2) + 1;
+    putf(s, "\033[%u;%ur\033[%u;1H", (unsigned)t, (unsigned)b, (unsigned)b);
+    putf(s, "%s %s\n%s\n\033[%u;1H\033M\033M%s", WORD(), WORD(), WORD(), (unsigned)t, WORD());
+    putf(s, "\033[%u;1H\033[2L%s\033[3M\033[r", (unsigned)(t + 1), WORD());
+  }
+}
+
+static CONST struct {
+  CONST char *name;
+  void (*gen)(stream *s, uldat size);
+} synthetic[] = {
+    {"ls -lR", gen_ls}, {"log", gen_log}, {"utf8", gen_utf8}, {"vim", gen_vim}, {"scroll", gen_scroll},
+};
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* cells that flush_tty() would draw */
+static uldat damage(window W) {
+  ttydata *Data = W->USE.C.TtyData;
+  uldat cells = 0;
+  dat y;
+
+  if (Data->DirtyY1 > Data->DirtyY2)
+    return 0;
+  if (Data->DirtyMax < Data->SizeY)
+    return (uldat)(Data->DirtyY2 - Data->DirtyY1 + 1) * Data->SizeX;
+  for (y = Data->DirtyY1; y <= Data->DirtyY2; y++)
+    if (Data->DirtyX1[y] <= Data->DirtyX2[y])
+      cells += Data->DirtyX2[y] - Data->DirtyX1[y] + 1;
+  return cells;
+}
+
+/* what flushing to displays would do: forget the damage of Video[] */
+static void flush_video(void) {
+  dat y;
+
+  for (y = 0; y < DisplayHeight; y++)
+    ChangedVideo[y].N = 0;
+  ChangedVideoFlag = tfalse;
+}
+
+static void replay(window W, CONST char *name, CONST char *data, uldat len, uldat loops) {
+  double t, parse = 0, draw = 0;
+  uldat i, off, n, cells = 0;
+
+  /* reset, then switch to UTF-8 */
+  TtyWriteAscii(W, 5, "\033c\033%G");
+  DrawTtyDirty();
+  flush_video();
+
+  for (i = 0; i < loops; i++) {
+    for (off = 0; off < len; off += n) {
+      n = Min2(len - off, TW_BIGBUFF - 1);
+
+      t = now();
+      TtyDeferDraw = ttrue;
+      TtyWriteAscii(W, n, data + off);
+      TtyDeferDraw = tfalse;
+      parse += now() - t;
+
+      cells += damage(W);
+      t = now();
+      DrawTtyDirty();
+      draw += now() - t;
+      flush_video();
+    }
+  }
+  printf("%-16.16s %8.1f %10.1f %10.1f %10.1f %10.2f\n", name, len * (double)loops / 1e6,
+         len * (double)loops / parse / 1e6, len * (double)loops / (parse + draw) / 1e6,
+         draw * 1e3, cells / 1e6);
+}
+
+static byte load(CONST char *path, stream *s) {
+  char buf[TW_BIGBUFF];
+  FILE *f = fopen(path, "rb");
+  size_t got;
+
+  if (!f)
+    return tfalse;
+  while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+    put(s, buf, got);
+  fclose(f);
+  return ttrue;
+}
+
+/* a window like the ones of the builtin terminal */
+static window bench_window(void) {
+  msgport MsgPort;
+  menu Menu;
+  window W;
+
+  if (!(MsgPort = Do(Create, MsgPort)(FnMsgPort, 9, "bench_tty", (uldat)0, (udat)0, (byte)0,
+                                      (void (*)(msgport))NoOp)) ||
+      !(Menu = Do(Create, Menu)(FnMenu, MsgPort, COL(BLACK, WHITE), COL(BLACK, GREEN),
+                                COL(HIGH | BLACK, WHITE), COL(HIGH | BLACK, BLACK), COL(RED, WHITE),
+                                COL(RED, GREEN), (byte)0)) ||
+      !(W = Do(Create, Window)(FnWindow, MsgPort, 9, "bench_tty", NULL, Menu, COL(WHITE, BLACK),
+                               LINECURSOR, WINDOW_WANT_KEYS | WINDOW_Y_BAR,
+                               WINDOWFL_CURSOR_ON | WINDOWFL_USECONTENTS, BENCH_WIDTH, BENCH_HEIGHT,
+                               1000)))
+    return NULL;
+  Act(Map, W)(W, (widget)All->FirstScreen);
+
+  QueuedDrawArea2FullScreen = tfalse;
+  DrawArea2(FULL_SCREEN);
+  return W;
+}
+
+int main(int argc, char *argv[]) {
+  static char *no_args[] = {NULL}, display[] = ":bench";
+  stream s = {NULL, 0, 0};
+  uldat i, size = 4 << 20, loops = 1;
+  window W;
+
+  if (argc > 2 && !strcmp(argv[1], "-l")) {
+    loops = (uldat)atoi(argv[2]);
+    argc -= 2, argv += 2;
+  }
+
+  main_argv = orig_argv = no_args;
+  TWDisplay = display;
+  lenTWDisplay = strlen(display);
+  InstantNow(&All->Now);
+
+  /* a display-less server, with a Video[] to draw into */
+  All->DisplayWidth = DisplayWidth = BENCH_WIDTH + 4;
+  All->DisplayHeight = DisplayHeight = BENCH_HEIGHT + 4;
+  if (!(Video = (tcell *)AllocMem((ldat)DisplayWidth * DisplayHeight * sizeof(tcell))) ||
+      !(ChangedVideo = (dirty_row *)AllocMem0(sizeof(dirty_row), DisplayHeight)) || !InitData() ||
+      !InitScroller() || !InitBuiltin() || !(W = bench_window())) {
+    fputs("bench_tty: initialization failed\n", stderr);
+    return 1;
+  }
+
+  printf("%-16s %8s %10s %10s %10s %10s\n", "stream", "MB", "parse MB/s", "total MB/s",
+         "draw ms", "Mcells");
+  if (argc > 1) {
+    for (i = 1; i < (uldat)argc; i++) {
+      s.len = 0;
+      if (!load(argv[i], &s)) {
+        fprintf(stderr, "bench_tty: cannot read `%s'\n", argv[i]);
+        return 1;
+      }
+      replay(W, argv[i], s.data, s.len, loops);
+    }
+  } else {
+    for (i = 0; i < sizeof(synthetic) / sizeof(synthetic[0]); i++) {
+      s.len = 0;
+      seed = 1;
+      synthetic[i].gen(&s, size);
+      replay(W, synthetic[i].name, s.data, s.len, loops);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ *  bench_utf8.c  --  microbenchmark of the UTF-8 decoding used by the terminal emulator
+ *
+ *  Copyright (C) 2000-2020 by Massimiliano Ghilardi
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ */
+
+/*
+ * compares the byte-at-a-time state machine of combine_utf8() in tty.c
+ * with Utf8Decode() followed by that state machine only where Utf8Decode() stops,
+ * as TtyWriteAscii() does, on a few kinds of text. not built by default:
+ * "make bench_utf8" in the server directory, then run ./bench_utf8 [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "twautoconf.h"
+#include "compiler.h"
+
+#include <Tw/Twtypes.h>
+
+#include "utf8.h"
+
+static trune utf8_char;
+static byte utf8_count;
+
+/* same as combine_utf8() in tty.c */
+static tbool combine_utf8(trune *pc) {
+  trune c = *pc;
+
+  if (utf8_count > 0 && (c & 0xc0) == 0x80) {
+    utf8_char = (utf8_char << 6) | (c & 0x3f);
+    utf8_count--;
+    if (utf8_count == 0)
+      *pc = utf8_char;
+    return (tbool)(utf8_count == 0);
+  }
+
+  if ((c & 0xe0) == 0xc0) {
+    utf8_count = 1;
+    utf8_char = (c & 0x1f);
+  } else if ((c & 0xf0) == 0xe0) {
+    utf8_count = 2;
+    utf8_char = (c & 0x0f);
+  } else if ((c & 0xf8) == 0xf0) {
+    utf8_count = 3;
+    utf8_char = (c & 0x07);
+  } else
+    utf8_count = 0;
+  return tfalse;
+}
+
+/* decode one byte as TtyWriteAscii() does, and return the number of runes written to d */
+INLINE uldat decode_byte(byte b, trune *d) {
+  trune c = b;
+
+  if (c & 0x80) {
+    if (!combine_utf8(&c))
+      return 0;
+  } else
+    utf8_count = 0;
+  *d = c;
+  return 1;
+}
+
+static uldat decode_scalar(CONST byte *s, uldat len, trune *d) {
+  uldat n = 0;
+
+  utf8_count = 0;
+  while (len--)
+    n += decode_byte(*s++, d + n);
+  return n;
+}
+
+static uldat decode_bulk(CONST byte *s, uldat len, trune *d) {
+  uldat n = 0, used;
+
+  utf8_count = 0;
+  while (len) {
+    used = 0;
+    if (!utf8_count)
+      n += Utf8Decode(s, len, d + n, len, &used);
+    if (used) {
+      s += used;
+      len -= used;
+      continue;
+    }
+    n += decode_byte(*s++, d + n);
+    len--;
+  }
+  return n;
+}
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static double bench(uldat (*decode)(CONST byte *, uldat, trune *), CONST byte *s, uldat len,
+                    trune *d, uldat loops, uldat *n) {
+  double t = now();
+  uldat i;
+
+  for (i = 0; i < loops; i++)
+    *n = decode(s, len, d);
+  return now() - t;
+}
+
+static CONST struct {
+  CONST char *name, *line;
+} samples[] = {
+    {"ascii", "the quick brown fox jumps over the lazy dog 0123456789 $ ls -l /usr/bin\r\n"},
+    {"latin", "le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter\r\n"},
+    {"box", "\x1b[1m┌──────────┬──────────┐\x1b[0m\r\n│ name     │ size     │\r\n"},
+    {"cjk", "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏\r\n"},
+    {"invalid", "abc\xff\xfe def \xc0\xaf \xed\xa0\x80 \xe2\x94 xyz\r\n"},
+};
+
+int main(int argc, char *argv[]) {
+  uldat size = (argc > 1 ? (uldat)atoi(argv[1]) : 16) << 20;
+  uldat i, j, len, loops, n1, n2;
+  double t1, t2;
+  byte *s;
+  trune *d1, *d2;
+
+  /* decode ~size bytes in total, 1 megabyte at time */
+  len = 1 << 20;
+  loops = size / len ? size / len : 1;
+  s = (byte *)malloc(len);
+  d1 = (trune *)malloc(len * sizeof(trune));
+  d2 = (trune *)malloc(len * sizeof(trune));
+  if (!s || !d1 || !d2) {
+    fputs("bench_utf8: out of memory\n", stderr);
+    return 1;
+  }
+
+  printf("%-8s %12s %12s %8s\n", "text", "scalar MB/s", "bulk MB/s", "speedup");
+  for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+    CONST char *line = samples[i].line;
+    uldat linelen = strlen(line);
+
+    for (j = 0; j + linelen <= len; j += linelen)
+      memcpy(s + j, line, linelen);
+    len = j;
+
+    t1 = bench(decode_scalar, s, len, d1, loops, &n1);
+    t2 = bench(decode_bulk, s, len, d2, loops, &n2);
+    if (n1 != n2 || memcmp(d1, d2, n1 * sizeof(trune))) {
+      fprintf(stderr, "bench_utf8: %s: bulk and scalar decoders disagree\n", samples[i].name);
+      return 1;
+    }
+    printf("%-8s %12.1f %12.1f %7.2fx\n", samples[i].name, len * loops / t1 / 1e6,
+           len * loops / t2 / 1e6, t1 / t2);
+    len = 1 << 20;
+  }
+  free(s);
+  free(d1);
+  free(d2);
+  return 0;
+}
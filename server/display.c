@@ -480,45 +480,32 @@ static display_hw AttachDisplayHW(uldat len, CONST char *arg, uldat slot, byte f
 #if 0
 /* not needed, server-side hw_display already does optimization for us */
 INLINE void OptimizeChangedVideo(void) {
-    uldat _start, start, _end, end;
-    ldat i;
-    
-    for (i=0; i<(ldat)DisplayHeight*2; i++) {
-	start = (uldat)ChangedVideo[i>>1][!(i&1)][0];
-	    
-	if (start != (uldat)-1) {
-	    
-	    start += (i>>1) * (ldat)DisplayWidth;
-	    _start = start;
-
-	    _end = end = (uldat)ChangedVideo[i>>1][!(i&1)][1] + (i>>1) * (ldat)DisplayWidth;
-		
-	    while (start <= end && Video[start] == OldVideo[start])
-		start++;
-	    while (start <= end && Video[end] == OldVideo[end])
-		end--;
-
-	    if (start > end) {
-		if (i&1) {
-		    /*
-		     * this is the first area, to make it empty
-		     * copy the second on this.
-		     */
-		    if (ChangedVideo[i>>1][1][0] != -1) {
-			ChangedVideo[i>>1][0][0] = ChangedVideo[i>>1][1][0];
-			ChangedVideo[i>>1][0][1] = ChangedVideo[i>>1][1][1];
-			ChangedVideo[i>>1][1][0] = -1;
-		    } else
-			ChangedVideo[i>>1][0][0] = -1;
-		} else
-		    ChangedVideo[i>>1][1][0] = -1;
-		continue;
-	    } else if (start > _start || end < _end) {
-		ChangedVideo[i>>1][!(i&1)][0] += start - _start;
-		ChangedVideo[i>>1][!(i&1)][1] -= _end - end;
-	    }
-	}
+  uldat start, end, base;
+  ldat i;
+  dat k, n;
+  dat(*S)[2];
+
+  for (i = 0; i < (ldat)DisplayHeight; i++) {
+    S = ChangedVideo[i].Span;
+    base = i * (ldat)DisplayWidth;
+
+    for (k = n = 0; k < ChangedVideo[i].N; k++) {
+      start = S[k][0] + base;
+      end = S[k][1] + base;
+
+      while (start <= end && Video[start] == OldVideo[start])
+        start++;
+      while (start <= end && Video[end] == OldVideo[end])
+        end--;
+
+      if (start <= end) {
+        S[n][0] = start - base;
+        S[n][1] = end - base;
+        n++;
+      }
     }
+    ChangedVideo[i].N = n;
+  }
 }
 #else
 #define OptimizeChangedVideo()                                                                     \
@@ -529,19 +516,18 @@ INLINE void OptimizeChangedVideo(void) {
 INLINE void SyncOldVideo(void) {
   ldat start, len;
   ldat i;
+  dat k;
 
   if (ChangedVideoFlag) {
-    for (i = 0; i < (ldat)DisplayHeight * 2; i++) {
-      start = ChangedVideo[i >> 1][i & 1][0];
-
-      if (start >= 0) {
-        len = ChangedVideo[i >> 1][i & 1][1] + 1 - start;
-        start += (i >> 1) * (ldat)DisplayWidth;
-
-        ChangedVideo[i >> 1][i & 1][0] = -1;
+    for (i = 0; i < (ldat)DisplayHeight; i++) {
+      for (k = 0; k < ChangedVideo[i].N; k++) {
+        start = ChangedVideo[i].Span[k][0];
+        len = ChangedVideo[i].Span[k][1] + 1 - start;
+        start += i * (ldat)DisplayWidth;
 
         CopyMem(Video + start, OldVideo + start, len * sizeof(tcell));
       }
+      ChangedVideo[i].N = 0;
     }
   }
 }
@@ -577,6 +563,10 @@ void FlushHW(void) {
   ValidOldVideo = ttrue;
 }
 
+/* twdisplay has a single display and always flushes it from the main thread */
+void SyncFrameHW(display_hw hw) {
+}
+
 void ResizeDisplayPrefer(display_hw D_HW) {
   SaveHW;
   SetHW(D_HW);
@@ -606,15 +596,15 @@ static byte ReAllocVideo(dat Width, dat Height) {
 
     if ((!(Video =
                (tcell *)ReAllocMem(Video, (ldat)DisplayWidth * DisplayHeight * sizeof(tcell))) ||
-         !(ChangedVideo =
-               (dat(*)[2][2])ReAllocMem(ChangedVideo, (ldat)DisplayHeight * sizeof(dat) * 4))) &&
+         !(ChangedVideo = (dirty_row *)ReAllocMem(ChangedVideo,
+                                                  (ldat)DisplayHeight * sizeof(dirty_row)))) &&
         DisplayWidth && DisplayHeight) {
 
       OutOfMemory();
       Quit(1);
     }
     ValidVideo = tfalse;
-    memset(ChangedVideo, 0xff, (ldat)DisplayHeight * sizeof(dat) * 4);
+    memset(ChangedVideo, 0, (ldat)DisplayHeight * sizeof(dirty_row));
   }
   return change;
 }
@@ -654,6 +644,8 @@ byte AllHWCanDragAreaNow(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat Ds
 
 void DragAreaHW(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp) {
   HW->DragArea(Left, Up, Rgt, Dwn, DstLeft, DstUp);
+  if (NeedOldVideo && OldVideo)
+    DragTCellArea(OldVideo, Left, Up, Rgt, Dwn, DstLeft, DstUp);
 }
 
 void SetPaletteHW(udat N, udat R, udat G, udat B) {
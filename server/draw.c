@@ -17,14 +17,39 @@
 #include "data.h"
 #include "methods.h"
 #include "hw.h"
+#include "hw_private.h"
 #include "hw_multi.h"
 #include "printk.h"
 #include "util.h"
 #include "draw.h"
+#include "hist.h"
 
 #include <Tutf/Tutf.h>
 #include <Tutf/Tutf_defs.h>
 
+#ifdef HAVE_THREAD_LOCAL
+#include <pthread.h>
+#include <signal.h>
+
+/*
+ * while DrawArea2() draws the bands of a large area in parallel, DrawBands is set
+ * and whatever touches state shared between bands or with the rest of the server
+ * (messages to clients, errors, caches filled while drawing rows, scrollback, borders
+ * and menus) runs one thread at a time, between LockDraw() and UnlockDraw()
+ */
+static byte DrawBands;
+static pthread_mutex_t DrawMutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define LockDraw() (DrawBands ? (void)pthread_mutex_lock(&DrawMutex) : (void)0)
+#define UnlockDraw() (DrawBands ? (void)pthread_mutex_unlock(&DrawMutex) : (void)0)
+#else
+#define DrawBands tfalse
+#define LockDraw() ((void)0)
+#define UnlockDraw() ((void)0)
+#endif
+
+udat DrawThreads;
+
 byte InitDraw(void) {
   return ttrue;
 }
@@ -319,14 +344,211 @@ void TranslateCoordsWidget(widget W1, widget W2, dat *X, dat *Y, byte *Inside) {
     *Inside = tfalse;
 }
 
+/*
+ * changes whenever top-level widgets are mapped, unmapped, restacked, moved or resized:
+ * the grid of FindWidgetAt() and the visible regions of DrawPartialWidget()
+ * are valid only as long as it stays the same.
+ */
+static uldat VisibleSerial = 1;
+
+void InvalidateVisibleRegions(void) {
+  VisibleSerial++;
+}
+
+/*
+ * mouse events are searched in the children of the screen, which are many
+ * and mostly stay in place. so split the part of the screen shown on display
+ * in a grid of at most HITGRID_COLS * HITGRID_ROWS cells, and list in each cell
+ * the children overlapping it, in stacking order:
+ * finding the child at (X,Y) only checks the ones listed in its cell.
+ * raising or lowering a child only reorders the cells it is listed in,
+ * other changes build the grid again at next search.
+ */
+#define HITGRID_COLS 32
+#define HITGRID_ROWS 16
+
+typedef struct s_hitgrid {
+  screen Screen;
+  uldat Serial; /* VisibleSerial when built */
+  ldat XLogic, YLogic;
+  dat YLimit, DWidth, DHeight;
+  ldat Left, Up, Rgt, Dwn; /* area covered by the grid, in Screen logical coords */
+  ldat CellWidth, CellHeight;
+  uldat Cell[HITGRID_COLS * HITGRID_ROWS + 1]; /* Item[Cell[c] ... Cell[c+1] - 1] are in cell c */
+  widget *Item;
+  uldat MaxItem;
+} hitgrid;
+
+/* grid of the screen last searched */
+static hitgrid HitGrid;
+
+INLINE ldat HeightWidget(widget W) {
+  return IS_WINDOW(W) && (((window)W)->Attrib & WINDOW_ROLLED_UP) ? 1 : W->YWidth;
+}
+
+INLINE byte ContainsWidget(widget W, ldat i, ldat j) {
+  return (ldat)W->Left <= i && (ldat)W->Left + W->XWidth > i && (ldat)W->Up <= j &&
+         (ldat)W->Up + HeightWidget(W) > j;
+}
+
+/* find the cells x1...x2, y1...y2 of G overlapped by W. return tfalse if none */
+static byte HitGridCells(CONST hitgrid *G, widget W, ldat *x1, ldat *y1, ldat *x2, ldat *y2) {
+  ldat Left = Max2((ldat)W->Left, G->Left), Up = Max2((ldat)W->Up, G->Up);
+  ldat Rgt = Min2((ldat)W->Left + W->XWidth - 1, G->Rgt);
+  ldat Dwn = Min2((ldat)W->Up + HeightWidget(W) - 1, G->Dwn);
+
+  if ((W->Flags & WIDGETFL_NOTVISIBLE) || Left > Rgt || Up > Dwn)
+    return tfalse;
+  *x1 = (Left - G->Left) / G->CellWidth;
+  *y1 = (Up - G->Up) / G->CellHeight;
+  *x2 = (Rgt - G->Left) / G->CellWidth;
+  *y2 = (Dwn - G->Up) / G->CellHeight;
+  return ttrue;
+}
+
+static byte BuildHitGrid(hitgrid *G, screen Screen) {
+  widget W, *Item;
+  ldat x1, y1, x2, y2, x, y;
+  uldat c, n, Max;
+
+  G->Screen = NULL;
+  G->XLogic = Screen->XLogic;
+  G->YLogic = Screen->YLogic;
+  G->YLimit = Screen->YLimit;
+  G->DWidth = All->DisplayWidth;
+  G->DHeight = All->DisplayHeight;
+
+  /* FindWidgetAt() never searches the menu row */
+  G->Left = G->XLogic;
+  G->Up = G->YLogic + 1;
+  G->Rgt = G->Left + G->DWidth - 1;
+  G->Dwn = G->YLogic + G->DHeight - G->YLimit - 1;
+  if (G->Left > G->Rgt || G->Up > G->Dwn)
+    return tfalse;
+  G->CellWidth = (G->Rgt - G->Left + HITGRID_COLS) / HITGRID_COLS;
+  G->CellHeight = (G->Dwn - G->Up + HITGRID_ROWS) / HITGRID_ROWS;
+
+  /* count the children in each cell, in Cell[c + 1] */
+  for (c = 0; c <= HITGRID_COLS * HITGRID_ROWS; c++)
+    G->Cell[c] = 0;
+  for (n = 0, W = Screen->FirstW; W; W = W->Next) {
+    if (!HitGridCells(G, W, &x1, &y1, &x2, &y2))
+      continue;
+    for (y = y1; y <= y2; y++)
+      for (x = x1; x <= x2; x++, n++)
+        G->Cell[y * HITGRID_COLS + x + 1]++;
+  }
+  if (n > G->MaxItem) {
+    Max = n + n / 2;
+    if (!(Item = (widget *)ReAllocMem(G->Item, Max * sizeof(widget))))
+      return tfalse;
+    G->Item = Item;
+    G->MaxItem = Max;
+  }
+  /* now Cell[c] is the start of cell c... */
+  for (c = 0; c < HITGRID_COLS * HITGRID_ROWS; c++)
+    G->Cell[c + 1] += G->Cell[c];
+
+  /* ...which becomes the start of cell c + 1 while filling it */
+  for (W = Screen->FirstW; W; W = W->Next) {
+    if (!HitGridCells(G, W, &x1, &y1, &x2, &y2))
+      continue;
+    for (y = y1; y <= y2; y++)
+      for (x = x1; x <= x2; x++)
+        G->Item[G->Cell[y * HITGRID_COLS + x]++] = W;
+  }
+  for (c = HITGRID_COLS * HITGRID_ROWS; c; c--)
+    G->Cell[c] = G->Cell[c - 1];
+  G->Cell[0] = 0;
+
+  G->Screen = Screen;
+  G->Serial = VisibleSerial;
+  return ttrue;
+}
+
+/* return the grid of Screen, or NULL if scanning its children is cheaper */
+static hitgrid *GetHitGrid(screen Screen) {
+  hitgrid *G = &HitGrid;
+  byte State;
+
+  if (G->Screen == Screen && G->Serial == VisibleSerial && G->XLogic == Screen->XLogic &&
+      G->YLogic == Screen->YLogic && G->YLimit == Screen->YLimit &&
+      G->DWidth == All->DisplayWidth && G->DHeight == All->DisplayHeight)
+    return G;
+
+  /*
+   * while a window or the screen is being dragged or resized, each mouse event
+   * follows a change: do not build a grid only to search it once
+   */
+  State = All->State & STATE_ANY;
+  if (State == STATE_DRAG || State == STATE_RESIZE || State == STATE_SCREEN)
+    return NULL;
+  return BuildHitGrid(G, Screen) ? G : NULL;
+}
+
+/*
+ * W was just raised or lowered, i.e. it is now the first or the last child of its screen:
+ * move it to the same end of the cells of the grid it is listed in, which do not change.
+ * return tfalse if the grid must be built again instead.
+ */
+static byte RestackHitGrid(widget W) {
+  hitgrid *G = &HitGrid;
+  ldat x1, y1, x2, y2, x, y;
+  uldat c, i, start, end;
+  byte First;
+
+  if (G->Screen != (screen)W->Parent || G->Serial != VisibleSerial)
+    return tfalse;
+  if (!(First = W == W->Parent->FirstW) && W != W->Parent->LastW)
+    return tfalse;
+  if (!HitGridCells(G, W, &x1, &y1, &x2, &y2))
+    /* not listed anywhere */
+    return ttrue;
+
+  for (y = y1; y <= y2; y++) {
+    for (x = x1; x <= x2; x++) {
+      c = y * HITGRID_COLS + x;
+      start = G->Cell[c];
+      end = G->Cell[c + 1];
+      for (i = start; i < end && G->Item[i] != W; i++)
+        ;
+      if (i == end) {
+        G->Screen = NULL;
+        return tfalse;
+      }
+      if (First) {
+        MoveMem(G->Item + start, G->Item + start + 1, (i - start) * sizeof(widget));
+        G->Item[start] = W;
+      } else {
+        MoveMem(G->Item + i + 1, G->Item + i, (end - i - 1) * sizeof(widget));
+        G->Item[end - 1] = W;
+      }
+    }
+  }
+  return ttrue;
+}
+
+void DrawRestackedWidget(widget W) {
+  byte Keep = RestackHitGrid(W);
+
+  if (IS_WINDOW(W))
+    DrawAreaWindow2((window)W);
+  else
+    DrawAreaWidget(W);
+  /* drawing moves nothing: the grid updated above is still valid */
+  if (Keep)
+    HitGrid.Serial = VisibleSerial;
+}
+
 /*
  * find the widget at given coordinates inside Parent
  * --- (0,0) is the Parent top-left corner
  */
 widget FindWidgetAt(widget Parent, dat X, dat Y) {
   widget W;
+  hitgrid *G;
   ldat i, j;
-  dat height;
+  uldat c, end;
 
   if (IS_WINDOW(Parent) && !(((window)Parent)->Flags & WINDOWFL_BORDERLESS))
     X--, Y--;
@@ -335,21 +557,25 @@ widget FindWidgetAt(widget Parent, dat X, dat Y) {
     return (widget)0;
   }
 
+  i = X + Parent->XLogic;
+  j = Y + Parent->YLogic;
+
+  if (IS_SCREEN(Parent) && (G = GetHitGrid((screen)Parent)) && i >= G->Left && i <= G->Rgt &&
+      j >= G->Up && j <= G->Dwn) {
+    c = (j - G->Up) / G->CellHeight * HITGRID_COLS + (i - G->Left) / G->CellWidth;
+    for (end = G->Cell[c + 1], c = G->Cell[c]; c < end; c++) {
+      if (ContainsWidget(W = G->Item[c], i, j))
+        return W;
+    }
+    return (widget)0;
+  }
+
   for (W = Parent->FirstW; W; W = W->Next) {
 
     if (W->Flags & WIDGETFL_NOTVISIBLE)
       continue;
 
-    i = X + Parent->XLogic;
-    j = Y + Parent->YLogic;
-
-    if (!IS_WINDOW(W) || !(((window)W)->Attrib & WINDOW_ROLLED_UP))
-      height = W->YWidth;
-    else
-      height = 1;
-
-    if ((ldat)W->Left <= i && (ldat)W->Left + W->XWidth > i && (ldat)W->Up <= j &&
-        (ldat)W->Up + height > j)
+    if (ContainsWidget(W, i, j))
       return W;
   }
   return (widget)0;
@@ -374,6 +600,333 @@ widget RecursiveFindWidgetAt(widget Parent, dat X, dat Y) {
   return Parent;
 }
 
+/*
+ * the backing store of a window holds its XWidth * YWidth cells as last drawn by DrawWCtx()
+ * without shadows. each row v is valid from column Span[2*v] to Span[2*v+1], or not at all
+ * if the former is bigger: drawing the window extends the spans, DamageBackStore() shrinks them.
+ */
+struct s_backstore {
+  window W;
+  backstore *Prev, *Next; /* most recently used first */
+  uldat Size;             /* bytes allocated */
+  dat XWidth, YWidth;
+  /* if these change, the whole store is invalid */
+  ldat XLogic, YLogic;
+  uldat Flags;
+  byte RolledUp;
+  /* if these change, the border is invalid */
+  ldat WLogic, HLogic;
+  uldat Attrib, State, Focus;
+  tcell *Cell;
+  dat *Span;
+};
+
+/* the window flags that change how its contents are drawn */
+#define BACKSTORE_FLAGS                                                                            \
+  (WINDOWFL_USEANY | WINDOWFL_MENU | WINDOWFL_DISABLED | WINDOWFL_BORDERLESS |                     \
+   WINDOWFL_ROWS_DEFCOL | WINDOWFL_ROWS_SELCURRENT)
+
+uldat BackStoreMax = BACKSTORE_MAX_DEFAULT;
+static uldat BackStoreUsed;
+static backstore *BackStoreFirst, *BackStoreLast;
+
+/* set by DrawSelfWidget() when it asks a client to draw, leaving Video[] as it was */
+static byte BackStoreMiss;
+
+static void UnlinkBackStore(backstore *S) {
+  if (S->Prev)
+    S->Prev->Next = S->Next;
+  else
+    BackStoreFirst = S->Next;
+  if (S->Next)
+    S->Next->Prev = S->Prev;
+  else
+    BackStoreLast = S->Prev;
+}
+
+static void LinkBackStore(backstore *S) {
+  S->Prev = NULL;
+  if ((S->Next = BackStoreFirst))
+    BackStoreFirst->Prev = S;
+  else
+    BackStoreLast = S;
+  BackStoreFirst = S;
+}
+
+void DeleteBackStore(window W) {
+  backstore *S = W->Store;
+
+  if (S) {
+    UnlinkBackStore(S);
+    BackStoreUsed -= S->Size;
+    FreeMem(S);
+    W->Store = NULL;
+  }
+}
+
+void ClearBackStores(void) {
+  while (BackStoreFirst)
+    DeleteBackStore(BackStoreFirst->W);
+}
+
+static void EmptyBackStore(backstore *S) {
+  dat v;
+
+  for (v = 0; v < S->YWidth; v++) {
+    S->Span[2 * v] = S->XWidth;
+    S->Span[2 * v + 1] = -1;
+  }
+}
+
+/* remove columns u1..u2 from a span */
+static void DamageSpan(dat *Span, ldat u1, ldat u2, dat XWidth) {
+  if (u2 < Span[0] || u1 > Span[1])
+    return;
+  if (u1 <= Span[0] && u2 >= Span[1]) {
+    Span[0] = XWidth;
+    Span[1] = -1;
+  } else if (u1 <= Span[0])
+    Span[0] = u2 + 1;
+  else if (u2 >= Span[1])
+    Span[1] = u1 - 1;
+  else if (u1 - Span[0] >= Span[1] - u2)
+    /* damage in the middle: keep the wider side */
+    Span[1] = u1 - 1;
+  else
+    Span[0] = u2 + 1;
+}
+
+/* add columns u1..u2 to a span */
+static void MergeSpan(dat *Span, ldat u1, ldat u2) {
+  if (u1 > u2)
+    return;
+  if (Span[0] <= Span[1] && u1 <= Span[1] + 1 && u2 + 1 >= Span[0]) {
+    Span[0] = Min2(Span[0], u1);
+    Span[1] = Max2(Span[1], u2);
+  } else if (Span[0] > Span[1] || u2 - u1 >= Span[1] - Span[0]) {
+    /* not adjacent: keep the wider span */
+    Span[0] = u1;
+    Span[1] = u2;
+  }
+}
+
+static void DamageStoreRect(backstore *S, ldat u1, ldat v1, ldat u2, ldat v2) {
+  dat *Span;
+
+  u1 = Max2(u1, 0);
+  v1 = Max2(v1, 0);
+  u2 = Min2(u2, (ldat)S->XWidth - 1);
+  v2 = Min2(v2, (ldat)S->YWidth - 1);
+  if (u1 > u2)
+    return;
+
+  for (Span = S->Span + 2 * v1; v1 <= v2; v1++, Span += 2)
+    DamageSpan(Span, u1, u2, S->XWidth);
+}
+
+static void DamageStoreBorder(backstore *S, byte Flags) {
+  if (S->Flags & WINDOWFL_BORDERLESS)
+    return;
+  if (Flags & BORDER_UP)
+    DamageStoreRect(S, 0, 0, S->XWidth - 1, 0);
+  if (Flags & BORDER_DOWN)
+    DamageStoreRect(S, 0, S->YWidth - 1, S->XWidth - 1, S->YWidth - 1);
+  if (Flags & BORDER_LEFT)
+    DamageStoreRect(S, 0, 0, 0, S->YWidth - 1);
+  if (Flags & BORDER_RIGHT)
+    DamageStoreRect(S, S->XWidth - 1, 0, S->XWidth - 1, S->YWidth - 1);
+}
+
+/* what, besides Attrib and State, changes how DrawSelfBorder() and FindBorder() draw W */
+static uldat FocusBackStore(window W) {
+  screen Screen = All->FirstScreen;
+
+  if ((widget)W == Screen->FocusW)
+    return 1 | (All->State & STATE_ANY) << 1;
+  return W == Screen->MenuWindow;
+}
+
+/* forget the parts of S drawn when W looked different */
+static void CheckBackStore(backstore *S, window W) {
+  uldat Focus = FocusBackStore(W);
+
+  if (S->XLogic != W->XLogic || S->YLogic != W->YLogic ||
+      S->Flags != (W->Flags & BACKSTORE_FLAGS) ||
+      S->RolledUp != !!(W->Attrib & WINDOW_ROLLED_UP)) {
+    EmptyBackStore(S);
+    S->XLogic = W->XLogic;
+    S->YLogic = W->YLogic;
+    S->Flags = W->Flags & BACKSTORE_FLAGS;
+    S->RolledUp = !!(W->Attrib & WINDOW_ROLLED_UP);
+  } else if (S->WLogic != W->WLogic || S->HLogic != W->HLogic || S->Attrib != W->Attrib ||
+             S->State != W->State || S->Focus != Focus)
+    DamageStoreBorder(S, BORDER_ANY);
+
+  S->WLogic = W->WLogic;
+  S->HLogic = W->HLogic;
+  S->Attrib = W->Attrib;
+  S->State = W->State;
+  S->Focus = Focus;
+}
+
+/* return the store of top-level window W, allocating it if Create */
+static backstore *GetBackStore(window W, byte Create) {
+  backstore *S = W->Store;
+  ldat Cells = (ldat)W->XWidth * W->YWidth;
+  uldat Size;
+
+  if (S && (!(W->Flags & WINDOWFL_BACKSTORE) || S->XWidth != W->XWidth ||
+            S->YWidth != W->YWidth)) {
+    DeleteBackStore(W);
+    S = NULL;
+  }
+  if (S) {
+    CheckBackStore(S, W);
+    return S;
+  }
+  if (!Create || !(W->Flags & WINDOWFL_BACKSTORE) || Cells <= 0 ||
+      (uldat)Cells > BackStoreMax / (sizeof(tcell) + sizeof(dat)))
+    return NULL;
+
+  Size = sizeof(backstore) + Cells * sizeof(tcell) + 2 * W->YWidth * sizeof(dat);
+  if (Size > BackStoreMax)
+    return NULL;
+  while (BackStoreLast && BackStoreUsed + Size > BackStoreMax)
+    DeleteBackStore(BackStoreLast->W);
+
+  if (!(S = (backstore *)AllocMem(Size)))
+    return NULL;
+  S->W = W;
+  S->Size = Size;
+  S->XWidth = W->XWidth;
+  S->YWidth = W->YWidth;
+  S->Cell = (tcell *)(S + 1);
+  S->Span = (dat *)(S->Cell + Cells);
+  /* mismatch XLogic, so that CheckBackStore() initializes everything */
+  S->XLogic = W->XLogic + 1;
+  CheckBackStore(S, W);
+
+  LinkBackStore(S);
+  BackStoreUsed += Size;
+  return W->Store = S;
+}
+
+/* copy cells X1..X2, Y1..Y2 of Video[] from the store, if it has them all */
+static byte DrawBackStore(backstore *S, dat X1, dat Y1, dat X2, dat Y2, ldat Left, ldat Up,
+                          ldat DWidth) {
+  ldat u = X1 - Left, v, j;
+  CONST dat *Span;
+
+  for (v = Y1 - Up, Span = S->Span + 2 * v; v <= Y2 - Up; v++, Span += 2) {
+    if (Span[0] > u || Span[1] < X2 - Left)
+      return tfalse;
+  }
+  for (j = Y1, v = Y1 - Up; j <= Y2; j++, v++)
+    CopyMem(S->Cell + u + v * S->XWidth, &Video[X1 + j * DWidth],
+            (X2 - X1 + 1) * sizeof(tcell));
+  DirtyVideo(X1, Y1, X2, Y2);
+
+  if (S != BackStoreFirst) {
+    UnlinkBackStore(S);
+    LinkBackStore(S);
+  }
+  return ttrue;
+}
+
+/* copy cells X1..X2, Y1..Y2 of Video[], just drawn, to the store */
+static void SaveBackStore(backstore *S, dat X1, dat Y1, dat X2, dat Y2, ldat Left, ldat Up,
+                          ldat DWidth) {
+  ldat u1 = X1 - Left, u2 = X2 - Left, v, j;
+  dat *Span;
+
+  for (j = Y1, v = Y1 - Up, Span = S->Span + 2 * v; j <= Y2; j++, v++, Span += 2) {
+    CopyMem(&Video[X1 + j * DWidth], S->Cell + u1 + v * S->XWidth,
+            (X2 - X1 + 1) * sizeof(tcell));
+    MergeSpan(Span, u1, u2);
+  }
+}
+
+void DamageBackStore(widget W, ldat X1, ldat Y1, ldat X2, ldat Y2) {
+  widget P;
+  ldat dX, dY;
+  byte HasBorder;
+
+  if (!BackStoreFirst)
+    return;
+
+  while (W && (P = W->Parent) && !IS_SCREEN(P)) {
+    HasBorder = IS_WINDOW(P) && !(((window)P)->Flags & WINDOWFL_BORDERLESS);
+    dX = (ldat)W->Left - P->XLogic + HasBorder;
+    dY = (ldat)W->Up - P->YLogic + HasBorder;
+    X1 += dX, X2 += dX;
+    Y1 += dY, Y2 += dY;
+    W = P;
+  }
+  if (W && IS_WINDOW(W) && ((window)W)->Store)
+    DamageStoreRect(((window)W)->Store, X1, Y1, X2, Y2);
+}
+
+void ScrollBackStore(window W, ldat X1, ldat Y1, ldat X2, ldat Y2, ldat DeltaX, ldat DeltaY) {
+  backstore *S = W->Store;
+  ldat d1, d2, v, sv, dv;
+  dat *Span, Src[2];
+  tcell *Cell;
+
+  if (!S)
+    return;
+  X1 = Max2(X1, 0);
+  Y1 = Max2(Y1, 0);
+  X2 = Min2(X2, (ldat)S->XWidth - 1);
+  Y2 = Min2(Y2, (ldat)S->YWidth - 1);
+  if (X1 > X2 || Y1 > Y2)
+    return;
+  if (Abs(DeltaX) > X2 - X1 || Abs(DeltaY) > Y2 - Y1) {
+    DamageStoreRect(S, X1, Y1, X2, Y2);
+    return;
+  }
+
+  /* the columns that receive cells */
+  d1 = X1 + Max2(DeltaX, 0);
+  d2 = X2 + Min2(DeltaX, 0);
+
+  /* go against the scroll, so that each row is read before being overwritten */
+  dv = DeltaY > 0 ? -1 : 1;
+  for (v = DeltaY > 0 ? Y2 : Y1; v >= Y1 && v <= Y2; v += dv) {
+    Span = S->Span + 2 * v;
+    sv = v - DeltaY;
+    if (sv < Y1 || sv > Y2) {
+      DamageSpan(Span, X1, X2, S->XWidth);
+      continue;
+    }
+    Src[0] = S->Span[2 * sv];
+    Src[1] = S->Span[2 * sv + 1];
+    Cell = S->Cell + v * S->XWidth;
+    MoveMem(S->Cell + sv * S->XWidth + d1 - DeltaX, Cell + d1, (d2 - d1 + 1) * sizeof(tcell));
+
+    DamageSpan(Span, X1, X2, S->XWidth);
+    if (Src[0] <= Src[1])
+      MergeSpan(Span, Max2(Src[0] + DeltaX, d1), Min2(Src[1] + DeltaX, d2));
+  }
+}
+
+/* DamageBackStore() the cells that show logical X1..X2, Y1..Y2 of W */
+static void DamageLogicBackStore(widget W, ldat X1, ldat Y1, ldat X2, ldat Y2) {
+  ldat XL = W->XLogic, YL = W->YLogic;
+  byte HasBorder;
+
+  if (!BackStoreFirst)
+    return;
+
+  HasBorder = IS_WINDOW(W) && !(((window)W)->Flags & WINDOWFL_BORDERLESS);
+  X1 = Max2(X1, XL);
+  X2 = Min2(X2, XL + (ldat)W->XWidth - 1 - 2 * HasBorder);
+  Y1 = Max2(Y1, YL);
+  Y2 = Min2(Y2, YL + (ldat)W->YWidth - 1 - 2 * HasBorder);
+  if (X1 <= X2 && Y1 <= Y2)
+    DamageBackStore(W, X1 - XL + HasBorder, Y1 - YL + HasBorder, X2 - XL + HasBorder,
+                    Y2 - YL + HasBorder);
+}
+
 void DrawSelfWidget(draw_ctx *D) {
   widget W = D->TopW;
 
@@ -511,6 +1064,9 @@ void DrawSelfWidget(draw_ctx *D) {
       msg Msg;
       event_widget *EventW;
 
+      LockDraw();
+      BackStoreMiss = ttrue;
+
       if ((Msg = Do(Create, Msg)(FnMsg, MSG_WIDGET_CHANGE, 0))) {
         EventW = &Msg->Event.EventWidget;
         EventW->W = W;
@@ -522,6 +1078,7 @@ void DrawSelfWidget(draw_ctx *D) {
         EventW->Y = Y1 - Up;
         SendMsg(W->Owner, Msg);
       }
+      UnlockDraw();
     }
   } else
     FillVideo(D->X1, D->Y1, D->X2, D->Y2, W->USE_Fill);
@@ -672,14 +1229,14 @@ void DrawSelfWindow(draw_ctx *D) {
   }
 
   {
-    CONST tcell *Contents, *CurrCont;
+    CONST tcell *CurrCont;
     CONST trune *TRune;
     tcolor *ColText;
     ldat Left, Up, Rgt;
     ldat DWidth, i, j, u, v; /* (ldat) to avoid multiplication overflows */
-    ldat Row, PosInRow;
+    ldat Row, PosInRow, NumRowSplit;
     trune Font;
-    row CurrRow;
+    row CurrRow, RowSplit = (row)0;
     dat X1, Y1, X2, Y2;
     byte Shaded, Absent;
     byte Select, RowDisabled;
@@ -701,15 +1258,12 @@ void DrawSelfWindow(draw_ctx *D) {
      * Up   -= W->YLogic; Dwn -= W->YLogic;
      */
 
-    if (W_USE(W, USECONTENTS) && (Contents = W->USE.C.Contents)) {
+    if (W_USE(W, USECONTENTS) && W->USE.C.Contents) {
       /*
-       * For xterm-like windows, Contents is a buffer of (x=WLogic) * (y=HLogic)
-       * tcell:s, in the same format as Video: TCELL(Color, Ascii).
-       * Room in excess is used as scrollback.
-       *
-       * To avoid frequent mem-mem copies, VGA-like splitline method is used:
-       * USE.C.Split is the first used line of Contents, and after the end
-       * of Contents we restart from zero.
+       * For xterm-like windows, lines are TCELL(Color, Ascii) like Video.
+       * The visible ones are a buffer of (x=WLogic) * (y=SizeY) tcell:s in Contents,
+       * the others are scrollback and are kept compressed in Hist.
+       * ContentsLine() finds both.
        *
        * HLogic also has the usual meaning:
        * number of total lines (visible + scrollback)
@@ -727,15 +1281,11 @@ void DrawSelfWindow(draw_ctx *D) {
         X2 = Xnew - 1;
       }
       if (X1 <= X2 && Y1 <= Y2) {
-        Row = Y1 - Up + W->USE.C.HSplit; /* row number in Contents */
-        if (Row >= W->HLogic)
-          Row -= W->HLogic;
-        CurrCont = Contents + Row * W->WLogic;
-
-        Row = W->HLogic - 1 - Row; /* rows still readable */
-
         if (!Shaded) {
-          for (j = Y1, u = Y1 - Up; j <= Y2; j++, u++, Row--) {
+          for (j = Y1, u = Y1 - Up; j <= Y2; j++, u++) {
+            /* lines from the scrollback share a buffer */
+            LockDraw();
+            CurrCont = ContentsLine(W, u);
             if (!(W->State & WINDOW_DO_SEL) || u < W->YstSel || u > W->YendSel) {
 
               CopyMem(CurrCont + X1 - Left, &Video[X1 + j * (ldat)DWidth],
@@ -754,12 +1304,12 @@ void DrawSelfWindow(draw_ctx *D) {
                 Video[i + j * (ldat)DWidth] = TCELL(Color, TRUNEEXTRA(CurrCont[v]));
               }
             }
-            CurrCont += W->WLogic;
-            if (!Row)
-              CurrCont -= (Row = W->HLogic) * W->WLogic;
+            UnlockDraw();
           }
         } else {
-          for (j = Y1, u = Y1 - Up; j <= Y2; j++, u++, Row--) {
+          for (j = Y1, u = Y1 - Up; j <= Y2; j++, u++) {
+            LockDraw();
+            CurrCont = ContentsLine(W, u);
             for (i = X1, v = X1 - Left; i <= X2; i++, v++) {
 
               Select = (W->State & WINDOW_DO_SEL) &&
@@ -774,9 +1324,7 @@ void DrawSelfWindow(draw_ctx *D) {
 
               Video[i + j * (ldat)DWidth] = TCELL(Color, TRUNEEXTRA(CurrCont[v]));
             }
-            CurrCont += W->WLogic;
-            if (!Row)
-              CurrCont -= (Row = W->HLogic) * W->WLogic;
+            UnlockDraw();
           }
         }
         DirtyVideo(X1, Y1, X2, Y2);
@@ -787,6 +1335,7 @@ void DrawSelfWindow(draw_ctx *D) {
        */
       Row = Y1 - Up;
 
+      LockDraw();
       if (Row >= W->HLogic)
         CurrRow = (row)0;
       else if (W->USE.R.NumRowSplit && W->USE.R.RowSplit && Row == W->USE.R.NumRowSplit)
@@ -802,6 +1351,7 @@ void DrawSelfWindow(draw_ctx *D) {
         CurrRow = W->USE.R.LastRow;
       else
         CurrRow = Act(FindRow, W)(W, Row);
+      UnlockDraw();
 
       for (j = Y1; j <= Y2; j++, Row++) {
 
@@ -851,11 +1401,17 @@ void DrawSelfWindow(draw_ctx *D) {
           Video[i + j * (ldat)DWidth] = TCELL(Color, Font);
         }
         if (CurrRow) {
-          W->USE.R.RowSplit = CurrRow;
-          W->USE.R.NumRowSplit = Row;
+          RowSplit = CurrRow;
+          NumRowSplit = Row;
           CurrRow = CurrRow->Next;
         }
       }
+      if (RowSplit) {
+        LockDraw();
+        W->USE.R.RowSplit = RowSplit;
+        W->USE.R.NumRowSplit = NumRowSplit;
+        UnlockDraw();
+      }
       DirtyVideo(X1, Y1, X2, Y2);
     } else {
       /* either an unknown window type or just one of the above, but empty */
@@ -871,12 +1427,59 @@ void DrawSelfScreen(draw_ctx *D) {
   printk("twin: DrawSelfScreen() called! This is not good...\n");
 }
 
+/*
+ * the draw_ctx queued while splitting an area around overlapping widgets live only until
+ * DrawWCtx() or DrawAreaCtx() pick them up, and a single DrawArea2() can queue thousands.
+ * take them from a free list, refilled DRAWCTX_CHUNK at a time, instead of AllocMem()ing
+ * each one: all of them are back in the list when the outermost DrawArea2() returns.
+ * threads drawing bands for DrawArea2() have a list and stats of their own.
+ */
+#define DRAWCTX_CHUNK 64
+
+drawctx_stats DrawCtxStats;
+static THREAD_LOCAL drawctx_stats *CtxStats = &DrawCtxStats;
+static THREAD_LOCAL draw_ctx *DrawCtxPool;
+
+static draw_ctx *AllocDrawCtx(void) {
+  draw_ctx *D;
+  uldat i;
+
+  if (!DrawCtxPool) {
+    if (!(D = (draw_ctx *)AllocMem(DRAWCTX_CHUNK * sizeof(draw_ctx))))
+      return NULL;
+    for (i = 0; i < DRAWCTX_CHUNK - 1; i++)
+      D[i].Next = D + i + 1;
+    D[i].Next = NULL;
+    DrawCtxPool = D;
+    CtxStats->Chunks++;
+  }
+  D = DrawCtxPool;
+  DrawCtxPool = D->Next;
+
+  CtxStats->Allocs++;
+  if (++CtxStats->Used > CtxStats->Peak)
+    CtxStats->Peak = CtxStats->Used;
+  return D;
+}
+
+static void FreeDrawCtx(draw_ctx *D) {
+  D->Next = DrawCtxPool;
+  DrawCtxPool = D;
+  CtxStats->Used--;
+}
+
+/* start counting the draw_ctx of a new frame */
+void FrameDrawCtxStats(void) {
+  DrawCtxStats.LastAllocs = DrawCtxStats.Allocs;
+  DrawCtxStats.Allocs = 0;
+}
+
 static void _DrawWCtx_(draw_ctx **FirstD, widget W, widget ChildNext, widget OnlyChild, ldat Left,
                        ldat Up, ldat Rgt, ldat Dwn, dat X1, dat Y1, dat X2, dat Y2, byte NoChildren,
                        byte BorderDone, byte Shaded, byte *lError) {
   draw_ctx *D;
   if (!QueuedDrawArea2FullScreen) {
-    if ((D = (draw_ctx *)AllocMem(sizeof(draw_ctx)))) {
+    if ((D = AllocDrawCtx())) {
       D->TopW = W;
       D->W = ChildNext;
       D->OnlyW = OnlyChild;
@@ -915,10 +1518,36 @@ static void DrawWCtx(draw_ctx *D) {
   byte ChildFound = tfalse, lError = tfalse, FirstCycle = ttrue;
   dat DWidth, DHeight;
   ldat cL, cU, cR, cD;
+  window StoreW;
+  backstore *Store;
+  dat sX1, sY1, sX2, sY2;
+  ldat sLeft, sUp;
 
   if (QueuedDrawArea2FullScreen)
     return;
 
+  /* top-level windows with a backing store: copy from it, or save there what gets drawn */
+  StoreW = NULL;
+  if (BackStoreMax && !DrawBands && !D->Next && !D->W && !D->BorderDone && !D->Shaded &&
+      (!D->OnlyW || D->OnlyW == D->TopW) && IS_WINDOW(D->TopW) &&
+      (((window)D->TopW)->Flags & WINDOWFL_BACKSTORE) && D->TopW->Parent &&
+      IS_SCREEN(D->TopW->Parent)) {
+
+    X1 = Max2(D->X1, Max2(D->Left, 0));
+    Y1 = Max2(D->Y1, Max2(D->Up, 0));
+    X2 = Min2(D->X2, Min2(D->Rgt, D->DWidth - 1));
+    Y2 = Min2(D->Y2, Min2(D->Dwn, D->DHeight - 1));
+    if (X1 <= X2 && Y1 <= Y2) {
+      StoreW = (window)D->TopW;
+      if ((Store = GetBackStore(StoreW, tfalse)) &&
+          DrawBackStore(Store, X1, Y1, X2, Y2, D->Left, D->Up, D->DWidth))
+        return;
+      sX1 = X1, sY1 = Y1, sX2 = X2, sY2 = Y2;
+      sLeft = D->Left, sUp = D->Up;
+      BackStoreMiss = tfalse;
+    }
+  }
+
   do {
     W = D->TopW;
     ChildNext = D->W;
@@ -958,7 +1587,10 @@ static void DrawWCtx(draw_ctx *D) {
           WinActive =
               Window == (window)All->FirstScreen->FocusW || Window == All->FirstScreen->MenuWindow;
           Border = (Window->Flags & WINDOWFL_MENU) || !WinActive;
+          /* FindBorder() may fill Window->BorderPattern[] */
+          LockDraw();
           DrawSelfBorder(Window, Left, Up, Rgt, Dwn, X1, Y1, X2, Y2, Border, WinActive, Shaded);
+          UnlockDraw();
         }
 
         if ((ldat)X1 == Left++)
@@ -986,7 +1618,7 @@ static void DrawWCtx(draw_ctx *D) {
 
     if (X1 > X2 || Y1 > Y2 || X1 >= DWidth || Y1 >= DHeight || X2 < 0 || Y2 < 0) {
       if (!FirstCycle)
-        FreeMem(D);
+        FreeDrawCtx(D);
       else
         FirstCycle = tfalse;
       continue;
@@ -1021,7 +1653,7 @@ static void DrawWCtx(draw_ctx *D) {
     }
 
     if (!FirstCycle)
-      FreeMem(D);
+      FreeDrawCtx(D);
     else
       FirstCycle = tfalse;
 
@@ -1063,8 +1695,14 @@ static void DrawWCtx(draw_ctx *D) {
     }
   } while ((D = FirstD));
 
-  if (lError)
+  if (StoreW && !lError && !BackStoreMiss && (Store = GetBackStore(StoreW, ttrue)))
+    SaveBackStore(Store, sX1, sY1, sX2, sY2, sLeft, sUp, DWidth);
+
+  if (lError) {
+    LockDraw();
     Error(lError);
+    UnlockDraw();
+  }
 }
 
 /*
@@ -1073,6 +1711,9 @@ static void DrawWCtx(draw_ctx *D) {
 void DrawWidget(widget W, dat X1, dat Y1, dat X2, dat Y2, byte Shaded) {
   draw_ctx D;
 
+  /* top-level widgets are redrawn here only when exposed */
+  if (W && W->Parent && !IS_SCREEN(W->Parent))
+    DamageBackStore(W, 0, 0, (ldat)W->XWidth - 1, (ldat)W->YWidth - 1);
   if (!QueuedDrawArea2FullScreen && W && InitAbsoluteDrawCtx(W, X1, Y1, X2, Y2, Shaded, &D)) {
     D.TopW = W;
     D.W = D.OnlyW = NULL;
@@ -1089,6 +1730,9 @@ static void DrawAreaCtx(draw_ctx *D);
 void DrawAreaWidget(widget W) {
   draw_ctx D;
 
+  InvalidateVisibleRegions();
+  if (W)
+    DamageBackStore(W, 0, 0, (ldat)W->XWidth - 1, (ldat)W->YWidth - 1);
   if (!QueuedDrawArea2FullScreen && W &&
       InitAbsoluteDrawCtx(W, 0, 0, TW_MAXDAT, TW_MAXDAT, tfalse, &D)) {
     D.TopW = D.W = D.OnlyW = NULL;
@@ -1100,7 +1744,7 @@ static void _DrawAreaCtx_(draw_ctx **FirstD, screen Screen, widget W, widget Onl
                           dat X2, dat Y2, byte Shaded, byte *lError) {
   draw_ctx *D;
   if (!QueuedDrawArea2FullScreen) {
-    if ((D = (draw_ctx *)AllocMem(sizeof(draw_ctx)))) {
+    if ((D = AllocDrawCtx())) {
       D->TopW = W;
       D->W = OnlyW;
       D->Screen = Screen;
@@ -1170,6 +1814,156 @@ byte ContainsCursor(widget W) {
   return tfalse;
 }
 
+/*
+ * visible region of top-level widgets, i.e. of children of a screen:
+ * the rectangles of the widget not covered by widgets above it, each one
+ * shaded or not by their shadows. DrawAreaCtx() finds them again at each call,
+ * splitting the area around every widget above, so partial redraws
+ * (most notably terminal output) reuse the region it found last time,
+ * until VisibleSerial changes or the widget or its screen move.
+ */
+#define VISREGION_HASH 64 /* number of cached regions, a power of 2 */
+#define VISREGION_SLOT(W) (((((uldat)(size_t)(W) >> 4) * 0x9E3779B1u) >> 16) & (VISREGION_HASH - 1))
+
+typedef struct s_visrect {
+  dat X1, Y1, X2, Y2;
+  byte Shaded;
+} visrect;
+
+typedef struct s_visregion {
+  widget W;
+  uldat Serial;            /* VisibleSerial when recorded */
+  ldat Left, Up, Rgt, Dwn; /* W corners position on display */
+  dat DWidth, DHeight, YLimit;
+  uldat Shadows; /* shadow setup */
+  uldat NRect, MaxRect;
+  visrect *Rect;
+} visregion;
+
+static visregion VisRegion[VISREGION_HASH];
+/* region DrawAreaCtx() records instead of drawing, if any */
+static visregion *VisRecord;
+static byte VisRecordError;
+
+static void AddVisRect(visregion *R, dat X1, dat Y1, dat X2, dat Y2, byte Shaded) {
+  visrect *Rect;
+  uldat Max;
+
+  if (R->NRect == R->MaxRect) {
+    Max = R->MaxRect * 2 + 8;
+    if (!(Rect = (visrect *)ReAllocMem(R->Rect, Max * sizeof(visrect)))) {
+      VisRecordError = ttrue;
+      return;
+    }
+    R->Rect = Rect;
+    R->MaxRect = Max;
+  }
+  Rect = R->Rect + R->NRect++;
+  Rect->X1 = X1;
+  Rect->Y1 = Y1;
+  Rect->X2 = X2;
+  Rect->Y2 = Y2;
+  Rect->Shaded = Shaded;
+}
+
+/* return the visible region of W, a child of a screen, or NULL if out of memory */
+static visregion *GetVisRegion(widget W) {
+  screen Screen = (screen)W->Parent;
+  setup *SetUp = All->SetUp;
+  visregion *R = VisRegion + VISREGION_SLOT(W);
+  ldat Left, Up, Rgt, Dwn;
+  uldat Shadows;
+  draw_ctx D;
+
+  /* same as DrawAreaCtx() */
+  Left = (ldat)W->Left + (ldat)Screen->dummyLeft - Screen->XLogic;
+  Up = (ldat)W->Up + (ldat)Screen->YLimit - Screen->YLogic;
+  Rgt = Left + (ldat)W->XWidth - 1;
+  Dwn = Up + (IS_WINDOW(W) && (((window)W)->Attrib & WINDOW_ROLLED_UP) ? 0 : (ldat)W->YWidth - 1);
+  Shadows = SetUp->Flags & SETUP_SHADOWS
+                ? (uldat)1 | (uldat)SetUp->DeltaXShade << 8 | (uldat)SetUp->DeltaYShade << 16
+                : 0;
+
+  if (R->W == W && R->Serial == VisibleSerial && R->Left == Left && R->Up == Up &&
+      R->Rgt == Rgt && R->Dwn == Dwn && R->DWidth == All->DisplayWidth &&
+      R->DHeight == All->DisplayHeight && R->YLimit == Screen->YLimit && R->Shadows == Shadows)
+    return R;
+
+  R->W = W;
+  R->Serial = 0;
+  R->Left = Left;
+  R->Up = Up;
+  R->Rgt = Rgt;
+  R->Dwn = Dwn;
+  R->DWidth = All->DisplayWidth;
+  R->DHeight = All->DisplayHeight;
+  R->YLimit = Screen->YLimit;
+  R->Shadows = Shadows;
+  R->NRect = 0;
+
+  /* record what DrawAreaCtx() draws of W */
+  D.Next = (draw_ctx *)0;
+  D.TopW = NULL;
+  D.W = W;
+  D.Screen = Screen;
+  D.DWidth = All->DisplayWidth;
+  D.DHeight = All->DisplayHeight;
+  D.X1 = Max2(Left, 0);
+  D.Y1 = Max2(Up, 0);
+  D.X2 = Min2(Rgt, D.DWidth - 1);
+  D.Y2 = Min2(Dwn, D.DHeight - 1);
+  D.Shaded = tfalse;
+
+  VisRecord = R;
+  VisRecordError = tfalse;
+  DrawAreaCtx(&D);
+  VisRecord = NULL;
+
+  if (VisRecordError)
+    return NULL;
+  R->Serial = VisibleSerial;
+  return R;
+}
+
+/*
+ * draw the visible part of D->X1...D->Y2 of OnlyW, using the visible region
+ * of its top-level parent. D was initialized by InitDrawCtx()
+ */
+static void DrawVisibleCtx(draw_ctx *D, widget OnlyW) {
+  widget W = NonScreenParent(OnlyW);
+  visregion *R;
+  visrect *Rect;
+  draw_ctx *FD;
+  ldat X1, Y1, X2, Y2;
+  uldat n;
+  byte lError = tfalse;
+
+  if (!W->Parent || !IS_SCREEN(W->Parent) || !(R = GetVisRegion(W))) {
+    D->TopW = NULL;
+    D->W = OnlyW;
+    DrawAreaCtx(D);
+    return;
+  }
+
+  for (n = R->NRect, Rect = R->Rect; n; n--, Rect++) {
+    X1 = Max2(D->X1, (ldat)Rect->X1);
+    Y1 = Max2(D->Y1, (ldat)Rect->Y1);
+    X2 = Min2(D->X2, (ldat)Rect->X2);
+    Y2 = Min2(D->Y2, (ldat)Rect->Y2);
+    if (X1 <= X2 && Y1 <= Y2) {
+      FD = NULL;
+      _DrawWCtx_(&FD, W, NULL, OnlyW, R->Left, R->Up, R->Rgt, R->Dwn, (dat)X1, (dat)Y1, (dat)X2,
+                 (dat)Y2, tfalse, tfalse, Rect->Shaded, &lError);
+      if (FD) {
+        DrawWCtx(FD);
+        FreeDrawCtx(FD);
+      }
+    }
+  }
+  if (lError)
+    Error(lError);
+}
+
 static void DrawAreaCtx(draw_ctx *D) {
   draw_ctx *FirstD = D;
   ldat DWidth, DHeight, YLimit;
@@ -1207,7 +2001,7 @@ static void DrawAreaCtx(draw_ctx *D) {
     FirstD = D->Next;
 
     if (!FirstCycle)
-      FreeMem(D);
+      FreeDrawCtx(D);
     else
       FirstCycle = tfalse;
 
@@ -1261,7 +2055,9 @@ static void DrawAreaCtx(draw_ctx *D) {
     if (!W) {
       W = FirstScreen->FirstW;
       if (Y1 == YLimit && !OnlyW) {
+        LockDraw();
         Act(DrawMenu, FirstScreen)(FirstScreen, X1, X2);
+        UnlockDraw();
         if (++Y1 > Y2)
           continue;
       }
@@ -1319,13 +2115,16 @@ static void DrawAreaCtx(draw_ctx *D) {
 
     TopOnlyW = OnlyW ? NonScreenParent(OnlyW) : NULL;
 
-    if (WidgetFound == ttrue && (!OnlyW || TopOnlyW == W)) {
+    if (WidgetFound == ttrue && (!OnlyW || TopOnlyW == W) && VisRecord)
+      AddVisRect(VisRecord, Max2(X1, shLeft), Max2(Y1, shUp), Min2(X2, shRgt), Min2(Y2, shDwn),
+                 Shaded);
+    else if (WidgetFound == ttrue && (!OnlyW || TopOnlyW == W)) {
       draw_ctx *FD = NULL;
       _DrawWCtx_(&FD, W, NULL, OnlyW, shLeft, shUp, shRgt, shDwn, Max2(X1, shLeft), Max2(Y1, shUp),
                  Min2(X2, shRgt), Min2(Y2, shDwn), tfalse, tfalse, Shaded, &lError);
       if (FD) {
         DrawWCtx(FD);
-        FreeMem(FD);
+        FreeDrawCtx(FD);
       }
     }
 
@@ -1486,14 +2285,145 @@ static void DrawAreaCtx(draw_ctx *D) {
     }
   } while ((D = FirstD));
 
-  if (lError)
+  if (lError) {
+    LockDraw();
     Error(lError);
+    UnlockDraw();
+  }
+}
+
+#ifdef HAVE_THREAD_LOCAL
+/*
+ * a large area with no widget to start from, as the full-screen redraws of FlushAllHW(),
+ * is split in horizontal bands: each one is a DrawAreaCtx() of its own, writing only
+ * its own rows of Video[] and ChangedVideo[], so DrawThreads threads draw them
+ * in parallel, the calling one included. the others wait for the next area.
+ */
+#define DRAWBAND_CELLS 4096 /* fewer cells per band are not worth waking a thread */
+
+typedef struct s_draw_band {
+  draw_ctx D;
+  drawctx_stats Stats; /* of the draw_ctx pool of the thread drawing the band */
+  byte ChangedVideoFlag;
+} draw_band;
+
+static draw_band DrawBand[DRAWTHREADS_MAX];
+static udat BandThreads; /* threads started, not counting the main one */
+
+static pthread_mutex_t BandMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t BandStart = PTHREAD_COND_INITIALIZER, BandDone = PTHREAD_COND_INITIALIZER;
+/* protected by BandMutex */
+static tcell *BandVideo;
+static dirty_row *BandChangedVideo;
+static uldat BandSerial; /* incremented for each area */
+static udat BandN, BandPending;
+
+static void *DrawBandThread(void *arg) {
+  draw_band *B = (draw_band *)arg;
+  uldat Serial = 0;
+
+  CtxStats = &B->Stats;
+
+  pthread_mutex_lock(&BandMutex);
+  for (;;) {
+    while (Serial == BandSerial)
+      pthread_cond_wait(&BandStart, &BandMutex);
+    Serial = BandSerial;
+    if (B - DrawBand >= BandN)
+      continue;
+    Video = BandVideo;
+    ChangedVideo = BandChangedVideo;
+    pthread_mutex_unlock(&BandMutex);
+
+    ChangedVideoFlag = tfalse;
+    DrawAreaCtx(&B->D);
+    B->ChangedVideoFlag = ChangedVideoFlag;
+
+    pthread_mutex_lock(&BandMutex);
+    if (!--BandPending)
+      pthread_cond_signal(&BandDone);
+  }
+  return NULL;
 }
 
+/* start the threads drawing bands, if needed. return how many threads can draw them */
+static udat StartDrawBands(void) {
+  pthread_t Thread;
+  sigset_t mask, old;
+  long n = DrawThreads;
+
+  if (!n && (n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    n = 1;
+  n = Min2(n, DRAWTHREADS_MAX);
+
+  if (BandThreads + 1 < n) {
+    /* signals must be delivered to the main thread */
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, &old);
+    while (BandThreads + 1 < n &&
+           pthread_create(&Thread, NULL, DrawBandThread, &DrawBand[BandThreads + 1]) == 0) {
+      pthread_detach(Thread);
+      BandThreads++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+  }
+  return BandThreads + 1;
+}
+
+/* draw the area of D in parallel bands. return tfalse if it is too small to be worth it */
+static byte DrawBandsCtx(draw_ctx *D) {
+  draw_band *B;
+  ldat Height = (ldat)D->Y2 - D->Y1 + 1, Cells = Height * ((ldat)D->X2 - D->X1 + 1);
+  udat i, n;
+
+  if (DrawThreads == 1 || Cells < 2 * DRAWBAND_CELLS || (n = StartDrawBands()) < 2)
+    return tfalse;
+  n = Min2(n, Cells / DRAWBAND_CELLS);
+  n = Min2(n, Height);
+
+  for (i = 0; i < n; i++) {
+    B = &DrawBand[i];
+    B->D = *D;
+    B->D.Y1 = D->Y1 + (dat)(Height * i / n);
+    B->D.Y2 = D->Y1 + (dat)(Height * (i + 1) / n) - 1;
+  }
+
+  pthread_mutex_lock(&BandMutex);
+  BandVideo = Video;
+  BandChangedVideo = ChangedVideo;
+  BandN = n;
+  BandPending = n - 1;
+  BandSerial++;
+  DrawBands = ttrue;
+  pthread_cond_broadcast(&BandStart);
+  pthread_mutex_unlock(&BandMutex);
+
+  DrawAreaCtx(&DrawBand[0].D);
+
+  pthread_mutex_lock(&BandMutex);
+  while (BandPending)
+    pthread_cond_wait(&BandDone, &BandMutex);
+  DrawBands = tfalse;
+  pthread_mutex_unlock(&BandMutex);
+
+  for (i = 1; i < n; i++) {
+    B = &DrawBand[i];
+    ChangedVideoFlag |= B->ChangedVideoFlag;
+    DrawCtxStats.Allocs += B->Stats.Allocs;
+    DrawCtxStats.Chunks += B->Stats.Chunks;
+    DrawCtxStats.Peak = Max2(DrawCtxStats.Peak, B->Stats.Peak);
+    B->Stats.Allocs = B->Stats.Chunks = 0;
+  }
+  return ttrue;
+}
+#endif /* HAVE_THREAD_LOCAL */
+
 void DrawArea2(screen FirstScreen, widget W, widget OnlyW, dat X1, dat Y1, dat X2, dat Y2,
                byte Shaded) {
   draw_ctx D;
 
+  if (!OnlyW)
+    InvalidateVisibleRegions();
   if (QueuedDrawArea2FullScreen)
     return;
 
@@ -1512,6 +2442,10 @@ void DrawArea2(screen FirstScreen, widget W, widget OnlyW, dat X1, dat Y1, dat X
     D.Screen = FirstScreen;
     D.Shaded = Shaded;
 
+#ifdef HAVE_THREAD_LOCAL
+    if (!FirstScreen && !W && !OnlyW && DrawBandsCtx(&D))
+      return;
+#endif
     DrawAreaCtx(&D);
   }
 }
@@ -1525,6 +2459,8 @@ void DrawBorderWindow(window Window, byte Flags) {
   widget Parent;
   screen Screen, FirstScreen;
 
+  if (Window && Window->Store)
+    DamageStoreBorder(Window->Store, Flags);
   if (QueuedDrawArea2FullScreen || !Window ||
       (Window->Flags & (WINDOWFL_BORDERLESS | WINDOWFL_NOTVISIBLE)) || !(Parent = Window->Parent) ||
       !IS_SCREEN(Parent))
@@ -1652,6 +2588,9 @@ void DrawShadeWindow(window Window, dat X1, dat Y1, dat X2, dat Y2, byte Interna
 void DrawAreaWindow2(window W) {
   draw_ctx D;
   byte Dvalid = tfalse;
+
+  /* W was mapped, raised, lowered or unrolled */
+  InvalidateVisibleRegions();
   if (!QueuedDrawArea2FullScreen && W && W->Parent && IS_SCREEN(W->Parent)) {
     if ((widget)W == All->FirstScreen->FirstW) {
       DrawWidget((widget)W, 0, 0, TW_MAXDAT, TW_MAXDAT, tfalse);
@@ -1673,16 +2612,17 @@ void DrawAreaWindow2(window W) {
 /* replaces DrawAbsoluteWindow() */
 void DrawPartialWidget(widget W, dat X1, dat Y1, dat X2, dat Y2) {
   draw_ctx D;
+
+  if (W)
+    DamageBackStore(W, X1, Y1, X2, Y2);
   if (!QueuedDrawArea2FullScreen && W && InitDrawCtx(W, X1, Y1, X2, Y2, tfalse, &D)) {
     /*
      * DO NOT assume W is completely visible...
      * might be obscured by another window! So reset D.TopW
      * Assume instead that who called us wants to draw the visible part of W,
-     * not whatever covers it. So set D.W (used as OnlyW)
+     * not whatever covers it. So draw only the visible region of W
      */
-    D.TopW = NULL;
-    D.W = W;
-    DrawAreaCtx(&D);
+    DrawVisibleCtx(&D, W);
   }
 }
 
@@ -1718,6 +2658,116 @@ void DrawLogicWidget(widget W, ldat X1, ldat Y1, ldat X2, ldat Y2) {
   }
 }
 
+/*
+ * batched DrawLogicWidget() of NRows rows starting at logical row Y:
+ * row Y + i is damaged from logical column X1[i] to X2[i], or not at all if X1[i] > X2[i].
+ * consecutive damaged rows are merged into a rectangle as long as that redraws
+ * at most one row worth of undamaged cells, and W position is computed only once.
+ */
+void DrawLogicWidgetRows(widget W, ldat Y, dat NRows, CONST dat *X1, CONST dat *X2) {
+  draw_ctx D0, D;
+  ldat XL, YL, x1, x2, width, cells;
+  dat i, j;
+  byte HasBorder;
+
+  if (QueuedDrawArea2FullScreen || !W || NRows <= 0 || (W->Flags & WIDGETFL_NOTVISIBLE) ||
+      (IS_WINDOW(W) && (((window)W)->Attrib & WINDOW_ROLLED_UP)))
+    return;
+
+  for (i = 0; i < NRows; i++) {
+    if (X1[i] <= X2[i])
+      DamageLogicBackStore(W, X1[i], Y + i, X2[i], Y + i);
+  }
+  if (!InitDrawCtx(W, 0, 0, TW_MAXDAT, TW_MAXDAT, tfalse, &D0))
+    return;
+
+  HasBorder = IS_WINDOW(W) && !(((window)W)->Flags & WINDOWFL_BORDERLESS);
+
+  /* display coords of logical (0, 0) */
+  XL = D0.Left + HasBorder - W->XLogic;
+  YL = D0.Up + HasBorder - W->YLogic;
+
+  /* only draw inside the border */
+  D0.X1 = Max2(D0.X1, D0.Left + HasBorder);
+  D0.X2 = Min2(D0.X2, D0.Rgt - HasBorder);
+  D0.Y1 = Max2(D0.Y1, D0.Up + HasBorder);
+  D0.Y2 = Min2(D0.Y2, D0.Dwn - HasBorder);
+
+  for (i = 0; i < NRows; i = j) {
+    if (X1[i] > X2[i]) {
+      j = i + 1;
+      continue;
+    }
+    x1 = X1[i];
+    x2 = X2[i];
+    cells = x2 - x1 + 1;
+    for (j = i + 1; j < NRows && X1[j] <= X2[j]; j++) {
+      width = Max2(x2, X2[j]) - Min2(x1, X1[j]) + 1;
+      cells += X2[j] - X1[j] + 1;
+      if (width * (j - i + 1) - cells > width)
+        break;
+      x1 = Min2(x1, X1[j]);
+      x2 = Max2(x2, X2[j]);
+    }
+
+    D = D0;
+    D.X1 = Max2(D0.X1, XL + x1);
+    D.X2 = Min2(D0.X2, XL + x2);
+    D.Y1 = Max2(D0.Y1, YL + Y + i);
+    D.Y2 = Min2(D0.Y2, YL + Y + j - 1);
+    if (D.X1 <= D.X2 && D.Y1 <= D.Y2) {
+      /* same as DrawPartialWidget() */
+      DrawVisibleCtx(&D, W);
+    }
+  }
+}
+
+byte TtyDeferDraw;
+window TtyDirty;
+
+/* draw the damage recorded in W->USE.C.TtyData by the terminal emulator, and forget it */
+void DrawTtyDamage(window W) {
+  ttydata *Data = W->USE.C.TtyData;
+  dat y1 = Data->DirtyY1, y2 = Data->DirtyY2;
+
+  if (y1 > y2)
+    return;
+  Data->DirtyY1 = 0;
+  Data->DirtyY2 = -1;
+
+  if (Data->DirtyMax >= Data->SizeY)
+    DrawLogicWidgetRows((widget)W, y1 + Data->ScrollBack, y2 - y1 + 1, Data->DirtyX1 + y1,
+                        Data->DirtyX2 + y1);
+  else
+    /* no per-row damage */
+    DrawLogicWidget((widget)W, 0, y1 + Data->ScrollBack, Data->SizeX - 1,
+                    y2 + Data->ScrollBack);
+}
+
+void DrawTtyDirty(void) {
+  window W;
+  ttydata *Data;
+
+  while ((W = TtyDirty)) {
+    Data = W->USE.C.TtyData;
+    TtyDirty = Data->DirtyNext;
+    Data->DirtyNext = NULL;
+    Data->DirtyQueued = tfalse;
+    DrawTtyDamage(W);
+  }
+}
+
+/* called when deleting W */
+void ForgetTtyDirty(window W) {
+  window *pW;
+
+  if (W->USE.C.TtyData->DirtyQueued) {
+    for (pW = &TtyDirty; *pW != W; pW = &(*pW)->USE.C.TtyData->DirtyNext)
+      ;
+    *pW = W->USE.C.TtyData->DirtyNext;
+  }
+}
+
 void ReDrawRolledUpAreaWindow(window Window, byte Shaded) {
   ldat shLeft, shUp, shRgt, shDwn;
   byte Shade, DeltaXShade, DeltaYShade;
@@ -1725,6 +2775,7 @@ void ReDrawRolledUpAreaWindow(window Window, byte Shaded) {
   dat DWidth, DHeight;
   dat YLimit;
 
+  InvalidateVisibleRegions();
   if (QueuedDrawArea2FullScreen || !Window || (Window->Flags & WINDOWFL_NOTVISIBLE) ||
       !Window->Parent || !IS_SCREEN(Window->Parent))
     return;
@@ -28,11 +28,29 @@ void DrawArea2(screen FirstScreen, widget Top, widget OnlyW, dat X1, dat Y1, dat
                byte Shaded);
 #define FULL_SCREEN (screen)0, (widget)0, (widget)0, (dat)0, (dat)0, TW_MAXDAT, TW_MAXDAT, tfalse
 
+/*
+ * how many threads DrawArea2() uses to draw large areas with no Top or OnlyW widget,
+ * split in horizontal bands: 0 = one per CPU, 1 = draw serially. at most DRAWTHREADS_MAX.
+ */
+#define DRAWTHREADS_MAX 8
+extern udat DrawThreads;
+
 /* DrawWidget() assumes W is not obscured */
 void DrawWidget(widget W, dat Xstart, dat Ystart, dat Xend, dat Yend, byte Shaded);
 #define DrawFirstWidget(W) DrawWidget((W), 0, 0, TW_MAXDAT, TW_MAXDAT, tfalse)
 void DrawAreaWidget(widget W);
 
+/* usage of the pool of draw_ctx queued by DrawArea2() and friends */
+typedef struct s_drawctx_stats {
+  uldat Allocs;     /* draw_ctx taken from the pool in this frame */
+  uldat LastAllocs; /* same, in the previous frame */
+  uldat Used, Peak; /* draw_ctx in use now, and at most */
+  uldat Chunks;     /* chunks of draw_ctx allocated for the pool */
+} drawctx_stats;
+
+extern drawctx_stats DrawCtxStats;
+void FrameDrawCtxStats(void);
+
 /* like DrawAreaWindow2, but does not draw the shadow: */
 #define DrawFullWindow2(W) DrawAreaWidget((widget)W)
 
@@ -50,9 +68,53 @@ void DrawAreaShadeWindow(screen Screen, window Window, dat Xstart, dat Ystart, d
                          ldat shLeft, ldat shUp, ldat shRgt, ldat shDwn, byte Internal);
 /* this also draws the shadow: */
 void DrawAreaWindow2(window Window);
+/*
+ * redraw W after raising or lowering it among the children of its screen:
+ * same as DrawAreaWindow2() or DrawAreaWidget(), but keeps the grid of FindWidgetAt()
+ */
+void DrawRestackedWidget(widget W);
 
 void DrawPartialWidget(widget W, dat X1, dat Y1, dat X2, dat Y2);
 void DrawLogicWidget(widget W, ldat X1, ldat Y1, ldat X2, ldat Y2);
+void DrawLogicWidgetRows(widget W, ldat Y, dat NRows, CONST dat *X1, CONST dat *X2);
+
+/*
+ * DrawPartialWidget() and friends reuse the visible region of top-level widgets
+ * computed by previous calls, and FindWidgetAt() a grid of the children of screens.
+ * whoever changes which parts of them are visible, i.e. maps, unmaps, restacks,
+ * moves or resizes top-level widgets or screens, must call InvalidateVisibleRegions():
+ * DrawArea2(), DrawAreaWidget() and DrawAreaWindow2() do it.
+ */
+void InvalidateVisibleRegions(void);
+
+/*
+ * top-level windows with WINDOWFL_BACKSTORE keep a copy of their cells as last drawn,
+ * border and children included, and parts of them exposed again are copied from there.
+ * whoever changes what a window looks like must redraw it with DrawPartialWidget()
+ * and friends, which call DamageBackStore(), or call it directly:
+ * moving, raising or lowering windows does not need it.
+ * stores used least recently are dropped to stay within BackStoreMax bytes.
+ */
+#define BACKSTORE_MAX_DEFAULT ((uldat)4096 << 10)
+extern uldat BackStoreMax;
+/* X1..X2, Y1..Y2 are relative to the top-left corner of W, border included */
+void DamageBackStore(widget W, ldat X1, ldat Y1, ldat X2, ldat Y2);
+/* same coordinates: cells X1..X2, Y1..Y2 of W moved by DeltaX, DeltaY as in DragArea() */
+void ScrollBackStore(window W, ldat X1, ldat Y1, ldat X2, ldat Y2, ldat DeltaX, ldat DeltaY);
+void DeleteBackStore(window W);
+void ClearBackStores(void);
+
+/*
+ * while TtyDeferDraw is set, the terminal emulator only updates the contents
+ * of USECONTENTS windows and records their damage, queueing them in TtyDirty.
+ * DrawTtyDirty() draws them, and so does the next write to the same window
+ * with TtyDeferDraw not set.
+ */
+extern byte TtyDeferDraw;
+extern window TtyDirty;
+void DrawTtyDamage(window W);
+void DrawTtyDirty(void);
+void ForgetTtyDirty(window W);
 
 void ReDrawRolledUpAreaWindow(window Window, byte Shaded);
 
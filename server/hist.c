@@ -0,0 +1,321 @@
+/*
+ *  hist.c  --  paged, compressed scrollback of terminal windows
+ *
+ *  Copyright (C) 2000-2020 by Massimiliano Ghilardi
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ */
+
+#include "twin.h"
+#include "alloc.h"
+#include "algo.h"
+#include "hist.h"
+
+/*
+ * compressed pages are a sequence of runs, each starting with a header cell h:
+ *   if (h & 1), the next cell repeated (h >> 1) times;
+ *   otherwise, the (h >> 1) cells that follow.
+ * terminal lines are mostly made of blanks with the same colors,
+ * which this squeezes to a couple of cells per line.
+ */
+
+/* shorter runs of equal cells are stored as they are */
+#define HIST_RUN_MIN 3
+
+ttyhist *HistPending;
+
+/* buffer for compressing pages */
+static tcell *PackBuf;
+static uldat PackSize;
+
+/* compress n cells of s into d, which must have room for n + 1 cells. return cells written */
+static uldat Pack(CONST tcell *s, uldat n, tcell *d) {
+  CONST tcell *end = s + n, *lit = s;
+  tcell *d0 = d;
+  uldat run;
+
+  while (s < end) {
+    for (run = 1; s + run < end && s[run] == s[0]; run++)
+      ;
+    if (run < HIST_RUN_MIN) {
+      s += run;
+      continue;
+    }
+    if (s > lit) {
+      *d++ = (tcell)(s - lit) << 1;
+      CopyMem(lit, d, (s - lit) * sizeof(tcell));
+      d += s - lit;
+    }
+    *d++ = (tcell)run << 1 | 1;
+    *d++ = *s;
+    lit = s += run;
+  }
+  if (s > lit) {
+    *d++ = (tcell)(s - lit) << 1;
+    CopyMem(lit, d, (s - lit) * sizeof(tcell));
+    d += s - lit;
+  }
+  return d - d0;
+}
+
+static void Unpack(CONST tcell *s, uldat len, tcell *d) {
+  CONST tcell *end = s + len;
+  uldat n;
+  tcell c;
+
+  while (s < end) {
+    n = *s >> 1;
+    if (*s++ & 1) {
+      c = *s++;
+      while (n--)
+        *d++ = c;
+    } else {
+      CopyMem(s, d, n * sizeof(tcell));
+      s += n;
+      d += n;
+    }
+  }
+}
+
+static void PackPage(histpage *P) {
+  uldat n = (uldat)P->Width * HIST_PAGE, len;
+  tcell *data;
+
+  P->State = HIST_DONE;
+
+  if (PackSize < n + 1) {
+    if (!(data = (tcell *)ReAllocMem(PackBuf, (n + 1) * sizeof(tcell))))
+      return;
+    PackBuf = data;
+    PackSize = n + 1;
+  }
+  len = Pack(P->Data, n, PackBuf);
+
+  /* not worth it? keep the page as it is */
+  if (len > n - n / 4 || !(data = (tcell *)AllocMem(len * sizeof(tcell))))
+    return;
+  CopyMem(PackBuf, data, len * sizeof(tcell));
+  FreeMem(P->Data);
+  P->Data = data;
+  P->Len = len;
+}
+
+/* compress the full pages of all scrollbacks. called from the main loop */
+void CompressHist(void) {
+  ttyhist *H;
+  ldat p;
+
+  while ((H = HistPending)) {
+    HistPending = H->Pending;
+    H->Pending = NULL;
+    H->IsPending = tfalse;
+    for (p = 0; p < H->NPage; p++)
+      if (H->Page[p].State == HIST_FULL)
+        PackPage(H->Page + p);
+  }
+}
+
+static void FreePage(ttyhist *H, ldat p) {
+  histpage *P = H->Page + p;
+
+  if (P->Data)
+    FreeMem(P->Data);
+  P->Data = NULL;
+  P->Len = 0;
+  P->State = HIST_EMPTY;
+  if (H->CachePage == p)
+    H->CachePage = -1;
+}
+
+ttyhist *CreateHist(ldat Max, dat Width) {
+  ttyhist *H;
+
+  if (Max <= 0 || !(H = (ttyhist *)AllocMem0(sizeof(ttyhist), 1)))
+    return NULL;
+
+  /* one page more than needed, for the partially overwritten oldest page */
+  H->NPage = (Max + HIST_PAGE - 1) / HIST_PAGE + 1;
+  H->Max = Max;
+  H->Width = Width = Max2(Width, 1);
+  H->CachePage = -1;
+
+  if ((H->Page = (histpage *)AllocMem0(sizeof(histpage), H->NPage)) &&
+      (H->Line = (tcell *)AllocMem(Width * sizeof(tcell))))
+    return H;
+
+  DeleteHist(H);
+  return NULL;
+}
+
+void DeleteHist(ttyhist *H) {
+  ttyhist **pH;
+  ldat p;
+
+  if (H->IsPending) {
+    for (pH = &HistPending; *pH != H; pH = &(*pH)->Pending)
+      ;
+    *pH = H->Pending;
+  }
+  if (H->Page) {
+    for (p = 0; p < H->NPage; p++)
+      FreePage(H, p);
+    FreeMem(H->Page);
+  }
+  if (H->Cache)
+    FreeMem(H->Cache);
+  if (H->Line)
+    FreeMem(H->Line);
+  FreeMem(H);
+}
+
+/* append a line of H->Width cells, dropping the oldest one if already at H->Max lines */
+void PushHist(ttyhist *H, CONST tcell *Line) {
+  ldat L = (H->First + H->Count) % (H->NPage * HIST_PAGE), p = L / HIST_PAGE;
+  histpage *P = H->Page + p, *Prev;
+
+  if (L % HIST_PAGE == 0) {
+    /* start a new page */
+    FreePage(H, p);
+    if (!(P->Data = (tcell *)AllocMem((uldat)H->Width * HIST_PAGE * sizeof(tcell))))
+      return;
+    P->Width = H->Width;
+    P->State = HIST_RAW;
+
+    /* the previous page is full now: compress it later */
+    Prev = H->Page + (p ? p : H->NPage) - 1;
+    if (Prev->State == HIST_RAW) {
+      Prev->State = HIST_FULL;
+      if (!H->IsPending) {
+        H->IsPending = ttrue;
+        H->Pending = HistPending;
+        HistPending = H;
+      }
+    }
+  }
+  CopyMem(Line, P->Data + (L % HIST_PAGE) * P->Width, P->Width * sizeof(tcell));
+
+  if (H->Count < H->Max)
+    H->Count++;
+  else {
+    if (++H->First == H->NPage * HIST_PAGE)
+      H->First = 0;
+    if (H->First % HIST_PAGE == 0)
+      /* no more lines in the page of the dropped line */
+      FreePage(H, (H->First ? H->First / HIST_PAGE : H->NPage) - 1);
+  }
+}
+
+/*
+ * change the width of new lines. lines already in compressed pages
+ * are converted when read, the ones in the page being appended to are converted now.
+ */
+byte ResizeHist(ttyhist *H, dat Width, tcell Fill) {
+  ldat L, n, i;
+  histpage *P;
+  tcell *data, *line;
+  dat common;
+
+  Width = Max2(Width, 1);
+  if (Width == H->Width)
+    return ttrue;
+
+  if (!(line = (tcell *)ReAllocMem(H->Line, Width * sizeof(tcell))))
+    return tfalse;
+  H->Line = line;
+
+  L = (H->First + H->Count) % (H->NPage * HIST_PAGE);
+  P = H->Page + L / HIST_PAGE;
+  if ((n = L % HIST_PAGE) && P->State == HIST_RAW) {
+    if (!(data = (tcell *)AllocMem((uldat)Width * HIST_PAGE * sizeof(tcell))))
+      return tfalse;
+    common = Min2(Width, P->Width);
+    for (line = data; n; n--) {
+      CopyMem(P->Data + (L % HIST_PAGE - n) * P->Width, line, common * sizeof(tcell));
+      for (i = common; i < Width; i++)
+        line[i] = Fill;
+      line += Width;
+    }
+    FreeMem(P->Data);
+    P->Data = data;
+    P->Width = Width;
+  }
+  H->Width = Width;
+  return ttrue;
+}
+
+/*
+ * return line i of H, from 0 for the oldest to H->Count - 1,
+ * converted to H->Width cells: lines narrower than that are padded with Fill,
+ * and lines before the oldest are blank.
+ * the result is only valid until the next call.
+ */
+CONST tcell *HistLine(ttyhist *H, ldat i, tcell Fill) {
+  ldat L, p;
+  histpage *P;
+  CONST tcell *src;
+  tcell *cache;
+  uldat size;
+  dat common, x;
+
+  if (i < 0)
+    /* not written yet */
+    goto blank;
+
+  L = (H->First + i) % (H->NPage * HIST_PAGE);
+  P = H->Page + (p = L / HIST_PAGE);
+
+  if (P->Len) {
+    if (H->CachePage != p) {
+      size = (uldat)P->Width * HIST_PAGE;
+      if (H->CacheSize < size) {
+        if (!(cache = (tcell *)ReAllocMem(H->Cache, size * sizeof(tcell))))
+          goto blank;
+        H->Cache = cache;
+        H->CacheSize = size;
+      }
+      Unpack(P->Data, P->Len, H->Cache);
+      H->CachePage = p;
+    }
+    src = H->Cache + (L % HIST_PAGE) * P->Width;
+  } else if (P->Data)
+    src = P->Data + (L % HIST_PAGE) * P->Width;
+  else
+    goto blank;
+
+  if (P->Width == H->Width)
+    return src;
+
+  common = Min2(P->Width, H->Width);
+  CopyMem(src, H->Line, common * sizeof(tcell));
+  for (x = common; x < H->Width; x++)
+    H->Line[x] = Fill;
+  return H->Line;
+
+blank:
+  for (x = 0; x < H->Width; x++)
+    H->Line[x] = Fill;
+  return H->Line;
+}
+
+/*
+ * return the WLogic cells of line y of a USECONTENTS window, 0 <= y < HLogic.
+ * the result is only valid until the next call.
+ */
+CONST tcell *ContentsLine(window W, ldat y) {
+  ttydata *Data = W->USE.C.TtyData;
+  ttyhist *H = W->USE.C.Hist;
+  CONST tcell *p;
+
+  if ((y -= Data->ScrollBack) >= 0) {
+    p = Data->Start + y * W->WLogic;
+    if (p >= Data->Split)
+      p -= Data->Split - W->USE.C.Contents;
+    return p;
+  }
+  /* the scrollback is filled from the bottom */
+  return HistLine(H, H->Count + y, TCELL(W->ColText, ' '));
+}
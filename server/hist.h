@@ -0,0 +1,65 @@
+/* Copyright (C) 2000-2020 by Massimiliano Ghilardi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ */
+#ifndef _TWIN_HIST_H
+#define _TWIN_HIST_H
+
+/*
+ * scrollback of USECONTENTS windows.
+ *
+ * Window->USE.C.Contents only holds the lines visible in the terminal:
+ * lines scrolled off its top are appended to Window->USE.C.Hist,
+ * which keeps them in pages of HIST_PAGE lines. full pages are compressed
+ * from the main loop, and decompressed one at time when read.
+ */
+
+/* lines in each page */
+#define HIST_PAGE 64
+
+/* histpage.State */
+#define HIST_EMPTY 0 /* no lines */
+#define HIST_RAW 1   /* lines are still being appended */
+#define HIST_FULL 2  /* all lines appended, to be compressed */
+#define HIST_DONE 3  /* compressed, or not worth compressing */
+
+typedef struct s_histpage histpage;
+
+struct s_histpage {
+  tcell *Data; /* Width * HIST_PAGE cells, or Len cells of compressed runs */
+  uldat Len;   /* 0 if Data is not compressed */
+  dat Width;   /* width of lines in this page */
+  byte State;
+};
+
+struct s_ttyhist {
+  histpage *Page; /* ring of NPage pages */
+  ldat NPage;
+  ldat Max;         /* max number of lines */
+  ldat First;       /* oldest line, as index in the ring of NPage * HIST_PAGE lines */
+  ldat Count;       /* number of lines */
+  dat Width;        /* width of new lines */
+  ldat CachePage;   /* page decompressed in Cache, or -1 */
+  tcell *Cache;     /* decompressed lines */
+  uldat CacheSize;  /* size of Cache, in tcells */
+  tcell *Line;      /* a line converted to Width */
+  ttyhist *Pending; /* next scrollback with HIST_FULL pages */
+  byte IsPending;
+};
+
+extern ttyhist *HistPending;
+
+ttyhist *CreateHist(ldat Max, dat Width);
+void DeleteHist(ttyhist *H);
+void PushHist(ttyhist *H, CONST tcell *Line);
+byte ResizeHist(ttyhist *H, dat Width, tcell Fill);
+CONST tcell *HistLine(ttyhist *H, ldat i, tcell Fill);
+void CompressHist(void);
+
+CONST tcell *ContentsLine(window W, ldat y);
+
+#endif /* _TWIN_HIST_H */
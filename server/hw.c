@@ -59,21 +59,32 @@
 #endif
 #endif
 
-display_hw HW, DisplayHWCTTY;
+/*
+ * the THREAD_LOCAL ones are set by hw_multi.c
+ * when a display flushes on its own worker thread
+ */
+THREAD_LOCAL display_hw HW;
+display_hw DisplayHWCTTY;
 
-tcell *Video, *OldVideo;
+THREAD_LOCAL tcell *Video, *OldVideo;
 
 byte NeedOldVideo, CanDragArea;
-byte ExpensiveFlushVideo, ValidOldVideo, NeedHW;
+byte ExpensiveFlushVideo, NeedHW;
+THREAD_LOCAL byte ValidOldVideo;
 
-dat (*ChangedVideo)[2][2];
-byte ChangedVideoFlag, ChangedVideoFlagAgain;
+THREAD_LOCAL dirty_row *ChangedVideo;
+THREAD_LOCAL byte ChangedVideoFlag;
 byte QueuedDrawArea2FullScreen;
+/*
+ * what DirtyVideo() tests instead of QueuedDrawArea2FullScreen, which the main thread may change
+ * at any time: worker threads point it to the value that flag had when their frame was published
+ */
+THREAD_LOCAL byte *QueuedFullScreen = &QueuedDrawArea2FullScreen;
 
 dat DisplayWidth, DisplayHeight;
 
-udat CursorX, CursorY;
-uldat CursorType;
+THREAD_LOCAL udat CursorX, CursorY;
+THREAD_LOCAL uldat CursorType;
 
 struct termios ttysave;
 
@@ -269,178 +280,84 @@ void NeedRedrawVideo(dat Left, dat Up, dat Right, dat Down) {
  */
 
 /*
- * for better cleannes, DirtyVideo()
- * should be used *before* actually touching Video[]
+ * add Xstart..Xend to the dirty spans of a single row.
+ * spans that intersect or touch Xstart..Xend are merged with it;
+ * if all slots are used, the two adjacent spans with the smallest
+ * clean gap between them are merged, as that costs the fewest extra cells.
  */
-void DirtyVideo(dat Xstart, dat Ystart, dat Xend, dat Yend) {
-  dat s0, s1, e0, e1, len, min;
-  byte i;
-
-  if (QueuedDrawArea2FullScreen || Xstart > Xend || Xstart >= DisplayWidth || Xend < 0 ||
-      Ystart > Yend || Ystart >= DisplayHeight || Yend < 0)
-    return;
-
-  Xstart = Max2(Xstart, 0);
-  Ystart = Max2(Ystart, 0);
-  Xend = Min2(Xend, DisplayWidth - 1);
-  Yend = Min2(Yend, DisplayHeight - 1);
-
-  ChangedVideoFlag = ChangedVideoFlagAgain = ttrue;
-
-  for (; Ystart <= Yend; Ystart++) {
-    s0 = ChangedVideo[Ystart][0][0];
-    e0 = ChangedVideo[Ystart][0][1];
-    s1 = ChangedVideo[Ystart][1][0];
-    e1 = ChangedVideo[Ystart][1][1];
-
-    /* decide how to rearrange the slots to include Xstart..Xend */
-
-    if (s0 == -1) {
-      /* trivial ! */
-      ChangedVideo[Ystart][0][0] = Xstart;
-      ChangedVideo[Ystart][0][1] = Xend;
-      continue;
-    }
-
-    if ((s0 != -1 && Xstart >= s0 && Xend <= e0) || (s1 != -1 && Xstart >= s1 && Xend <= e1))
+static void DirtyRow(dirty_row *R, dat Xstart, dat Xend) {
+  dat(*S)[2] = R->Span;
+  dat n = R->N, i, j, gap, min;
+
+  /* skip spans that end before Xstart and do not touch it */
+  for (i = 0; i < n && S[i][1] + 1 < Xstart; i++)
+    ;
+  /* find spans that intersect or touch Xstart..Xend */
+  for (j = i; j < n && S[j][0] <= Xend + 1; j++)
+    ;
+
+  if (i < j) {
+    if (S[i][0] <= Xstart && S[i][1] >= Xend)
       /* nothing to do :) */
-      continue;
-
-    if (s1 == -1) {
-      /*
-       * this is quite simple.
-       * if s0..e0 and Xstart..Xend intersect or touch, merge.
-       * else just put them in s0,e0 and s1,e1 :
-       * there is no point in forcing a merge now if it costs cells,
-       * we'll merge (if needed) when a third dirty segment appears.
-       */
-      if (Xstart <= e0 + 1 && Xend + 1 >= s0) {
-        ChangedVideo[Ystart][0][0] = Min2(s0, Xstart);
-        ChangedVideo[Ystart][0][1] = Max2(e0, Xend);
-      } else if (Xstart < s0) {
-        ChangedVideo[Ystart][0][0] = Xstart;
-        ChangedVideo[Ystart][0][1] = Xend;
-        ChangedVideo[Ystart][1][0] = s0;
-        ChangedVideo[Ystart][1][1] = e0;
-      } else {
-        ChangedVideo[Ystart][1][0] = Xstart;
-        ChangedVideo[Ystart][1][1] = Xend;
-      }
-      continue;
+      return;
+    S[i][0] = Min2(S[i][0], Xstart);
+    S[i][1] = Max2(S[j - 1][1], Xend);
+    if (j > i + 1) {
+      MoveMem(S + j, S + i + 1, (n - j) * sizeof(S[0]));
+      R->N = n - (j - i - 1);
     }
+    return;
+  }
 
-    /*
-     * now the hairy thing... there are 5 possible actions:
-     *
-     * 0. put Xstart..Xend in slot 0 and merge s0..e0 with s1..e1
-     * 1. merge Xstart..Xend to s0..e0
-     * 2. merge all together, freeing slot 1
-     * 3. merge Xstart..Xend to s1..e1
-     * 4. put Xstart..Xend in slot 1 and merge s1..e1 with s0..e0
-     *    4. is the same as 0., except for slot inversion.
-     *
-     * do it the brutal way: calculate the 5 cases and choose
-     * the one resulting in less dirty cells.
-     *
-     * we do no checks about the relative ordering of s0..e0, s1..e1, Xstart..Xend
-     * and use Min2(sA, sB)..Max2(eA, eB) for merging.
-     * the less dirty pattern automatically selects the best solution
-     * which is non intersecting, and in the 0.,4. cases we choose manually
-     * to preserve ordering between slots.
-     *
-     * all lenghts are decreased by 2 to avoid always doing (...)+2
-     */
-
-    /*0,4*/ min = Xend - Xstart + e1 - s0;
-    i = 0;
-    /* 1 */ len = Max2(Xend, e0) - Min2(Xstart, s0) + e1 - e0;
-    if (len < min)
-      min = len, i = 1;
-    /* 2 */ len = Max2(Xend, e1) - Min2(Xstart, s0) - 1;
-    if (len <= min)
-      min = len, i = 2; /* prefer this if equal */
-    /* 3 */ len = e0 - s0 + Max2(Xend, e1) - Min2(Xstart, s1);
-    if (len < min)
-      min = len, i = 3;
-
-    switch (i) {
-    case 0:
-      i = Xstart > s0;
-      ChangedVideo[Ystart][!i][0] = s0;
-      ChangedVideo[Ystart][!i][1] = e1;
-      ChangedVideo[Ystart][i][0] = Xstart;
-      ChangedVideo[Ystart][i][1] = Xend;
-      break;
-    case 1:
-      ChangedVideo[Ystart][0][0] = Min2(Xstart, s0);
-      ChangedVideo[Ystart][0][1] = Max2(Xend, e0);
-      break;
-    case 2:
-      ChangedVideo[Ystart][0][0] = Min2(Xstart, s0);
-      ChangedVideo[Ystart][0][1] = Max2(Xend, e1);
-      ChangedVideo[Ystart][1][0] = -1;
-      break;
-    case 3:
-      ChangedVideo[Ystart][1][0] = Min2(Xstart, s1);
-      ChangedVideo[Ystart][1][1] = Max2(Xend, e1);
-      break;
-    default:
-      break;
+  /* disjoint from all other spans: insert it at position i */
+  MoveMem(S + i, S + i + 1, (n - i) * sizeof(S[0]));
+  S[i][0] = Xstart;
+  S[i][1] = Xend;
+
+  if (++n > DIRTY_SPAN_MAX) {
+    /* too many spans: merge the nearest two */
+    min = TW_MAXDAT;
+    for (j = i = 0; j < n - 1; j++) {
+      if ((gap = S[j + 1][0] - S[j][1]) < min)
+        min = gap, i = j;
     }
+    S[i][1] = S[i + 1][1];
+    n--;
+    MoveMem(S + i + 2, S + i + 1, (n - i - 1) * sizeof(S[0]));
   }
+  R->N = n;
 }
 
-static void Video2OldVideo(dat Xstart, dat Ystart, dat Xend, dat Yend) {
-  tcell *src, *dst;
-  uldat xc, yc;
+/*
+ * for better cleannes, DirtyVideo()
+ * should be used *before* actually touching Video[]
+ */
+void DirtyVideo(dat Xstart, dat Ystart, dat Xend, dat Yend) {
 
-  if (Xstart > Xend || Xstart >= DisplayWidth || Xend < 0 || Ystart > Yend ||
-      Ystart >= DisplayHeight || Yend < 0)
+  if (*QueuedFullScreen || Xstart > Xend || Xstart >= DisplayWidth || Xend < 0 ||
+      Ystart > Yend || Ystart >= DisplayHeight || Yend < 0)
     return;
+
   Xstart = Max2(Xstart, 0);
   Ystart = Max2(Ystart, 0);
   Xend = Min2(Xend, DisplayWidth - 1);
   Yend = Min2(Yend, DisplayHeight - 1);
 
-  yc = Yend - Ystart + 1;
-  xc = sizeof(tcell) * (uldat)(Xend - Xstart + 1);
-  src = Video + Xstart + Ystart * (ldat)DisplayWidth;
-  dst = OldVideo + Xstart + Ystart * (ldat)DisplayWidth;
+  ChangedVideoFlag = ttrue;
 
-  while (yc--) {
-    CopyMem(src, dst, xc);
-    src += DisplayWidth;
-    dst += DisplayWidth;
-  }
+  for (; Ystart <= Yend; Ystart++)
+    DirtyRow(&ChangedVideo[Ystart], Xstart, Xend);
 }
 
-/* An important Video function: copy a rectangle. It must be _*FAST*_ !! */
-void DragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp) {
-  dat DstRgt = DstLeft + (Rgt - Left), DstDwn = DstUp + (Dwn - Up);
+/* copy a rectangle inside a DisplayWidth x DisplayHeight buffer, like Video[] or OldVideo[] */
+void DragTCellArea(tcell *Buf, dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp) {
+  dat DstDwn = DstUp + (Dwn - Up);
   ldat len, count;
-  tcell *src = Video, *dst = Video;
-  byte Accel;
-
-  if (QueuedDrawArea2FullScreen)
-    return;
+  tcell *src = Buf, *dst = Buf;
 
   count = Dwn - Up + 1;
   len = (ldat)(Rgt - Left + 1) * sizeof(tcell);
 
-  /* if HW can do the scroll, use it instead of redrawing */
-
-  /* HACK : for consistency problems, we actually drag only if all HW can drag */
-
-  Accel = AllHWCanDragAreaNow(Left, Up, Rgt, Dwn, DstLeft, DstUp);
-
-  if (Accel) {
-    FlushHW();
-    DragAreaHW(Left, Up, Rgt, Dwn, DstLeft, DstUp);
-  } else
-    DirtyVideo(DstLeft, DstUp, DstRgt, DstDwn);
-
-  /* do the drag inside Video[] */
-
   if (DstUp <= Up) {
     src += Left + Up * (ldat)DisplayWidth;
     dst += DstLeft + DstUp * (ldat)DisplayWidth;
@@ -470,9 +387,31 @@ void DragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp) {
       src -= DisplayWidth;
     }
   }
+}
 
-  if (Accel && NeedOldVideo)
-    Video2OldVideo(DstLeft, DstUp, DstRgt, DstDwn);
+/* An important Video function: copy a rectangle. It must be _*FAST*_ !! */
+void DragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp) {
+  dat DstRgt = DstLeft + (Rgt - Left), DstDwn = DstUp + (Dwn - Up);
+  byte Accel;
+
+  if (QueuedDrawArea2FullScreen)
+    return;
+
+  /* if HW can do the scroll, use it instead of redrawing */
+
+  /* HACK : for consistency problems, we actually drag only if all HW can drag */
+
+  Accel = AllHWCanDragAreaNow(Left, Up, Rgt, Dwn, DstLeft, DstUp);
+
+  if (Accel) {
+    FlushHW();
+    /* this also drags the OldVideo[] of each display */
+    DragAreaHW(Left, Up, Rgt, Dwn, DstLeft, DstUp);
+  } else
+    DirtyVideo(DstLeft, DstUp, DstRgt, DstDwn);
+
+  /* do the drag inside Video[] */
+  DragTCellArea(Video, Left, Up, Rgt, Dwn, DstLeft, DstUp);
 }
 
 byte InitTtysave(void) {
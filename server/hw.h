@@ -22,11 +22,25 @@
 extern display_hw DisplayHWCTTY;
 #define HWCTTY_DETACHED ((display_hw)1)
 
-extern tcell *Video, *OldVideo;
-extern byte NeedOldVideo, ValidOldVideo;
+/*
+ * dirty areas of Video[] are remembered per row as a small sorted list
+ * of disjoint [start, end] spans. when a row runs out of slots,
+ * DirtyVideo() merges the two spans separated by the fewest clean cells.
+ */
+#define DIRTY_SPAN_MAX 8
+
+typedef struct s_dirty_row {
+  dat N;                           /* number of spans in use */
+  dat Span[DIRTY_SPAN_MAX + 1][2]; /* {start, end}, inclusive. last slot is scratch for merging */
+} dirty_row;
+
+extern THREAD_LOCAL tcell *Video, *OldVideo;
+extern THREAD_LOCAL byte ValidOldVideo;
+extern byte NeedOldVideo;
 extern byte ExpensiveFlushVideo, NeedHW;
-extern byte CanDragArea, ChangedVideoFlagAgain;
+extern byte CanDragArea;
 extern byte QueuedDrawArea2FullScreen;
+extern THREAD_LOCAL byte *QueuedFullScreen;
 
 extern VOLATILE byte GotSignals;
 byte InitSignals(void);
@@ -36,6 +50,8 @@ byte InitTtysave(void);
 
 void DirtyVideo(dat Xstart, dat Ystart, dat Xend, dat Yend);
 void DragArea(dat Xstart, dat Ystart, dat Xend, dat Yend, dat DstXstart, dat DstYstart);
+void DragTCellArea(tcell *Buf, dat Xstart, dat Ystart, dat Xend, dat Yend, dat DstXstart,
+                   dat DstYstart);
 
 void MoveToXY(dat x, dat y);
 void SetCursorType(uldat type);
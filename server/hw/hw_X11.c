@@ -22,6 +22,7 @@
 #include "hw.h"
 #include "hw_private.h"
 #include "hw_dirty.h"
+#include "hw_diff.h"
 #include "common.h"
 
 #include <X11/Xlib.h>
@@ -3,14 +3,14 @@
 #define _TWIN_HW_DIRTY_H
 
 INLINE byte Plain_isDirtyVideo(dat X, dat Y) {
-  dat s;
-  s = ChangedVideo[Y][0][0];
-  if (s == -1 || s > X || ChangedVideo[Y][0][1] < X) {
-    s = ChangedVideo[Y][1][0];
-    if (s == -1 || s > X || ChangedVideo[Y][1][1] < X)
-      return tfalse;
+  CONST dirty_row *R = &ChangedVideo[Y];
+  dat i;
+
+  for (i = 0; i < R->N && R->Span[i][0] <= X; i++) {
+    if (R->Span[i][1] >= X)
+      return ttrue;
   }
-  return ttrue;
+  return tfalse;
 }
 
 /*
@@ -18,50 +18,35 @@ INLINE byte Plain_isDirtyVideo(dat X, dat Y) {
  * merge_Threshold will get merged together (by linux_FlushVideo() for example)
  */
 INLINE byte Threshold_isDirtyVideo(dat X, dat Y) {
-  dat s1, s2, e1, e2, delta;
+  CONST dirty_row *R = &ChangedVideo[Y];
+  dat i, s2, e1;
 
-  if ((s1 = ChangedVideo[Y][0][0]) == -1)
+  if (R->N == 0)
     return tfalse;
 
-  e1 = ChangedVideo[Y][0][1];
-  if (s1 <= X && e1 >= X)
-    return ttrue;
+  /* find the first span that does not end before X */
+  for (i = 0; i < R->N && R->Span[i][1] < X; i++)
+    ;
 
-  if (e1 < X) {
-    /* check the second slot */
-    s2 = ChangedVideo[Y][1][0];
-    if (s2 != -1) {
-      e2 = ChangedVideo[Y][1][1];
-      if (s2 <= X && e2 >= X)
-        return ttrue;
-      if (s2 > X)
-        return s2 - e1 < HW->merge_Threshold;
-      s1 = s2;
-      e1 = e2;
-    }
-  }
+  if (i < R->N) {
+    if (R->Span[i][0] <= X)
+      return ttrue;
+    if (i > 0)
+      /* X is between two spans */
+      return R->Span[i][0] - R->Span[i - 1][1] < HW->merge_Threshold;
 
-  /* check for slots in the previous/next line */
-  if (s1 > X && Y != 0)
-    delta = -1;
-  else if (e1 < X && Y < DisplayHeight - 1)
-    delta = 1;
-  else
-    return tfalse;
-
-  s2 = ChangedVideo[Y + delta][delta < 0][0];
-  if (s2 == -1) {
-    s2 = ChangedVideo[Y + delta][delta > 0][0];
-    if (s2 == -1)
+    /* X is before the first span: check the last span in the previous line */
+    if (Y == 0 || ChangedVideo[Y - 1].N == 0)
       return tfalse;
-    e2 = ChangedVideo[Y + delta][delta > 0][1];
-  } else
-    e2 = ChangedVideo[Y + delta][delta < 0][1];
+    e1 = ChangedVideo[Y - 1].Span[ChangedVideo[Y - 1].N - 1][1];
+    return R->Span[0][0] + (DisplayWidth - e1) < HW->merge_Threshold;
+  }
 
-  if (delta < 0)
-    return s1 + (DisplayWidth - e2) < HW->merge_Threshold;
-  else
-    return s2 + (DisplayWidth - e1) < HW->merge_Threshold;
+  /* X is after the last span: check the first span in the next line */
+  if (Y >= DisplayHeight - 1 || ChangedVideo[Y + 1].N == 0)
+    return tfalse;
+  s2 = ChangedVideo[Y + 1].Span[0][0];
+  return s2 + (DisplayWidth - R->Span[R->N - 1][1]) < HW->merge_Threshold;
 }
 
 /* VideoFlip is quite OS and driver independent ;) */
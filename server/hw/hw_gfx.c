@@ -20,6 +20,7 @@
 #include "hw.h"
 #include "hw_private.h"
 #include "hw_dirty.h"
+#include "hw_diff.h"
 #include "common.h"
 
 #ifndef PKG_DATADIR
@@ -187,6 +188,7 @@ static void gfx_DrawColor(myXChar *buf, udat buflen, tcolor col, tcell gfx, int
 INLINE void X11_Mogrify(dat x, dat y, ldat len) {
   tcell *V, *oV, bufgfx;
   tcolor col, _col;
+  uldat skip, run;
   udat buflen = 0;
   tcell gfx;
   trune f;
@@ -215,15 +217,17 @@ INLINE void X11_Mogrify(dat x, dat y, ldat len) {
   V = Video + x + y * (ldat)DisplayWidth;
   oV = OldVideo + x + y * (ldat)DisplayWidth;
 
-  for (_col = ~TCOLOR(*V); len; x++, V++, oV++, len--) {
-    col = TCOLOR(*V);
-    gfx = HWEXTRA(*V);
-    if (buflen &&
-        (col != _col || gfx != bufgfx || (ValidOldVideo && *V == *oV) || buflen == TW_SMALLBUFF)) {
-      XDRAW_ANY(buf, buflen, _col, bufgfx);
-      buflen = 0;
-    }
-    if (!ValidOldVideo || *V != *oV) {
+  while (len) {
+    run = DiffRunTCell(V, oV, len, &skip);
+    V += skip, oV += skip, x += skip, len -= skip;
+
+    for (len -= run; run; x++, V++, oV++, run--) {
+      col = TCOLOR(*V);
+      gfx = HWEXTRA(*V);
+      if (buflen && (col != _col || gfx != bufgfx || buflen == TW_SMALLBUFF)) {
+        XDRAW_ANY(buf, buflen, _col, bufgfx);
+        buflen = 0;
+      }
       if (!buflen) {
         xbegin = (x - xhw_startx) * (ldat)xwfont;
         _col = col;
@@ -233,10 +237,10 @@ INLINE void X11_Mogrify(dat x, dat y, ldat len) {
       buf[buflen].byte1 = f >> 8;
       buf[buflen++].byte2 = f & 0xFF;
     }
-  }
-  if (buflen) {
-    XDRAW_ANY(buf, buflen, _col, bufgfx);
-    buflen = 0;
+    if (buflen) {
+      XDRAW_ANY(buf, buflen, _col, bufgfx);
+      buflen = 0;
+    }
   }
 }
 
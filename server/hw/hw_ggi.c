@@ -24,6 +24,7 @@
 #include "hw.h"
 #include "hw_private.h"
 #include "hw_dirty.h"
+#include "hw_diff.h"
 #include "common.h"
 
 #include <ggi/ggi.h>
@@ -201,6 +202,7 @@ static tcolor _col;
 INLINE void GGI_Mogrify(dat x, dat y, uldat len) {
   tcell *V, *oV;
   tcolor col;
+  uldat skip, run;
   udat buflen = 0;
   byte buf[TW_SMALLBUFF];
   int xbegin = x * gfont.x, ybegin = y * gfont.y;
@@ -208,14 +210,17 @@ INLINE void GGI_Mogrify(dat x, dat y, uldat len) {
   V = Video + x + y * (ldat)DisplayWidth;
   oV = OldVideo + x + y * (ldat)DisplayWidth;
 
-  for (_col = ~TCOLOR(*V); len; x++, V++, oV++, len--) {
-    col = TCOLOR(*V);
-    if (buflen && (col != _col || (ValidOldVideo && *V == *oV) || buflen == TW_SMALLBUFF - 1)) {
-      buf[buflen] = '\0';
-      GDRAW(_col, buf, buflen);
-      buflen = 0;
-    }
-    if (!ValidOldVideo || *V != *oV) {
+  while (len) {
+    run = DiffRunTCell(V, oV, len, &skip);
+    V += skip, oV += skip, x += skip, len -= skip;
+
+    for (len -= run; run; x++, V++, oV++, run--) {
+      col = TCOLOR(*V);
+      if (buflen && (col != _col || buflen == TW_SMALLBUFF - 1)) {
+        buf[buflen] = '\0';
+        GDRAW(_col, buf, buflen);
+        buflen = 0;
+      }
       if (!buflen) {
         xbegin = x * (ldat)gfont.x;
         _col = col;
@@ -223,11 +228,11 @@ INLINE void GGI_Mogrify(dat x, dat y, uldat len) {
       buf[buflen++] = TRUNE(*V) ? TRUNE(*V) : ' ';
       /* ggiPuts cannot handle '\0' */
     }
-  }
-  if (buflen) {
-    buf[buflen] = '\0';
-    GDRAW(_col, buf, buflen);
-    buflen = 0;
+    if (buflen) {
+      buf[buflen] = '\0';
+      GDRAW(_col, buf, buflen);
+      buflen = 0;
+    }
   }
 }
 
@@ -271,7 +276,7 @@ static void GGI_ShowCursor(uldat type, dat x, dat y) {
 
 static void GGI_FlushVideo(void) {
   uldat i;
-  dat start, end;
+  dat k, start, end;
   byte iff;
 
   if (ValidOldVideo) {
@@ -282,12 +287,13 @@ static void GGI_FlushVideo(void) {
 
   /* first burst all changes */
   if (ChangedVideoFlag) {
-    for (i = 0; i < (ldat)DisplayHeight * 2; i++) {
-      start = ChangedVideo[i >> 1][i & 1][0];
-      end = ChangedVideo[i >> 1][i & 1][1];
+    for (i = 0; i < (ldat)DisplayHeight; i++) {
+      for (k = 0; k < ChangedVideo[i].N; k++) {
+        start = ChangedVideo[i].Span[k][0];
+        end = ChangedVideo[i].Span[k][1];
 
-      if (start != -1)
-        GGI_Mogrify(start, i >> 1, end - start + 1);
+        GGI_Mogrify(start, i, end - start + 1);
+      }
     }
     setFlush();
   }
@@ -22,6 +22,8 @@
 
 #include "tty_ioctl.h"
 
+#include <stdarg.h>
+
 #include "twin.h"
 #include "algo.h"
 #include "alloc.h"
@@ -33,8 +35,13 @@
 #include "hw.h"
 #include "hw_private.h"
 #include "hw_dirty.h"
+#include "hw_diff.h"
 #include "common.h"
 
+#ifdef HAVE_THREAD_LOCAL
+#include <pthread.h>
+#endif
+
 #include <Tw/Twkeys.h>
 #include <Tutf/Tutf.h>
 
@@ -62,6 +69,12 @@ struct tty_data {
   byte tty_use_utf8, tty_is_xterm;
   dat ttypar[3];
   FILE *stdOUT;
+  int tty_out_fd;
+  char *tty_out_buf;
+  uldat tty_out_len, tty_out_size, tty_out_frame;
+  uldat tty_out_sent, tty_out_queued; /* see tty_out_Measure() */
+  timevalue tty_out_time;
+  byte tty_out_skipped, tty_out_nomem;
   uldat saveCursorType;
   dat saveX, saveY;
 
@@ -79,7 +92,7 @@ struct tty_data {
 
 #ifdef CONF_HW_TTY_TERMCAP
   char *tc_cap[tc_cap_N];
-  byte colorbug, wrapglitch;
+  byte colorbug, wrapglitch, backcolorerase, repeatchar;
 #else
   char *tc_scr_clear;
 #endif
@@ -98,6 +111,16 @@ struct tty_data {
 #define tty_is_xterm (ttydata->tty_is_xterm)
 #define ttypar (ttydata->ttypar)
 #define stdOUT (ttydata->stdOUT)
+#define tty_out_fd (ttydata->tty_out_fd)
+#define tty_out_buf (ttydata->tty_out_buf)
+#define tty_out_len (ttydata->tty_out_len)
+#define tty_out_size (ttydata->tty_out_size)
+#define tty_out_frame (ttydata->tty_out_frame)
+#define tty_out_sent (ttydata->tty_out_sent)
+#define tty_out_queued (ttydata->tty_out_queued)
+#define tty_out_time (ttydata->tty_out_time)
+#define tty_out_skipped (ttydata->tty_out_skipped)
+#define tty_out_nomem (ttydata->tty_out_nomem)
 #define saveCursorType (ttydata->saveCursorType)
 #define saveX (ttydata->saveX)
 #define saveY (ttydata->saveY)
@@ -131,8 +154,15 @@ struct tty_data {
 #define tc_audio_bell (tc_cap[tc_seq_audio_bell])
 #define tc_charset_start (tc_cap[tc_seq_charset_start])
 #define tc_charset_end (tc_cap[tc_seq_charset_end])
+#define tc_cursor_right (tc_cap[tc_seq_cursor_right])
+#define tc_parm_right (tc_cap[tc_seq_parm_right])
+#define tc_cursor_down (tc_cap[tc_seq_cursor_down])
+#define tc_clr_eol (tc_cap[tc_seq_clr_eol])
+#define tc_erase_chars (tc_cap[tc_seq_erase_chars])
 #define colorbug (ttydata->colorbug)
 #define wrapglitch (ttydata->wrapglitch)
+#define backcolorerase (ttydata->backcolorerase)
+#define repeatchar (ttydata->repeatchar)
 #else
 #define tc_scr_clear (ttydata->tc_scr_clear)
 #endif
@@ -146,15 +176,23 @@ static void stdout_FlushHW(void);
 
 static void tty_MogrifyUTF8(trune h);
 
-/* this can stay static, as it's used only as temporary storage */
-static tcolor _col;
+/*
+ * these can stay static, as they're used only as temporary storage.
+ * they are per thread, as FlushVideo() may run on a worker thread
+ */
+static THREAD_LOCAL tcolor _col;
+static THREAD_LOCAL dat _cx, _cy; /* terminal cursor position, -1 if unknown */
 
 static void tty_QuitHW(void);
 
+#include "hw_tty_common/output_buffer.h"
+
 #include "hw_tty_common/kbd_stdin.h"
 
 #include "hw_tty_common/mouse_xterm.h"
 
+#include "hw_tty_common/output_cost.h"
+
 #if defined(CONF_HW_TTY_LINUX) || defined(CONF_HW_TTY_TWTERM)
 #include "hw_tty_linux/driver_linux.h"
 #endif
@@ -176,7 +214,7 @@ static void null_InitMouse(void) {
 static byte null_InitMouseConfirm(void) {
   byte c = '\0';
 
-  fflush(stdOUT);
+  tty_out_Drain();
   printk("%s", "\n"
                "      \033[1m  ALL  MOUSE  DRIVERS  FAILED.\033[0m\n"
                "\n"
@@ -221,12 +259,12 @@ static void stdin_Resize(dat x, dat y) {
      * can't resize the tty, just clear it so that
      * extra size will get padded with blanks
      */
-    fprintf(stdOUT, "\033[0m%s", tc_scr_clear);
-    fflush(stdOUT);
     /*
-     * flush now not to risk arriving late
-     * and clearing the screen AFTER *_FlushVideo()
+     * the buffer keeps the order, so this cannot arrive
+     * AFTER *_FlushVideo() and clear the new screen contents
      */
+    tty_printf("\033[0m%s", tc_scr_clear);
+    setFlush();
     NeedRedrawVideo(0, 0, x - 1, y - 1);
   }
   HW->usedX = x;
@@ -234,31 +272,46 @@ static void stdin_Resize(dat x, dat y) {
 }
 
 static void stdout_FlushHW(void) {
-  if (fflush(stdOUT) != 0)
+  byte ret = tty_out_Flush();
+  if (ret != tfalse)
+    tty_out_Measure();
+  if (ret == tfalse)
     HW->NeedHW |= NEEDPanicHW, NeedHW |= NEEDPanicHW;
-  clrFlush();
+  else if (ret == ttrue) {
+    if (HW->NeedHW & NEEDFromPreviousFlushHW) {
+      HW->NeedHW &= ~NEEDFromPreviousFlushHW;
+      RemoteCouldWrite(HW->keyboard_slot);
+    }
+    clrFlush();
+    if (tty_out_skipped)
+      /* ask for a frame: tty_out_SkipFrame() repaints what was skipped */
+      NeedRedrawVideo(0, 0, DisplayWidth - 1, DisplayHeight - 1);
+  } else if (!(HW->NeedHW & NEEDFromPreviousFlushHW)) {
+    /* wait until tty_fd is writable and come back here */
+    HW->NeedHW |= NEEDFromPreviousFlushHW;
+    RemoteCouldntWrite(HW->keyboard_slot);
+  }
 }
 
 static void tty_MogrifyUTF8(trune h) {
-  char buf[5];
+  char buf[4];
 
   if (h <= 0x7FF) {
     buf[0] = (h >> 6) | 0xC0;
     buf[1] = (h & 0x3F) | 0x80;
-    buf[2] = 0;
+    tty_write(buf, 2);
   } else if (h <= 0xFFFF) {
     buf[0] = (h >> 12) | 0xE0;
     buf[1] = ((h >> 6) & 0x3F) | 0x80;
     buf[2] = (h & 0x3F) | 0x80;
-    buf[3] = 0;
+    tty_write(buf, 3);
   } else {
     buf[0] = (h >> 18) | 0xF0;
     buf[1] = ((h >> 12) & 0x3F) | 0x80;
     buf[2] = ((h >> 6) & 0x3F) | 0x80;
     buf[3] = (h & 0x3F) | 0x80;
-    buf[4] = 0;
+    tty_write(buf, 4);
   }
-  fputs(buf, stdOUT);
 }
 
 /*
@@ -287,7 +340,7 @@ static byte tty_InitHW(void) {
   tty_use_utf8 = ttrue + ttrue; /* i.e. unknown */
   saveX = saveY = 0;
   stdOUT = NULL;
-  tty_fd = -1;
+  tty_fd = tty_out_fd = -1;
   tty_TERM = tty_name = NULL;
 
   if (arg && HW->NameLen > 4) {
@@ -427,7 +480,7 @@ static byte tty_InitHW(void) {
     }
   }
   fflush(stdOUT);
-  setvbuf(stdOUT, NULL, _IOFBF, BUFSIZ);
+  tty_out_Open();
 
   tty_number = 0;
   if (tty_name && (!strncmp(tty_name, "/dev/tty", 8) || !strncmp(tty_name, "/dev/vc/", 8))) {
@@ -535,8 +588,8 @@ static byte tty_InitHW(void) {
         NeedRedrawVideo(0, 0, HW->X - 1, HW->Y - 1);
 
         if (tc_scr_clear)
-          fputs(tc_scr_clear, stdOUT);
-        fflush(stdOUT);
+          tty_puts(tc_scr_clear);
+        tty_out_Drain();
 
         return ttrue;
       }
@@ -544,6 +597,7 @@ static byte tty_InitHW(void) {
     }
     HW->QuitVideo();
   }
+  tty_out_Close();
   if (tty_fd >= 0)
     tty_setioctl(tty_fd, &ttysave);
   if (tty_fd > 0)
@@ -566,7 +620,7 @@ static void tty_QuitHW(void) {
   if (HW->DisplayIsCTTY && DisplayHWCTTY == HW)
     DisplayHWCTTY = NULL;
 
-  fflush(stdOUT);
+  tty_out_Close();
   if (stdOUT != stdout) {
 
     /* if we forced tty_fd to be fd 0, release it while keeping fd 0 busy */
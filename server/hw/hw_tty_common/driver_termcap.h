@@ -2,11 +2,36 @@
 
 #ifdef CONF_HW_TTY_TERMCAP
 
+#ifdef HAVE_THREAD_LOCAL
+/*
+ * tgoto() returns a static buffer, and displays may call it from their worker threads:
+ * serialize it and copy the result to a per-thread buffer.
+ */
+static pthread_mutex_t termcap_goto_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *termcap_goto(char *cap, int x, int y) {
+  static THREAD_LOCAL char buf[64];
+  uldat len;
+  char *s;
+
+  pthread_mutex_lock(&termcap_goto_mutex);
+  s = tgoto(cap, x, y);
+  len = Min2(strlen(s), sizeof(buf) - 1);
+  CopyMem(s, buf, len);
+  buf[len] = '\0';
+  pthread_mutex_unlock(&termcap_goto_mutex);
+  return buf;
+}
+#else
+#define termcap_goto tgoto
+#endif
+
 INLINE void termcap_SetCursorType(uldat type) {
-  fprintf(stdOUT, "%s", (type & 0xFFFFFFl) == NOCURSOR ? tc_cursor_off : tc_cursor_on);
+  tty_puts((type & 0xFFFFFFl) == NOCURSOR ? tc_cursor_off : tc_cursor_on);
 }
 INLINE void termcap_MoveToXY(udat x, udat y) {
-  fputs(tgoto(tc_cursor_goto, x, y), stdOUT);
+  tty_puts(termcap_goto(tc_cursor_goto, x, y));
+  _cx = x, _cy = y;
 }
 
 static udat termcap_LookupKey(udat *ShiftFlags, byte *slen, char *s, byte *retlen,
@@ -131,13 +156,15 @@ static void fixup_colorbug(void) {
 
 static byte termcap_InitVideo(void) {
   CONST char *term = tty_TERM;
-  CONST char *tc_name[tc_cap_N + 1] = {"cl", "cm", "ve", "vi", "md", "mb", "me", "ks", "ke",
-                                       "bl", "as", "ae", "k1", "k2", "k3", "k4", "k5", "k6",
-                                       "k7", "k8", "k9", "k;", "F1", "F2", "&7", "kh", "@7",
-                                       "kD", "kI", "kN", "kP", "kl", "ku", "kr", "kd", NULL};
+  CONST char *tc_name[tc_cap_N + 1] = {
+      "cl", "cm", "ve", "vi", "md", "mb", "me", "ks", "ke", "bl", "as", "ae", "nd",
+      "RI", "do", "ce", "ec", "k1", "k2", "k3", "k4", "k5", "k6", "k7", "k8", "k9",
+      "k;", "F1", "F2", "&7", "kh", "@7", "kD", "kI", "kN", "kP", "kl", "ku", "kr",
+      "kd", NULL};
   CONST char **n;
   char **d;
   char tcbuf[4096]; /* by convention, this is enough */
+  char capbuf[64], *capp = capbuf, *cap;
 
   if (!term) {
     printk("      termcap_InitVideo() failed: unknown terminal type.\n");
@@ -195,11 +222,17 @@ static byte termcap_InitVideo(void) {
   }
 
   wrapglitch = tgetflag("xn");
+  backcolorerase = tgetflag("ut");
+  /* we only use the ANSI form of repeat_char, i.e. ESC [ <n> b */
+  repeatchar = (cap = tgetstr("rp", &capp)) && *cap && cap[strlen(cap) - 1] == 'b';
   if (colorbug)
     fixup_colorbug();
 
-  fprintf(stdOUT, "%s%s%s", tc_attr_off, (tc_charset_start ? (CONST char *)tc_charset_start : ""),
-          (tty_is_xterm ? "\033[?1h" : ""));
+  tty_puts(tc_attr_off);
+  if (tc_charset_start)
+    tty_puts(tc_charset_start);
+  if (tty_is_xterm)
+    tty_puts("\033[?1h");
 
   HW->FlushVideo = termcap_FlushVideo;
   HW->FlushHW = stdout_FlushHW;
@@ -232,7 +265,7 @@ static byte termcap_InitVideo(void) {
 
   HW->QuitVideo = termcap_QuitVideo;
 
-  HW->FlagsHW |= FlHWNeedOldVideo;
+  HW->FlagsHW |= FlHWNeedOldVideo | FlHWThreadedFlushVideo;
   HW->FlagsHW &= ~FlHWExpensiveFlushVideo;
   HW->NeedHW = 0;
   HW->merge_Threshold = 0;
@@ -247,7 +280,9 @@ static void termcap_QuitVideo(void) {
   termcap_MoveToXY(0, DisplayHeight - 1);
   termcap_SetCursorType(LINECURSOR);
   /* reset colors and charset */
-  fprintf(stdOUT, "%s%s", tc_attr_off, tc_charset_end ? tc_charset_end : "");
+  tty_puts(tc_attr_off);
+  if (tc_charset_end)
+    tty_puts(tc_charset_end);
 
   /* restore original alt cursor keys, keypad settings */
   HW->Configure(HW_KBDAPPLIC, ttrue, 0);
@@ -259,8 +294,9 @@ static void termcap_QuitVideo(void) {
 }
 
 #define termcap_MogrifyInit()                                                                      \
-  fputs(tc_attr_off, stdOUT);                                                                      \
-  _col = COL(WHITE, BLACK)
+  tty_puts(tc_attr_off);                                                                           \
+  _col = COL(WHITE, BLACK);                                                                        \
+  _cx = _cy = -1
 #define termcap_MogrifyFinish()                                                                    \
   do {                                                                                             \
   } while (0)
@@ -272,7 +308,7 @@ INLINE char *termcap_CopyAttr(char *attr, char *dest) {
 }
 
 INLINE void termcap_SetColor(tcolor col) {
-  static char colbuf[80];
+  static THREAD_LOCAL char colbuf[80];
   char *colp = colbuf;
   byte c;
 
@@ -315,66 +351,18 @@ INLINE void termcap_SetColor(tcolor col) {
   *colp = '\0';
   _col = col;
 
-  fputs(colbuf, stdOUT);
-}
-
-INLINE void termcap_Mogrify(dat x, dat y, uldat len) {
-  uldat delta = x + y * (uldat)DisplayWidth;
-  tcell *V, *oV;
-  tcolor col;
-  trune c, _c;
-  byte sending = tfalse;
-
-  if (!wrapglitch && delta + len >= (uldat)DisplayWidth * DisplayHeight)
-    len = (uldat)DisplayWidth * DisplayHeight - delta - 1;
-
-  V = Video + delta;
-  oV = OldVideo + delta;
-
-  for (; len; V++, oV++, x++, len--) {
-    if (!ValidOldVideo || *V != *oV) {
-      if (!sending)
-        sending = ttrue, termcap_MoveToXY(x, y);
-
-      col = TCOLOR(*V);
-
-      if (col != _col)
-        termcap_SetColor(col);
-
-      c = _c = TRUNE(*V);
-      if (c >= 128) {
-        if (tty_use_utf8) {
-          /* use utf-8 to output this non-ASCII char */
-          tty_MogrifyUTF8(_c);
-          continue;
-        } else if (tty_charset_to_UTF_32[c] != c) {
-          c = tty_UTF_32_to_charset(_c);
-        }
-      }
-      if (c < 32 || c == 127 || c == 128 + 27) {
-        /* can't display it */
-        c = Tutf_UTF_32_to_ASCII(_c);
-        if (c < 32 || c >= 127)
-          c = 32;
-      }
-      putc((char)c, stdOUT);
-    } else
-      sending = tfalse;
-  }
+  tty_puts(colbuf);
 }
 
-INLINE void termcap_SingleMogrify(dat x, dat y, tcell V) {
+/* send a single cell at current cursor position */
+INLINE void termcap_PutTCell(tcell V) {
   trune c, _c;
 
-  if (!wrapglitch && x == DisplayWidth - 1 && y == DisplayHeight - 1)
-    /* wrapglitch is required to write to last screen position without scrolling */
-    return;
-
-  termcap_MoveToXY(x, y);
-
   if (TCOLOR(V) != _col)
     termcap_SetColor(TCOLOR(V));
 
+  tty_AdvanceCursor(1);
+
   c = _c = TRUNE(V);
   if (c >= 128) {
     if (tty_use_utf8) {
@@ -391,7 +379,151 @@ INLINE void termcap_SingleMogrify(dat x, dat y, tcell V) {
     if (c < 32 || c >= 127)
       c = 32;
   }
-  putc((char)c, stdOUT);
+  tty_putc((char)c);
+}
+
+INLINE uldat termcap_RightCost(dat n) {
+  if (n == 1 && *tc_cursor_right)
+    return strlen(tc_cursor_right);
+  if (*tc_parm_right)
+    return strlen(termcap_goto(tc_parm_right, 0, n));
+  return TTY_NO_COST;
+}
+
+INLINE void termcap_Right(dat n) {
+  if (n == 1 && *tc_cursor_right)
+    tty_puts(tc_cursor_right);
+  else
+    tty_puts(termcap_goto(tc_parm_right, 0, n));
+  _cx += n;
+}
+
+/* move the cursor to (x, y) with the shortest sequence we know of */
+static void termcap_GotoXY(dat x, dat y) {
+  uldat cost, best;
+  enum { by_goto, by_rewrite, by_right, by_newline } how = by_goto;
+
+  if (_cx == x && _cy == y)
+    return;
+
+  best = strlen(termcap_goto(tc_cursor_goto, x, y));
+
+  if (_cy == y && _cx >= 0 && _cx < x) {
+    /* the cells in between are already on screen, so rewriting them is always correct */
+    if (x - _cx <= TTY_REWRITE_MAX &&
+        (cost = tty_RewriteCost(Video + _cx + y * (ldat)DisplayWidth, x - _cx, _col)) < best)
+      best = cost, how = by_rewrite;
+    if ((cost = termcap_RightCost(x - _cx)) < best)
+      best = cost, how = by_right;
+  }
+  if (_cy >= 0 && (_cy == y || (_cy + 1 == y && *tc_cursor_down))) {
+    /* carriage return, maybe cursor down, maybe cursor right */
+    cost = 1 + (_cy != y ? strlen(tc_cursor_down) : 0) + (x ? termcap_RightCost(x) : 0);
+    if (cost < best)
+      best = cost, how = by_newline;
+  }
+
+  switch (how) {
+  case by_rewrite:
+    for (cost = x - _cx; cost; cost--)
+      termcap_PutTCell(Video[_cx + y * (ldat)DisplayWidth]);
+    break;
+  case by_right:
+    termcap_Right(x - _cx);
+    break;
+  case by_newline:
+    tty_putc('\r');
+    if (_cy != y)
+      tty_puts(tc_cursor_down);
+    _cx = 0, _cy = y;
+    if (x)
+      termcap_Right(x);
+    break;
+  default:
+    termcap_MoveToXY(x, y);
+    break;
+  }
+}
+
+/*
+ * send the run V[0 ... run-1] of changed cells that goes at (x, y).
+ * blanks can be erased with ECH, or with EL if the rest of the row is blank too,
+ * and other repeated cells sent once then repeated with REP.
+ * return the number of cells of the row (starting at x) that are now up to date.
+ */
+static uldat termcap_PutRun(CONST tcell *V, dat x, dat y, uldat run) {
+  uldat n, i, tail = DisplayWidth - x;
+  CONST tcell *V0 = V;
+
+  while (run) {
+    termcap_GotoXY(x, y);
+    n = tty_SameCells(V, run);
+
+    if (n > 1 && backcolorerase && tty_IsErasable(*V)) {
+      if (*tc_clr_eol && strlen(tc_clr_eol) < n && tty_SameCells(V, tail) == tail) {
+        if (TCOLOR(*V) != _col)
+          termcap_SetColor(TCOLOR(*V));
+        tty_puts(tc_clr_eol);
+        return (V - V0) + tail;
+      }
+      if (*tc_erase_chars &&
+          strlen(termcap_goto(tc_erase_chars, 0, n)) + termcap_RightCost(n) < n) {
+        if (TCOLOR(*V) != _col)
+          termcap_SetColor(TCOLOR(*V));
+        tty_puts(termcap_goto(tc_erase_chars, 0, n));
+        /* ECH does not move the cursor */
+        V += n, x += n, run -= n, tail -= n;
+        continue;
+      }
+    }
+    if (n > 1 && repeatchar && tty_IsRepeatable(*V) && 3 + tty_DecLen(n - 1) < n - 1) {
+      termcap_PutTCell(*V);
+      tty_printf("\033[%ub", (unsigned)(n - 1));
+      tty_AdvanceCursor(n - 1);
+    } else {
+      for (i = n; i; i--)
+        termcap_PutTCell(*V);
+    }
+    V += n, x += n, run -= n, tail -= n;
+  }
+  return V - V0;
+}
+
+INLINE void termcap_Mogrify(dat x, dat y, uldat len) {
+  uldat delta = x + y * (uldat)DisplayWidth;
+  uldat skip, run;
+  tcell *V, *oV;
+
+  if (!wrapglitch && delta + len >= (uldat)DisplayWidth * DisplayHeight)
+    len = (uldat)DisplayWidth * DisplayHeight - delta - 1;
+
+  V = Video + delta;
+  oV = OldVideo + delta;
+
+  while (len) {
+    run = DiffRunTCell(V, oV, len, &skip);
+    V += skip, oV += skip, x += skip, len -= skip;
+
+    if (run) {
+      run = termcap_PutRun(V, x, y, run);
+      if (run > len) {
+        /* EL cleared the whole row: remember it, or later spans would draw it again */
+        if (ValidOldVideo)
+          CopyMem(V + len, oV + len, (run - len) * sizeof(tcell));
+        run = len;
+      }
+      V += run, oV += run, x += run, len -= run;
+    }
+  }
+}
+
+INLINE void termcap_SingleMogrify(dat x, dat y, tcell V) {
+  if (!wrapglitch && x == DisplayWidth - 1 && y == DisplayHeight - 1)
+    /* wrapglitch is required to write to last screen position without scrolling */
+    return;
+
+  termcap_MoveToXY(x, y);
+  termcap_PutTCell(V);
 }
 
 /* HideMouse and ShowMouse depend on Video setup, not on Mouse.
@@ -419,7 +551,7 @@ static void termcap_HideMouse(void) {
 }
 
 static void termcap_Beep(void) {
-  fputs(tc_audio_bell, stdOUT);
+  tty_puts(tc_audio_bell);
   setFlush();
 }
 
@@ -449,19 +581,19 @@ static void termcap_ConfigureKeyboard(udat resource, byte todefault, udat value)
   switch (resource) {
   case HW_KBDAPPLIC:
     if (tty_is_xterm) {
-      fputs(todefault || !value ? tc_kpad_on : tc_kpad_off, stdOUT);
+      tty_puts(todefault || !value ? tc_kpad_on : tc_kpad_off);
       /*
        * on xterm, tc_kpad_off has the undesired side-effect
        * of changing the sequences produced by cursor keys,
        * so we must restore the usual sequences
        */
-      fputs("\033[?1h", stdOUT);
+      tty_puts("\033[?1h");
       setFlush();
     }
     break;
   case HW_ALTCURSKEYS:
     /*
-     fputs(todefault || !value ? "\033[?1l" : "\033[?1h", stdOUT);
+     tty_puts(todefault || !value ? "\033[?1l" : "\033[?1h");
      setFlush();
      */
     break;
@@ -496,11 +628,12 @@ static void termcap_DragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, da
   HW->HideMouse();
   HW->FlagsHW |= FlHWChangedMouseFlag;
 
-  fprintf(stdOUT, "%s\033[0m%s",                               /* hide cursor, reset color */
-          tc_cursor_off, tgoto(tc_cursor_goto, 0, HW->Y - 1)); /* go to last line */
+  tty_puts(tc_cursor_off);                       /* hide cursor */
+  tty_puts("\033[0m");                           /* reset color */
+  tty_puts(termcap_goto(tc_cursor_goto, 0, HW->Y - 1)); /* go to last line */
 
   while (delta--)
-    putc('\n', stdOUT);
+    tty_putc('\n');
 
   setFlush();
 
@@ -515,11 +648,14 @@ static void termcap_DragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, da
 }
 
 static void termcap_FlushVideo(void) {
-  dat i, j;
+  dat i, j, k;
   dat start, end;
   byte FlippedVideo = tfalse, FlippedOldVideo = tfalse;
   tcell savedOldVideo;
 
+  if (tty_out_SkipFrame())
+    return;
+
   if (!ChangedVideoFlag) {
     HW->UpdateMouseAndCursor();
     return;
@@ -564,12 +700,13 @@ static void termcap_FlushVideo(void) {
   termcap_MogrifyInit();
   if (HW->TT != NOCURSOR)
     termcap_SetCursorType(HW->TT = NOCURSOR);
-  for (i = 0; i < DisplayHeight * 2; i++) {
-    start = ChangedVideo[i >> 1][i & 1][0];
-    end = ChangedVideo[i >> 1][i & 1][1];
+  for (i = 0; i < DisplayHeight; i++) {
+    for (k = 0; k < ChangedVideo[i].N; k++) {
+      start = ChangedVideo[i].Span[k][0];
+      end = ChangedVideo[i].Span[k][1];
 
-    if (start != -1)
-      termcap_Mogrify(start, i >> 1, end - start + 1);
+      termcap_Mogrify(start, i, end - start + 1);
+    }
   }
 
   /* force updating the cursor */
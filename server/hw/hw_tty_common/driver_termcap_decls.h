@@ -99,6 +99,11 @@ enum {
   tc_seq_audio_bell,
   tc_seq_charset_start,
   tc_seq_charset_end,
+  tc_seq_cursor_right,
+  tc_seq_parm_right,
+  tc_seq_cursor_down,
+  tc_seq_clr_eol,
+  tc_seq_erase_chars,
 
   tc_seq_last,
   tc_key_first = tc_seq_last,
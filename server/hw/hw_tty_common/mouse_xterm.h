@@ -61,7 +61,7 @@ static byte xterm_InitMouse(byte force) {
     return tfalse;
   }
 
-  fputs(mouse_start_seq, stdOUT);
+  tty_puts(mouse_start_seq);
   setFlush();
 
   HW->mouse_slot = NOSLOT; /* shared with keyboard */
@@ -77,7 +77,7 @@ static byte xterm_InitMouse(byte force) {
 }
 
 static void xterm_QuitMouse(void) {
-  fputs(mouse_end_seq, stdOUT);
+  tty_puts(mouse_end_seq);
   HW->QuitMouse = NoOp;
 }
 
@@ -85,7 +85,7 @@ static void xterm_ConfigureMouse(udat resource, byte todefault, udat value) {
   switch (resource) {
   case HW_MOUSEMOTIONEVENTS:
     /* either enable new style + mouse motion, or switch back to new style */
-    fputs(value && !todefault ? mouse_motion_seq : mouse_start_seq, stdOUT);
+    tty_puts(value && !todefault ? mouse_motion_seq : mouse_start_seq);
     setFlush();
     break;
   default:
@@ -0,0 +1,198 @@
+
+/*
+ * buffered tty output.
+ *
+ * the tty drivers append everything they send to the terminal
+ * to a per-display buffer, and stdout_FlushHW() sends a whole frame with one write().
+ *
+ * writes go through tty_out_fd, a non-blocking file description of our own,
+ * so a slow or stuck terminal cannot block the server: whatever the terminal
+ * does not accept stays queued, tty_fd is watched for writability
+ * as remote.c does for its write queues, and the rest is sent on the next FlushHW().
+ *
+ * while too much output is queued, new frames are skipped, and the whole screen
+ * is repainted once the queue drains. the same happens if the buffer cannot grow:
+ * it is cut back to tty_out_frame, where the frame being written starts,
+ * so that no half escape sequence reaches the terminal, and the rest is dropped.
+ *
+ * after each flush, tty_out_Measure() tells frame pacing how much output the terminal
+ * did not consume yet and how fast it consumes it: see FrameDelayHW() in hw_multi.c.
+ */
+
+/* initial buffer size */
+#define TTY_OUT_MIN 4096
+
+/* skip frames while more than this many bytes are queued */
+#define TTY_OUT_BACKLOG 65536
+
+/* give up draining the buffer if the terminal accepts nothing for this many seconds */
+#define TTY_OUT_TIMEOUT 2
+
+static byte tty_out_Grow(uldat len) {
+  uldat size = tty_out_size ? tty_out_size : TTY_OUT_MIN;
+  char *buf;
+
+  while (size - tty_out_len < len)
+    size <<= 1;
+  if (!(buf = (char *)ReAllocMem(tty_out_buf, size))) {
+    /* drop this frame and repaint later */
+    tty_out_len = tty_out_frame;
+    tty_out_skipped = tty_out_nomem = ttrue;
+    return tfalse;
+  }
+  tty_out_buf = buf;
+  tty_out_size = size;
+  return ttrue;
+}
+
+static void tty_write(CONST char *s, uldat len) {
+  if (!tty_out_nomem && (tty_out_size - tty_out_len >= len || tty_out_Grow(len))) {
+    CopyMem(s, tty_out_buf + tty_out_len, len);
+    tty_out_len += len;
+  }
+}
+
+static void tty_puts(CONST char *s) { tty_write(s, strlen(s)); }
+
+INLINE void tty_putc(char c) {
+  if (!tty_out_nomem && (tty_out_len < tty_out_size || tty_out_Grow(1)))
+    tty_out_buf[tty_out_len++] = c;
+}
+
+/* only used for short escape sequences */
+static void tty_printf(CONST char *format, ...) {
+  char buf[128];
+  va_list ap;
+  int len;
+
+  va_start(ap, format);
+  len = vsnprintf(buf, sizeof(buf), format, ap);
+  va_end(ap);
+
+  if (len > 0)
+    tty_write(buf, Min2((uldat)len, (uldat)sizeof(buf) - 1));
+}
+
+/*
+ * write as much of the buffer as the terminal accepts.
+ * return ttrue if all was written, ttrue+ttrue if some is still queued,
+ * or tfalse on errors.
+ */
+static byte tty_out_Flush(void) {
+  uldat done = 0;
+  ssize_t n;
+
+  while (done < tty_out_len) {
+    n = write(tty_out_fd, tty_out_buf + done, tty_out_len - done);
+    if (n > 0)
+      done += n;
+    else if (n < 0 && errno == EINTR)
+      continue;
+    else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    else {
+      tty_out_len = tty_out_frame = 0;
+      return tfalse;
+    }
+  }
+  tty_out_sent += done;
+  if (done && done < tty_out_len)
+    MoveMem(tty_out_buf + done, tty_out_buf, tty_out_len - done);
+  /* what is still queued was complete when flushed */
+  tty_out_frame = tty_out_len -= done;
+
+  return tty_out_len ? ttrue + ttrue : ttrue;
+}
+
+/*
+ * set HW->OutBacklog to the bytes still in tty_out_buf or in the kernel tty queue.
+ * if some were pending both at the previous call and now, the terminal was busy
+ * all the time in between: what it consumed meanwhile gives a sample of HW->DrainRate.
+ */
+static void tty_out_Measure(void) {
+  timevalue now, dt;
+  uldat queued = 0, drained;
+  double rate;
+#ifdef TIOCOUTQ
+  int n;
+
+  if (ioctl(tty_out_fd, TIOCOUTQ, &n) >= 0 && n > 0)
+    queued = (uldat)n;
+#endif
+  InstantNow(&now);
+  SubTime(&dt, &now, &tty_out_time);
+
+  if (HW->OutBacklog && (queued || tty_out_len) && !dt.Seconds && dt.Fraction >= 1 MilliSECs &&
+      (drained = tty_out_queued + tty_out_sent) > queued) {
+    drained -= queued;
+    rate = Min2((double)drained * (1 FullSECs) / dt.Fraction, (double)TW_MAXULDAT / 4);
+    HW->DrainRate = HW->DrainRate ? (HW->DrainRate * 3 + (uldat)rate) / 4 : (uldat)rate;
+  }
+  tty_out_queued = queued;
+  tty_out_sent = 0;
+  tty_out_time = now;
+  HW->OutBacklog = queued + tty_out_len;
+}
+
+/* write the whole buffer, waiting for the terminal if needed. used at init and quit */
+static void tty_out_Drain(void) {
+  struct timeval t;
+  fd_set wfds;
+  int n;
+
+  while (tty_out_Flush() == ttrue + ttrue) {
+    FD_ZERO(&wfds);
+    FD_SET(tty_out_fd, &wfds);
+    t.tv_sec = TTY_OUT_TIMEOUT;
+    t.tv_usec = 0;
+    n = select(tty_out_fd + 1, NULL, &wfds, NULL, &t);
+    if (n == 0 || (n < 0 && errno != EINTR)) {
+      tty_out_len = tty_out_frame = 0;
+      break;
+    }
+  }
+}
+
+/*
+ * called at the beginning of FlushVideo(): mark where the frame starts in the buffer,
+ * and return ttrue if the frame must be skipped because the terminal is still busy
+ * with previous ones.
+ */
+static byte tty_out_SkipFrame(void) {
+  tty_out_frame = tty_out_len;
+  tty_out_nomem = tfalse;
+
+  if (tty_out_len > TTY_OUT_BACKLOG) {
+    tty_out_skipped = ttrue;
+    return ttrue;
+  }
+  if (tty_out_skipped) {
+    tty_out_skipped = tfalse;
+    DirtyVideo(0, 0, DisplayWidth - 1, DisplayHeight - 1);
+    ValidOldVideo = tfalse;
+  }
+  return tfalse;
+}
+
+/* open tty_out_fd on the same terminal as tty_fd */
+static void tty_out_Open(void) {
+  tty_out_fd = -1;
+  if (tty_name)
+    tty_out_fd = open(tty_name, O_WRONLY | O_NOCTTY | O_NONBLOCK);
+  if (tty_out_fd >= 0)
+    fcntl(tty_out_fd, F_SETFD, FD_CLOEXEC);
+  else
+    /* writes will block, as without the buffer */
+    tty_out_fd = tty_fd;
+}
+
+static void tty_out_Close(void) {
+  tty_out_Drain();
+  if (tty_out_fd >= 0 && tty_out_fd != tty_fd)
+    close(tty_out_fd);
+  tty_out_fd = -1;
+  if (tty_out_buf)
+    FreeMem(tty_out_buf);
+  tty_out_buf = NULL;
+  tty_out_len = tty_out_size = tty_out_frame = 0;
+}
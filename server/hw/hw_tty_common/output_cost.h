@@ -0,0 +1,83 @@
+
+/*
+ * byte costs of tty output, used by the termcap and linux drivers
+ * to choose the cheapest way to update the screen.
+ *
+ * the drivers track where the terminal cursor is in _cx, _cy (-1 if unknown)
+ * and before each run of changed cells they compare:
+ *   - an absolute cursor goto;
+ *   - a relative move (carriage return, cursor down, cursor right);
+ *   - rewriting the unchanged cells between the cursor and the run.
+ * inside the run, blank cells are sent as erase sequences (ECH, EL)
+ * and repeated cells as REP, when the terminal has them and they are shorter.
+ */
+
+/* unavailable sequence */
+#define TTY_NO_COST ((uldat)0x7FFFFFFF)
+
+/* guessed length of an SGR sequence changing colors */
+#define TTY_SGR_COST 6
+
+/* never rewrite more than this many unchanged cells just to move the cursor */
+#define TTY_REWRITE_MAX 16
+
+/* length of n written in decimal */
+INLINE uldat tty_DecLen(uldat n) {
+  uldat len = 1;
+  while (n >= 10)
+    n /= 10, len++;
+  return len;
+}
+
+/* bytes needed to send the character of V, without colors */
+INLINE uldat tty_RuneCost(tcell V) {
+  trune c = TRUNE(V);
+
+  if (c < 128 || !tty_use_utf8)
+    return 1;
+  return c <= 0x7FF ? 2 : c <= 0xFFFF ? 3 : 4;
+}
+
+/* bytes needed to send n cells of V[] when current colors are col */
+INLINE uldat tty_RewriteCost(CONST tcell *V, uldat n, tcolor col) {
+  uldat cost = 0;
+
+  for (; n; V++, n--) {
+    if (TCOLOR(*V) != col) {
+      col = TCOLOR(*V);
+      cost += TTY_SGR_COST;
+    }
+    cost += tty_RuneCost(*V);
+  }
+  return cost;
+}
+
+/* number of leading cells of V[0 ... n-1] equal to V[0] */
+INLINE uldat tty_SameCells(CONST tcell *V, uldat n) {
+  uldat i = 1;
+
+  while (i < n && V[i] == V[0])
+    i++;
+  return i;
+}
+
+/*
+ * return ttrue if V can be drawn by erasing: with back_color_erase
+ * the terminal fills erased cells with the current background,
+ * but not with blinking or bright backgrounds.
+ */
+INLINE byte tty_IsErasable(tcell V) {
+  return TRUNE(V) == ' ' && !(TCOLOR(V) & COL(0, HIGH));
+}
+
+/* return ttrue if V can be repeated with REP */
+INLINE byte tty_IsRepeatable(tcell V) {
+  trune c = TRUNE(V);
+  return c >= ' ' && c < 127;
+}
+
+/* after writing a cell, the cursor advances. at the right margin, its position is unknown */
+INLINE void tty_AdvanceCursor(uldat n) {
+  if (_cx >= 0 && (_cx += n) >= DisplayWidth)
+    _cx = _cy = -1;
+}
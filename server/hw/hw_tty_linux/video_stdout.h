@@ -20,11 +20,12 @@ static byte linux_CanDragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, d
 static void linux_DragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp);
 
 INLINE void linux_SetCursorType(uldat type) {
-  fprintf(stdOUT, "\033[?%d;%d;%dc", (int)(type & 0xFF), (int)((type >> 8) & 0xFF),
-          (int)((type >> 16) & 0xFF));
+  tty_printf("\033[?%d;%d;%dc", (int)(type & 0xFF), (int)((type >> 8) & 0xFF),
+             (int)((type >> 16) & 0xFF));
 }
 INLINE void linux_MoveToXY(udat x, udat y) {
-  fprintf(stdOUT, "\033[%d;%dH", y + 1, x + 1);
+  tty_printf("\033[%d;%dH", y + 1, x + 1);
+  _cx = x, _cy = y;
 }
 
 /* return tfalse if failed */
@@ -60,7 +61,7 @@ static byte linux_InitVideo(void) {
   }
   /* clear colors, enable/disable UTF-8 mode */
   /* if UTF-8 mode is disabled, set TTY_DISPCTRL */
-  fprintf(stdOUT, "\033[0m%s", (tty_use_utf8 ? "\033[3l\033%G" : "\033%@\033[3h"));
+  tty_printf("\033[0m%s", (tty_use_utf8 ? "\033[3l\033%G" : "\033%@\033[3h"));
 
   HW->FlushVideo = linux_FlushVideo;
   HW->FlushHW = stdout_FlushHW;
@@ -93,7 +94,7 @@ static byte linux_InitVideo(void) {
 
   HW->QuitVideo = linux_QuitVideo;
 
-  HW->FlagsHW |= FlHWNeedOldVideo;
+  HW->FlagsHW |= FlHWNeedOldVideo | FlHWThreadedFlushVideo;
   HW->FlagsHW &= ~FlHWExpensiveFlushVideo;
   HW->NeedHW = 0;
   HW->merge_Threshold = 0;
@@ -105,7 +106,7 @@ static void linux_QuitVideo(void) {
   linux_MoveToXY(0, DisplayHeight - 1);
   linux_SetCursorType(LINECURSOR);
   /* restore original colors, TTY_DISPCTRL, alt cursor keys, keypad settings */
-  fputs("\033[0m\033[3l\033[?1l\033>\n", stdOUT);
+  tty_puts("\033[0m\033[3l\033[?1l\033>\n");
 
   HW->QuitVideo = NoOp;
 }
@@ -117,8 +118,8 @@ static void linux_QuitVideo(void) {
  * for better results, reinit UTF-8 mode and TTY_DISPCTRL every time
  */
 #define linux_MogrifyInit()                                                                        \
-  (fputs(tty_use_utf8 ? "\033[3l\033%G\033[m" : "\033%@\033[3h\033[m", stdOUT),                    \
-   _col = COL(WHITE, BLACK))
+  (tty_puts(tty_use_utf8 ? "\033[3l\033%G\033[m" : "\033%@\033[3h\033[m"),                          \
+   _col = COL(WHITE, BLACK), _cx = _cy = -1)
 
 #define linux_MogrifyFinish() ((void)0)
 
@@ -160,59 +161,18 @@ INLINE void linux_SetColor(tcolor col) {
   *colp++ = 'm';
   *colp = '\0';
 
-  fputs(colbuf, stdOUT);
+  tty_puts(colbuf);
 }
 
-INLINE void linux_Mogrify(dat x, dat y, uldat len) {
-  tcell *V, *oV;
-  tcolor col;
-  trune c, _c;
-  byte sending = tfalse;
-
-  V = Video + x + y * (ldat)DisplayWidth;
-  oV = OldVideo + x + y * (ldat)DisplayWidth;
-
-  for (; len; V++, oV++, x++, len--) {
-    if (!ValidOldVideo || *V != *oV) {
-      if (!sending)
-        sending = ttrue, linux_MoveToXY(x, y);
-
-      col = TCOLOR(*V);
-
-      if (col != _col)
-        linux_SetColor(col);
-
-      c = _c = TRUNE(*V);
-      if (c >= 128) {
-        if (tty_use_utf8) {
-          /* use utf-8 to output this non-ASCII char. */
-          tty_MogrifyUTF8(c);
-          continue;
-        } else if (tty_charset_to_UTF_32[c] != c) {
-          c = tty_UTF_32_to_charset(_c);
-        }
-      }
-      if (tty_use_utf8 ? (c < 32 || c == 127)
-                       : (c < 32 && ((CTRL_ALWAYS >> c) & 1)) || c == 127 || c == 128 + 27) {
-        /* can't display it */
-        c = Tutf_UTF_32_to_ASCII(_c);
-        if (c < 32 || c >= 127)
-          c = 32;
-      }
-      putc((char)c, stdOUT);
-    } else
-      sending = tfalse;
-  }
-}
-
-INLINE void linux_SingleMogrify(dat x, dat y, tcell V) {
+/* send a single cell at current cursor position */
+INLINE void linux_PutTCell(tcell V) {
   trune c, _c;
 
-  linux_MoveToXY(x, y);
-
   if (TCOLOR(V) != _col)
     linux_SetColor(TCOLOR(V));
 
+  tty_AdvanceCursor(1);
+
   c = _c = TRUNE(V);
   if (c >= 128) {
     if (tty_use_utf8) {
@@ -230,7 +190,130 @@ INLINE void linux_SingleMogrify(dat x, dat y, tcell V) {
     if (c < 32 || c >= 127)
       c = 32;
   }
-  putc((char)c, stdOUT);
+  tty_putc((char)c);
+}
+
+/* ESC [ <n> C */
+INLINE uldat linux_RightCost(dat n) {
+  return n == 1 ? 3 : 3 + tty_DecLen(n);
+}
+
+INLINE void linux_Right(dat n) {
+  if (n == 1)
+    tty_puts("\033[C");
+  else
+    tty_printf("\033[%dC", (int)n);
+  _cx += n;
+}
+
+/* move the cursor to (x, y) with the shortest sequence we know of */
+static void linux_GotoXY(dat x, dat y) {
+  uldat cost, best;
+  enum { by_goto, by_rewrite, by_right, by_newline } how = by_goto;
+
+  if (_cx == x && _cy == y)
+    return;
+
+  /* ESC [ <y> ; <x> H */
+  best = 4 + tty_DecLen(y + 1) + tty_DecLen(x + 1);
+
+  if (_cy == y && _cx >= 0 && _cx < x) {
+    /* the cells in between are already on screen, so rewriting them is always correct */
+    if (x - _cx <= TTY_REWRITE_MAX &&
+        (cost = tty_RewriteCost(Video + _cx + y * (ldat)DisplayWidth, x - _cx, _col)) < best)
+      best = cost, how = by_rewrite;
+    if ((cost = linux_RightCost(x - _cx)) < best)
+      best = cost, how = by_right;
+  }
+  if (_cy >= 0 && (_cy == y || _cy + 1 == y)) {
+    /* carriage return, maybe line feed, maybe cursor right */
+    cost = 1 + (_cy != y) + (x ? linux_RightCost(x) : 0);
+    if (cost < best)
+      best = cost, how = by_newline;
+  }
+
+  switch (how) {
+  case by_rewrite:
+    for (cost = x - _cx; cost; cost--)
+      linux_PutTCell(Video[_cx + y * (ldat)DisplayWidth]);
+    break;
+  case by_right:
+    linux_Right(x - _cx);
+    break;
+  case by_newline:
+    tty_puts(_cy != y ? "\r\n" : "\r");
+    _cx = 0, _cy = y;
+    if (x)
+      linux_Right(x);
+    break;
+  default:
+    linux_MoveToXY(x, y);
+    break;
+  }
+}
+
+/*
+ * send the run V[0 ... run-1] of changed cells that goes at (x, y).
+ * both the linux console and twin terminals erase with the current background,
+ * so blanks can be sent as ECH, or as EL if the rest of the row is blank too.
+ * return the number of cells of the row (starting at x) that are now up to date.
+ */
+static uldat linux_PutRun(CONST tcell *V, dat x, dat y, uldat run) {
+  uldat n, i, tail = DisplayWidth - x;
+  CONST tcell *V0 = V;
+
+  while (run) {
+    linux_GotoXY(x, y);
+    n = tty_SameCells(V, run);
+
+    if (n > 3 && tty_IsErasable(*V)) {
+      if (TCOLOR(*V) != _col)
+        linux_SetColor(TCOLOR(*V));
+      if (tty_SameCells(V, tail) == tail) {
+        tty_puts("\033[K");
+        return (V - V0) + tail;
+      }
+      if (3 + tty_DecLen(n) + linux_RightCost(n) < n) {
+        tty_printf("\033[%dX", (int)n);
+        /* ECH does not move the cursor */
+        V += n, x += n, run -= n, tail -= n;
+        continue;
+      }
+    }
+    for (i = n; i; i--)
+      linux_PutTCell(*V);
+    V += n, x += n, run -= n, tail -= n;
+  }
+  return V - V0;
+}
+
+INLINE void linux_Mogrify(dat x, dat y, uldat len) {
+  uldat skip, run;
+  tcell *V, *oV;
+
+  V = Video + x + y * (ldat)DisplayWidth;
+  oV = OldVideo + x + y * (ldat)DisplayWidth;
+
+  while (len) {
+    run = DiffRunTCell(V, oV, len, &skip);
+    V += skip, oV += skip, x += skip, len -= skip;
+
+    if (run) {
+      run = linux_PutRun(V, x, y, run);
+      if (run > len) {
+        /* EL cleared the whole row: remember it, or later spans would draw it again */
+        if (ValidOldVideo)
+          CopyMem(V + len, oV + len, (run - len) * sizeof(tcell));
+        run = len;
+      }
+      V += run, oV += run, x += run, len -= run;
+    }
+  }
+}
+
+INLINE void linux_SingleMogrify(dat x, dat y, tcell V) {
+  linux_MoveToXY(x, y);
+  linux_PutTCell(V);
 }
 
 /* HideMouse and ShowMouse depend on Video setup, not on Mouse.
@@ -289,10 +372,13 @@ static void linux_UpdateMouseAndCursor(void) {
 }
 
 static void linux_FlushVideo(void) {
-  dat i, j, start, end, XY[2];
+  dat i, j, k, start, end, XY[2];
   byte FlippedVideo = tfalse, FlippedOldVideo = tfalse;
   tcell savedOldVideo;
 
+  if (tty_out_SkipFrame())
+    return;
+
   if (!ChangedVideoFlag) {
     HW->UpdateMouseAndCursor();
     linux_MogrifyFinish();
@@ -336,13 +422,14 @@ static void linux_FlushVideo(void) {
   }
 
   linux_MogrifyInit();
-  for (i = 0; i < DisplayHeight * 2; i++) {
-    start = ChangedVideo[i >> 1][i & 1][0];
-    end = ChangedVideo[i >> 1][i & 1][1];
+  for (i = 0; i < DisplayHeight; i++) {
+    for (k = 0; k < ChangedVideo[i].N; k++) {
+      start = ChangedVideo[i].Span[k][0];
+      end = ChangedVideo[i].Span[k][1];
 
-    if (start != -1)
       /* also keep track of cursor position */
-      linux_Mogrify(start, XY[1] = i >> 1, (XY[0] = end) - start + 1);
+      linux_Mogrify(start, XY[1] = i, (XY[0] = end) - start + 1);
+    }
   }
 
   /* store current cursor state for correct updating */
@@ -370,18 +457,18 @@ static void linux_FlushVideo(void) {
 }
 
 static void linux_Beep(void) {
-  fputs("\033[3l\007\033[3h", stdOUT);
+  tty_puts("\033[3l\007\033[3h");
   setFlush();
 }
 
 static void linux_ConfigureKeyboard(udat resource, byte todefault, udat value) {
   switch (resource) {
   case HW_KBDAPPLIC:
-    fputs(todefault || !value ? "\033>" : "\033=", stdOUT);
+    tty_puts(todefault || !value ? "\033>" : "\033=");
     setFlush();
     break;
   case HW_ALTCURSKEYS:
-    fputs(todefault || !value ? "\033[?1l" : "\033[?1h", stdOUT);
+    tty_puts(todefault || !value ? "\033[?1l" : "\033[?1h");
     setFlush();
     break;
   }
@@ -395,16 +482,16 @@ static void linux_Configure(udat resource, byte todefault, udat value) {
     break;
   case HW_BELLPITCH:
     if (todefault)
-      fputs("\033[10]", stdOUT);
+      tty_puts("\033[10]");
     else
-      fprintf(stdOUT, "\033[10;%hd]", value);
+      tty_printf("\033[10;%hd]", value);
     setFlush();
     break;
   case HW_BELLDURATION:
     if (todefault)
-      fputs("\033[11]", stdOUT);
+      tty_puts("\033[11]");
     else
-      fprintf(stdOUT, "\033[11;%hd]", value);
+      tty_printf("\033[11;%hd]", value);
     setFlush();
     break;
   case HW_MOUSEMOTIONEVENTS:
@@ -416,12 +503,12 @@ static void linux_Configure(udat resource, byte todefault, udat value) {
 }
 
 static void linux_SetPalette(udat N, udat R, udat G, udat B) {
-  fprintf(stdOUT, "\033]P%1hx%02hx%02hx%02hx", N, R, G, B);
+  tty_printf("\033]P%1hx%02hx%02hx%02hx", N, R, G, B);
   setFlush();
 }
 
 static void linux_ResetPalette(void) {
-  fputs("\033]R", stdOUT);
+  tty_puts("\033]R");
   setFlush();
 }
 
@@ -441,16 +528,16 @@ static void linux_DragArea(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat
   HW->HideMouse();
   HW->FlagsHW |= FlHWChangedMouseFlag;
 
-  fprintf(stdOUT, "%s\033[m\033[%d;1H", /* hide cursor, reset color, go to last line */
-          HW->TT == NOCURSOR ? "" : "\033[?1c", HW->Y);
+  tty_printf("%s\033[m\033[%d;1H", /* hide cursor, reset color, go to last line */
+             HW->TT == NOCURSOR ? "" : "\033[?1c", HW->Y);
 
   while (delta--)
-    putc('\n', stdOUT);
+    tty_putc('\n');
 
   if (HW->FlushVideo == linux_FlushVideo)
     setFlush();
   else
-    fflush(stdOUT);
+    tty_out_Drain();
 
   /* store actual cursor state for correct updating */
   HW->XY[0] = 0;
@@ -19,6 +19,7 @@
 #include "hw.h"
 #include "hw_private.h"
 #include "hw_dirty.h"
+#include "hw_diff.h"
 #include "common.h"
 
 #include <Tw/Tw.h>
@@ -188,42 +189,35 @@ static void TW_KeyboardEvent(int fd, display_hw hw) {
 
 INLINE void TW_Mogrify(dat x, dat y, uldat len) {
   tcell *V, *oV;
-  uldat buflen = 0;
-  tcell *buf;
-  dat xbegin = x, ybegin = y;
+  uldat skip, run;
 
   V = Video + x + y * (ldat)DisplayWidth;
   oV = OldVideo + x + y * (ldat)DisplayWidth;
 
-  for (; len; x++, V++, oV++, len--) {
-    if (buflen && ValidOldVideo && *V == *oV) {
-      Tw_WriteTCellWindow(Td, Twin, xbegin, ybegin, buflen, buf);
-      buflen = 0;
-    }
-    if (!ValidOldVideo || *V != *oV) {
-      if (!buflen++) {
-        xbegin = x;
-        ybegin = y;
-        buf = V;
-      }
+  while (len) {
+    run = DiffRunTCell(V, oV, len, &skip);
+    V += skip, oV += skip, x += skip, len -= skip;
+
+    if (run) {
+      Tw_WriteTCellWindow(Td, Twin, x, y, run, V);
+      V += run, oV += run, x += run, len -= run;
     }
   }
-  if (buflen)
-    Tw_WriteTCellWindow(Td, Twin, xbegin, ybegin, buflen, buf);
 }
 
 static void TW_FlushVideo(void) {
-  dat start, end;
+  dat k, start, end;
   udat i;
 
   /* first burst all changes */
   if (ChangedVideoFlag) {
-    for (i = 0; i < DisplayHeight * 2; i++) {
-      start = ChangedVideo[i >> 1][i & 1][0];
-      end = ChangedVideo[i >> 1][i & 1][1];
+    for (i = 0; i < DisplayHeight; i++) {
+      for (k = 0; k < ChangedVideo[i].N; k++) {
+        start = ChangedVideo[i].Span[k][0];
+        end = ChangedVideo[i].Span[k][1];
 
-      if (start != -1)
-        TW_Mogrify(start, i >> 1, end - start + 1);
+        TW_Mogrify(start, i, end - start + 1);
+      }
     }
     setFlush();
   }
@@ -8,6 +8,7 @@ static tcolor _col;
 INLINE void X11_Mogrify(dat x, dat y, ldat len) {
   tcell *V, *oV;
   tcolor col;
+  uldat skip, run;
   udat buflen = 0;
   trune f;
   XChar16 buf[TW_SMALLBUFF];
@@ -35,13 +36,16 @@ INLINE void X11_Mogrify(dat x, dat y, ldat len) {
   V = Video + x + y * (ldat)DisplayWidth;
   oV = OldVideo + x + y * (ldat)DisplayWidth;
 
-  for (_col = ~TCOLOR(*V); len; x++, V++, oV++, len--) {
-    col = TCOLOR(*V);
-    if (buflen && (col != _col || (ValidOldVideo && *V == *oV) || buflen == TW_SMALLBUFF)) {
-      XDRAW(_col, buf, buflen);
-      buflen = 0;
-    }
-    if (!ValidOldVideo || *V != *oV) {
+  while (len) {
+    run = DiffRunTCell(V, oV, len, &skip);
+    V += skip, oV += skip, x += skip, len -= skip;
+
+    for (len -= run; run; x++, V++, oV++, run--) {
+      col = TCOLOR(*V);
+      if (buflen && (col != _col || buflen == TW_SMALLBUFF)) {
+        XDRAW(_col, buf, buflen);
+        buflen = 0;
+      }
       if (!buflen) {
         xbegin = (x - xhw_startx) * (ldat)xwfont;
         _col = col;
@@ -49,10 +53,10 @@ INLINE void X11_Mogrify(dat x, dat y, ldat len) {
       f = xUTF_32_to_charset(TRUNE(*V));
       buf[buflen++] = RawToXChar16(f);
     }
-  }
-  if (buflen) {
-    XDRAW(_col, buf, buflen);
-    buflen = 0;
+    if (buflen) {
+      XDRAW(_col, buf, buflen);
+      buflen = 0;
+    }
   }
 }
 
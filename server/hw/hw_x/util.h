@@ -95,7 +95,7 @@ static void X11_ShowCursor(uldat type, dat x, dat y) {
 
 static void X11_FlushVideo(void) {
   uldat i;
-  dat start, end;
+  dat k, start, end;
   byte iff;
 
   if (ValidOldVideo) {
@@ -106,12 +106,13 @@ static void X11_FlushVideo(void) {
 
   /* first burst all changes */
   if (ChangedVideoFlag) {
-    for (i = 0; i < (uldat)DisplayHeight * 2; i++) {
-      start = ChangedVideo[i >> 1][i & 1][0];
-      end = ChangedVideo[i >> 1][i & 1][1];
+    for (i = 0; i < (uldat)DisplayHeight; i++) {
+      for (k = 0; k < ChangedVideo[i].N; k++) {
+        start = ChangedVideo[i].Span[k][0];
+        end = ChangedVideo[i].Span[k][1];
 
-      if (start != -1)
-        X11_Mogrify(start, i >> 1, end - start + 1);
+        X11_Mogrify(start, i, end - start + 1);
+      }
     }
     setFlush();
   }
@@ -0,0 +1,156 @@
+/*
+ *  hw_diff.h  --  compare Video[] against OldVideo[]
+ *
+ *  Copyright (C) 2000-2020 by Massimiliano Ghilardi
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ */
+
+#ifndef _TWIN_HW_DIFF_H
+#define _TWIN_HW_DIFF_H
+
+/*
+ * small kernels used by FlushHW() and by the display drivers' FlushVideo()
+ * to find which cells of a span really changed.
+ *
+ * DiffSameTCell()     returns the number of leading cells where V[] == oV[]
+ * DiffChangedTCell()  returns the number of leading cells where V[] != oV[]
+ * DiffSameTCellBack() returns the number of trailing cells where V[] == oV[]
+ *
+ * i.e. a span can be trimmed with DiffSameTCell() + DiffSameTCellBack()
+ * and walked as alternating runs of DiffSameTCell() and DiffChangedTCell().
+ *
+ * SSE2 or AVX2 are used if the compiler targets them, otherwise plain C.
+ */
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define TW_DIFF_AVX2
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define TW_DIFF_SSE2
+#endif
+
+#if defined(TW_DIFF_AVX2)
+
+/* 8 cells per step. each cell sets 4 bits in the mask returned by DiffMask */
+#define DIFF_STEP 8
+#define DIFF_ALL 0xFFFFFFFFu
+typedef unsigned int diff_mask;
+
+INLINE diff_mask DiffMask(CONST tcell *V, CONST tcell *oV) {
+  __m256i a = _mm256_loadu_si256((CONST __m256i *)V);
+  __m256i b = _mm256_loadu_si256((CONST __m256i *)oV);
+  return (diff_mask)_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b));
+}
+
+#elif defined(TW_DIFF_SSE2)
+
+/* 4 cells per step. each cell sets 4 bits in the mask returned by DiffMask */
+#define DIFF_STEP 4
+#define DIFF_ALL 0xFFFFu
+typedef unsigned int diff_mask;
+
+INLINE diff_mask DiffMask(CONST tcell *V, CONST tcell *oV) {
+  __m128i a = _mm_loadu_si128((CONST __m128i *)V);
+  __m128i b = _mm_loadu_si128((CONST __m128i *)oV);
+  return (diff_mask)_mm_movemask_epi8(_mm_cmpeq_epi32(a, b));
+}
+
+#endif
+
+#ifdef DIFF_STEP
+
+/* the vector kernels compare 32-bit lanes */
+#define DIFF_VECTOR (sizeof(tcell) == 4)
+
+INLINE uldat DiffSameTCell(CONST tcell *V, CONST tcell *oV, uldat len) {
+  uldat i = 0;
+  diff_mask m;
+
+  if (DIFF_VECTOR) {
+    for (; i + DIFF_STEP <= len; i += DIFF_STEP) {
+      if ((m = DiffMask(V + i, oV + i)) != DIFF_ALL)
+        return i + (__builtin_ctz(~m) >> 2);
+    }
+  }
+  while (i < len && V[i] == oV[i])
+    i++;
+  return i;
+}
+
+INLINE uldat DiffChangedTCell(CONST tcell *V, CONST tcell *oV, uldat len) {
+  uldat i = 0;
+  diff_mask m;
+
+  if (DIFF_VECTOR) {
+    for (; i + DIFF_STEP <= len; i += DIFF_STEP) {
+      if ((m = DiffMask(V + i, oV + i)) != 0)
+        return i + (__builtin_ctz(m) >> 2);
+    }
+  }
+  while (i < len && V[i] != oV[i])
+    i++;
+  return i;
+}
+
+INLINE uldat DiffSameTCellBack(CONST tcell *V, CONST tcell *oV, uldat len) {
+  uldat i = len;
+  diff_mask m;
+
+  if (DIFF_VECTOR) {
+    for (; i >= DIFF_STEP; i -= DIFF_STEP) {
+      if ((m = DiffMask(V + i - DIFF_STEP, oV + i - DIFF_STEP)) != DIFF_ALL)
+        /* index of the highest differing cell inside this step */
+        return len - i + DIFF_STEP - 1 - ((31 - __builtin_clz(~m & DIFF_ALL)) >> 2);
+    }
+  }
+  while (i && V[i - 1] == oV[i - 1])
+    i--;
+  return len - i;
+}
+
+#else /* !DIFF_STEP */
+
+INLINE uldat DiffSameTCell(CONST tcell *V, CONST tcell *oV, uldat len) {
+  uldat i = 0;
+  while (i < len && V[i] == oV[i])
+    i++;
+  return i;
+}
+
+INLINE uldat DiffChangedTCell(CONST tcell *V, CONST tcell *oV, uldat len) {
+  uldat i = 0;
+  while (i < len && V[i] != oV[i])
+    i++;
+  return i;
+}
+
+INLINE uldat DiffSameTCellBack(CONST tcell *V, CONST tcell *oV, uldat len) {
+  uldat i = len;
+  while (i && V[i - 1] == oV[i - 1])
+    i--;
+  return len - i;
+}
+
+#endif /* DIFF_STEP */
+
+/*
+ * return the length of the next run of cells to send starting at V[0]:
+ * the leading unchanged cells are skipped, and their number stored in *skip.
+ * if OldVideo[] is not valid, the whole span must be sent.
+ */
+INLINE uldat DiffRunTCell(CONST tcell *V, CONST tcell *oV, uldat len, uldat *skip) {
+  if (!ValidOldVideo) {
+    *skip = 0;
+    return len;
+  }
+  *skip = DiffSameTCell(V, oV, len);
+  return DiffChangedTCell(V + *skip, oV + *skip, len - *skip);
+}
+
+#endif /* _TWIN_HW_DIFF_H */
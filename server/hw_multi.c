@@ -14,6 +14,7 @@
 #include "twautoconf.h"
 
 #include <stdio.h>
+#include <signal.h>
 
 #ifdef TW_HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
@@ -21,6 +22,12 @@
 #ifdef TW_HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
+#ifdef TW_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef TW_HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
 
 #include "twin.h"
 #include "alloc.h"
@@ -35,6 +42,7 @@
 #include "dl.h"
 #include "hw.h"
 #include "hw_private.h"
+#include "hw_diff.h"
 #include "hw_multi.h"
 #include "printk.h"
 #include "resize.h"
@@ -42,25 +50,58 @@
 
 #include <Tw/Tw.h>
 
-#define forHW for (HW = All->FirstDisplayHW; HW; HW = HW->Next)
+#ifdef HAVE_THREAD_LOCAL
+#include <pthread.h>
+
+/* the worker thread of a display and its frame, see FlushVideoHW() */
+struct s_frame_thread {
+  pthread_t Thread;
+  pthread_mutex_t Mutex;
+  pthread_cond_t Cond;
+  byte Published;                /* main thread only: a frame was handed over, not finished yet */
+  byte Busy, Done, Quit, doBeep; /* protected by Mutex */
+  dat Width, Height;             /* size of Video[] snapshot */
+  tcell *Video;
+  dirty_row *ChangedVideo;
+  byte ChangedVideoFlag, ValidOldVideo, QueuedFullScreen;
+  dat CursorX, CursorY;
+  uldat CursorType;
+};
+
+typedef struct s_frame_thread *frame_thread;
+
+/* ttrue if hw has a frame in flight on its worker thread */
+#define FrameBusyHW(hw) ((hw)->FrameThread && (hw)->FrameThread->Published)
+#else
+#define FrameBusyHW(hw) tfalse
+#endif
+
+/* these wait for the worker thread of each display, if any, to finish its frame */
+#define forHW for (HW = All->FirstDisplayHW; HW && (SyncFrameHW(HW), ttrue); HW = HW->Next)
 
 #define safeforHW(s_HW)                                                                            \
-  for (HW = All->FirstDisplayHW; HW && (((s_HW) = HW->Next), ttrue); HW = (s_HW))
+  for (HW = All->FirstDisplayHW; HW && (((s_HW) = HW->Next), SyncFrameHW(HW), ttrue);              \
+       HW = (s_HW))
 
-/* common data */
+/* this does not: only for code that knows how to handle displays with a frame in flight */
+#define forHWNoSync for (HW = All->FirstDisplayHW; HW; HW = HW->Next)
 
-static dat (*saveChangedVideo)[2][2];
+/* common data */
 
 static dat savedDisplayWidth = 100, savedDisplayHeight = 30;
 static dat TryDisplayWidth, TryDisplayHeight;
 
 static dat AccelVideo[4] = {TW_MAXDAT, TW_MAXDAT, TW_MINDAT, TW_MINDAT};
 byte StrategyFlag;
-tany StrategyDelay = (tany)0;
+
+/* last time the user typed or moved the mouse on any display */
+static timevalue InputTime;
 
 static udat ConfigureHWValue[HW_CONFIGURE_MAX];
 static byte ConfigureHWDefault[HW_CONFIGURE_MAX];
 
+static void StopFrameThreadHW(display_hw D_HW);
+
 /* common functions */
 
 dat GetDisplayWidth(void) {
@@ -264,6 +305,7 @@ void QuitDisplayHW(display_hw D_HW) {
   SaveHW;
 
   if (D_HW) {
+    StopFrameThreadHW(D_HW);
     if (D_HW->QuitHW)
       HW = D_HW, D_HW->QuitHW();
 
@@ -396,6 +438,10 @@ byte InitHW(void) {
       flag_secure = ttrue;
     else if (!strcmp(arg, "-envrc"))
       flag_envrc = ttrue;
+    else if (!strncmp(arg, "-backstore=", 11))
+      BackStoreMax = (uldat)strtoul(arg + 11, NULL, 10) << 10;
+    else if (!strncmp(arg, "-drawthreads=", 13))
+      DrawThreads = (udat)Min2(strtoul(arg + 13, NULL, 10), DRAWTHREADS_MAX);
     else if (!strncmp(arg, "-hw=", 4))
       hwcount++;
     else
@@ -505,6 +551,37 @@ void ResizeDisplayPrefer(display_hw D_HW) {
   RestoreHW;
 }
 
+/*
+ * (re)allocate the OldVideo[] and ChangedVideo[] of a single display
+ * to match DisplayWidth and DisplayHeight. they start fully dirty.
+ */
+static void ResizeVideoHW(display_hw D_HW) {
+  ldat i;
+
+  if (!(D_HW->FlagsHW & FlHWNeedOldVideo) && D_HW->OldVideo) {
+    FreeMem(D_HW->OldVideo);
+    D_HW->OldVideo = NULL;
+  } else if ((D_HW->FlagsHW & FlHWNeedOldVideo) &&
+             !(D_HW->OldVideo = (tcell *)ReAllocMem(D_HW->OldVideo, (ldat)DisplayWidth *
+                                                                        DisplayHeight *
+                                                                        sizeof(tcell)))) {
+    printk("twin: out of memory!\n");
+    Quit(1);
+  }
+  if (!(D_HW->ChangedVideo = (dirty_row *)ReAllocMem(D_HW->ChangedVideo,
+                                                     (ldat)DisplayHeight * sizeof(dirty_row)))) {
+    printk("twin: out of memory!\n");
+    Quit(1);
+  }
+  for (i = 0; i < (ldat)DisplayHeight; i++) {
+    D_HW->ChangedVideo[i].N = 1;
+    D_HW->ChangedVideo[i].Span[0][0] = 0;
+    D_HW->ChangedVideo[i].Span[0][1] = DisplayWidth - 1;
+  }
+  D_HW->ChangedVideoFlag = ttrue;
+  D_HW->ValidOldVideo = tfalse;
+}
+
 /*
  * return ttrue if DisplayWidth or DisplayHeight were changed
  */
@@ -556,32 +633,23 @@ byte ResizeDisplay(void) {
 
   change = DisplayWidth != TryDisplayWidth || DisplayHeight != TryDisplayHeight;
 
-  if (!NeedOldVideo && OldVideo) {
-    FreeMem(OldVideo);
-    OldVideo = NULL;
-  } else if ((NeedOldVideo && !OldVideo) || change) {
-    if (!(OldVideo = (tcell *)ReAllocMem(OldVideo, (ldat)TryDisplayWidth * TryDisplayHeight *
-                                                       sizeof(tcell)))) {
-      printk("twin: out of memory!\n");
-      Quit(1);
-    }
-    ValidOldVideo = tfalse;
-  }
-
   if (!Video || change) {
     All->DisplayWidth = DisplayWidth = TryDisplayWidth;
     All->DisplayHeight = DisplayHeight = TryDisplayHeight;
 
     if (!(Video = (tcell *)ReAllocMem(Video, (ldat)DisplayWidth * DisplayHeight * sizeof(tcell))) ||
-        !(ChangedVideo =
-              (dat(*)[2][2])ReAllocMem(ChangedVideo, (ldat)DisplayHeight * sizeof(dat) * 4)) ||
-        !(saveChangedVideo =
-              (dat(*)[2][2])ReAllocMem(saveChangedVideo, (ldat)DisplayHeight * sizeof(dat) * 4))) {
+        !(ChangedVideo = (dirty_row *)ReAllocMem(ChangedVideo,
+                                                 (ldat)DisplayHeight * sizeof(dirty_row)))) {
 
       printk("twin: out of memory!\n");
       Quit(1);
     }
-    memset(ChangedVideo, 0xff, (ldat)DisplayHeight * sizeof(dat) * 4);
+    memset(ChangedVideo, 0, (ldat)DisplayHeight * sizeof(dirty_row));
+  }
+
+  forHW {
+    if (change || !HW->ChangedVideo)
+      ResizeVideoHW(HW);
   }
   NeedHW &= ~NEEDResizeDisplay;
 
@@ -754,6 +822,7 @@ void SelectionExport(void) {
 
 void SelectionImport(void) {
   if ((HW = All->MouseHW)) {
+    SyncFrameHW(HW);
     if (HW->HWSelectionImport())
       All->Selection->OwnerOnce = HW;
     else
@@ -763,15 +832,15 @@ void SelectionImport(void) {
 
 INLINE void DiscardBlinkVideo(void) {
   ldat i;
+  dat k;
   uldat start, len;
   tcell *V;
 
-  for (i = 0; i < (ldat)DisplayHeight * 2; i++) {
-    start = (uldat)ChangedVideo[i >> 1][i & 1][0];
-
-    if (start != (uldat)-1) {
-      len = (uldat)ChangedVideo[i >> 1][i & 1][1] + 1 - start;
-      start += (i >> 1) * (ldat)DisplayWidth;
+  for (i = 0; i < (ldat)DisplayHeight; i++) {
+    for (k = 0; k < ChangedVideo[i].N; k++) {
+      start = (uldat)ChangedVideo[i].Span[k][0];
+      len = (uldat)ChangedVideo[i].Span[k][1] + 1 - start;
+      start += i * (ldat)DisplayWidth;
 
       for (V = &Video[start]; len; V++, len--)
         *V &= ~TCELL(COL(0, HIGH), (byte)0);
@@ -779,82 +848,751 @@ INLINE void DiscardBlinkVideo(void) {
   }
 }
 
+/* shrink each dirty span to the cells that really differ from OldVideo[], dropping clean ones */
 INLINE void OptimizeChangedVideo(void) {
-  uldat _start, start, _end, end;
+  uldat start, len, skip, base;
   ldat i;
+  dat k, n;
+  dat(*S)[2];
 
   ChangedVideoFlag = tfalse;
 
-  for (i = 0; i < (ldat)DisplayHeight * 2; i++) {
-    start = (uldat)ChangedVideo[i >> 1][!(i & 1)][0];
-
-    if (start != (uldat)-1) {
-
-      start += (i >> 1) * (ldat)DisplayWidth;
-      _start = start;
-
-      _end = end = (uldat)ChangedVideo[i >> 1][!(i & 1)][1] + (i >> 1) * (ldat)DisplayWidth;
-
-      while (start <= end && Video[start] == OldVideo[start])
-        start++;
-      while (start <= end && Video[end] == OldVideo[end])
-        end--;
-
-      if (start > end) {
-        if (i & 1) {
-          /*
-           * this is the first area, to make it empty
-           * copy the second on this.
-           */
-          if (ChangedVideo[i >> 1][1][0] != -1) {
-            ChangedVideo[i >> 1][0][0] = ChangedVideo[i >> 1][1][0];
-            ChangedVideo[i >> 1][0][1] = ChangedVideo[i >> 1][1][1];
-            ChangedVideo[i >> 1][1][0] = -1;
-          } else
-            ChangedVideo[i >> 1][0][0] = -1;
-        } else
-          ChangedVideo[i >> 1][1][0] = -1;
-        continue;
-      } else {
-        ChangedVideoFlag = ttrue;
-        if (start > _start)
-          ChangedVideo[i >> 1][!(i & 1)][0] += start - _start;
-        if (end < _end)
-          ChangedVideo[i >> 1][!(i & 1)][1] -= _end - end;
+  for (i = 0; i < (ldat)DisplayHeight; i++) {
+    S = ChangedVideo[i].Span;
+    base = i * (ldat)DisplayWidth;
+
+    for (k = n = 0; k < ChangedVideo[i].N; k++) {
+      start = S[k][0] + base;
+      len = S[k][1] - S[k][0] + 1;
+
+      skip = DiffSameTCell(Video + start, OldVideo + start, len);
+      if (skip < len) {
+        start += skip;
+        len -= skip;
+        len -= DiffSameTCellBack(Video + start, OldVideo + start, len);
+        S[n][0] = start - base;
+        S[n][1] = start - base + len - 1;
+        n++;
       }
     }
+    if ((ChangedVideo[i].N = n) != 0)
+      ChangedVideoFlag = ttrue;
   }
 }
 
 INLINE void SyncOldVideo(void) {
   ldat start, len;
   ldat i;
+  dat k;
 
-  for (i = 0; i < (ldat)DisplayHeight * 2; i++) {
-    start = ChangedVideo[i >> 1][i & 1][0];
+  for (i = 0; i < (ldat)DisplayHeight; i++) {
+    for (k = 0; k < ChangedVideo[i].N; k++) {
+      start = ChangedVideo[i].Span[k][0];
+      len = ChangedVideo[i].Span[k][1] + 1 - start;
+      start += i * (ldat)DisplayWidth;
 
-    if (start != -1) {
-      len = ChangedVideo[i >> 1][i & 1][1] + 1 - start;
-      start += (i >> 1) * (ldat)DisplayWidth;
+      CopyMem(Video + start, OldVideo + start, len * sizeof(tcell));
+    }
+    ChangedVideo[i].N = 0;
+  }
+}
 
-      ChangedVideo[i >> 1][i & 1][0] = -1;
+/* mark an area of OldVideo[] as not matching the display, forcing it to be redrawn */
+static void InvalidateOldVideo(dat Xstart, dat Ystart, dat Xend, dat Yend) {
+  tcell *V, *oV;
+  udat xc, yc, _xc;
 
-      CopyMem(Video + start, OldVideo + start, len * sizeof(tcell));
+  if (Xstart > Xend || Xstart >= DisplayWidth || Xend < 0 || Ystart > Yend ||
+      Ystart >= DisplayHeight || Yend < 0)
+    return;
+  Xstart = Max2(Xstart, 0);
+  Ystart = Max2(Ystart, 0);
+  Xend = Min2(Xend, DisplayWidth - 1);
+  Yend = Min2(Yend, DisplayHeight - 1);
+
+  yc = Yend - Ystart + 1;
+  _xc = Xend - Xstart + 1;
+  V = Video + Xstart + Ystart * (ldat)DisplayWidth;
+  oV = OldVideo + Xstart + Ystart * (ldat)DisplayWidth;
+
+  while (yc--) {
+    for (xc = 0; xc < _xc; xc++)
+      oV[xc] = ~V[xc];
+    V += DisplayWidth;
+    oV += DisplayWidth;
+  }
+}
+
+/*
+ * automatic scroll detection.
+ *
+ * when a whole block of rows moved up or down (a terminal scrolling, a client redrawing
+ * a window after scrolling its contents) the dirty area is usually large, but most of it
+ * is already on the display, just at a different row: find the vertical shift between
+ * OldVideo[] and Video[] with per-row hashes and let the display drag it with HW->DragArea().
+ * OptimizeChangedVideo() then drops the rows that became clean.
+ */
+
+/* do not bother for blocks of less than this many rows */
+#define SCROLL_MIN_ROWS 3
+/* guessed cost of starting a new run of changed cells, i.e. of moving the cursor */
+#define SCROLL_RUN_COST 8
+/* do not bother for less than this many cells saved */
+#define SCROLL_MIN_GAIN 16
+
+/* per thread, as frames may be sent by worker threads */
+static THREAD_LOCAL uldat *ScrollHash; /* row hashes: Video[] rows, then OldVideo[] rows */
+static THREAD_LOCAL udat *ScrollVote;  /* votes for each shift, indexed by shift + Height */
+static THREAD_LOCAL ldat ScrollHashLen;
+
+INLINE uldat HashTCellRow(CONST tcell *V, dat len) {
+  uldat h = 0;
+  while (len--)
+    h = (h << 5) + h + *V++;
+  return h;
+}
+
+INLINE byte SameTCellRow(CONST tcell *V, CONST tcell *oV, dat len) {
+  return !memcmp(V, oV, len * sizeof(tcell));
+}
+
+/* rough cost of repainting the cells of V[] that differ from oV[] */
+static ldat CostTCellRow(CONST tcell *V, CONST tcell *oV, uldat len) {
+  uldat skip, run;
+  ldat cost = 0;
+
+  while (len) {
+    skip = DiffSameTCell(V, oV, len);
+    V += skip, oV += skip, len -= skip;
+    if (!len)
+      break;
+    run = DiffChangedTCell(V, oV, len);
+    V += run, oV += run, len -= run;
+    cost += run + SCROLL_RUN_COST;
+  }
+  return cost;
+}
+
+/*
+ * return ttrue if dragging rows DstUp + Shift ... DstDwn + Shift to DstUp ... DstDwn
+ * is cheaper than repainting them. the display also loses rows LostUp ... LostDwn
+ * (none if LostUp > LostDwn), like a tty blanking the bottom of the screen.
+ */
+static byte ScrollGain(dat Left, dat Rgt, dat DstUp, dat DstDwn, dat Shift, dat LostUp,
+                       dat LostDwn) {
+  ldat base, gain = 0, len = Rgt - Left + 1;
+  dat y;
+
+  for (y = DstUp; y <= DstDwn; y++) {
+    base = Left + y * (ldat)DisplayWidth;
+    gain += CostTCellRow(Video + base, OldVideo + base, len);
+    gain -= CostTCellRow(Video + base, OldVideo + base + Shift * (ldat)DisplayWidth, len);
+  }
+  for (y = LostUp; y <= LostDwn; y++) {
+    base = Left + y * (ldat)DisplayWidth;
+    gain += CostTCellRow(Video + base, OldVideo + base, len);
+    gain -= len + SCROLL_RUN_COST;
+  }
+  return gain >= SCROLL_MIN_GAIN;
+}
+
+static byte TryDragVideoHW(dat Left, dat Up, dat Rgt, dat Dwn, dat DstUp, dat LostUp,
+                           dat LostDwn) {
+  if (!HW->CanDragArea(Left, Up, Rgt, Dwn, Left, DstUp) ||
+      !ScrollGain(Left, Rgt, DstUp, DstUp + (Dwn - Up), Up - DstUp, LostUp, LostDwn))
+    return tfalse;
+
+  HW->DragArea(Left, Up, Rgt, Dwn, Left, DstUp);
+  DragTCellArea(OldVideo, Left, Up, Rgt, Dwn, Left, DstUp);
+  /* rows that were clean may now differ */
+  DirtyVideo(Left, DstUp, Rgt, DstUp + (Dwn - Up));
+  return ttrue;
+}
+
+static void DetectScrollVideoHW(void) {
+  dat x0 = TW_MAXDAT, x1 = TW_MINDAT, y0 = -1, y1 = -1;
+  dat y, z, shift, best, run, bestrun, bestup;
+  ldat len;
+  uldat *hV, *hO;
+  dirty_row *R;
+
+  for (y = 0; y < DisplayHeight; y++) {
+    R = &ChangedVideo[y];
+    if (R->N) {
+      if (y0 < 0)
+        y0 = y;
+      y1 = y;
+      x0 = Min2(x0, R->Span[0][0]);
+      x1 = Max2(x1, R->Span[R->N - 1][1]);
+    }
+  }
+  if (y0 < 0 || y1 - y0 + 1 < 2 * SCROLL_MIN_ROWS)
+    return;
+
+  if (ScrollHashLen < DisplayHeight) {
+    if (!(hV = (uldat *)ReAllocMem(ScrollHash, 2 * (ldat)DisplayHeight * sizeof(uldat))))
+      return;
+    ScrollHash = hV;
+    if (!(ScrollVote = (udat *)ReAllocMem(ScrollVote, 2 * (ldat)DisplayHeight * sizeof(udat)))) {
+      ScrollHashLen = 0;
+      return;
+    }
+    ScrollHashLen = DisplayHeight;
+  }
+  hV = ScrollHash;
+  hO = ScrollHash + DisplayHeight;
+  len = x1 - x0 + 1;
+
+  for (y = y0; y <= y1; y++) {
+    hV[y] = HashTCellRow(Video + x0 + y * (ldat)DisplayWidth, len);
+    hO[y] = HashTCellRow(OldVideo + x0 + y * (ldat)DisplayWidth, len);
+  }
+
+  /* each changed row votes for the shifts that would bring it back on screen */
+  memset(ScrollVote, 0, 2 * (ldat)DisplayHeight * sizeof(udat));
+  for (y = y0; y <= y1; y++) {
+    if (hV[y] == hO[y])
+      continue;
+    for (z = y0; z <= y1; z++) {
+      if (hO[z] == hV[y])
+        ScrollVote[z - y + DisplayHeight]++;
+    }
+  }
+  for (best = 0, shift = y0 - y1; shift <= y1 - y0; shift++) {
+    if (ScrollVote[shift + DisplayHeight] > ScrollVote[best + DisplayHeight])
+      best = shift;
+  }
+  if (!best || ScrollVote[best + DisplayHeight] < SCROLL_MIN_ROWS)
+    return;
+
+  /* find the longest block of rows (in Video[] coordinates) moved by 'best' */
+  bestrun = run = 0;
+  bestup = y0;
+  for (y = Max2(y0, y0 - best); y <= Min2(y1, y1 - best); y++) {
+    if (hV[y] == hO[y + best] &&
+        SameTCellRow(Video + x0 + y * (ldat)DisplayWidth,
+                     OldVideo + x0 + (y + best) * (ldat)DisplayWidth, len)) {
+      if (++run > bestrun)
+        bestrun = run, bestup = y - run + 1;
+    } else
+      run = 0;
+  }
+  if (bestrun < SCROLL_MIN_ROWS)
+    return;
+
+  if (TryDragVideoHW(x0, bestup + best, x1, bestup + best + bestrun - 1, bestup, 0, -1))
+    return;
+
+  /*
+   * displays that can only scroll the whole screen up (ttys): try that too,
+   * counting the rows it leaves blank at the bottom as repainted.
+   */
+  if (best > 0)
+    TryDragVideoHW(0, best, DisplayWidth - 1, DisplayHeight - 1, 0, DisplayHeight - best,
+                   DisplayHeight - 1);
+}
+
+INLINE void ClearChangedVideo(void) {
+  ldat i;
+
+  for (i = 0; i < (ldat)DisplayHeight; i++)
+    ChangedVideo[i].N = 0;
+}
+
+/*
+ * frame pacing.
+ *
+ * while output keeps coming, frames are coalesced and each display gets
+ * at most one every FRAME_BULK (FRAME_SLOW if it has FlHWExpensiveFlushVideo).
+ * for FRAME_INPUT after the user typed or moved the mouse, frames are sent
+ * as soon as possible instead.
+ * in both cases a display waits FRAME_COST_RATIO times what its frames cost,
+ * up to FRAME_LATENCY, and does not get new frames while it still
+ * has output queued from previous ones (NEEDFromPreviousFlushHW).
+ * displays that measure how fast their device consumes output (DrainRate) also wait
+ * until what it had not consumed after the last frame (OutBacklog) should be gone,
+ * up to FRAME_DRAIN: sending more earlier would only queue it behind.
+ */
+#define FRAME_BULK (16 MilliSECs)
+#define FRAME_SLOW (33 MilliSECs)
+#define FRAME_INPUT (100 MilliSECs)
+#define FRAME_LATENCY (50 MilliSECs)
+#define FRAME_COST_RATIO 4
+#define FRAME_DRAIN (500 MilliSECs)
+
+/* minimum delay between two frames of HW */
+static tany FrameDelayHW(void) {
+  timevalue t = {(tany)0, FRAME_INPUT};
+  tany delay = HW->FrameCost * FRAME_COST_RATIO, drain = 0, perbyte;
+
+  IncrTime(&t, &InputTime);
+  if (CmpTime(&t, &All->Now) <= 0)
+    delay = Max2(delay, HW->FlagsHW & FlHWExpensiveFlushVideo ? FRAME_SLOW : FRAME_BULK);
+
+  if (HW->OutBacklog && HW->DrainRate) {
+    perbyte = Max2((1 FullSECs) / HW->DrainRate, 1);
+    drain = HW->OutBacklog < FRAME_DRAIN / perbyte ? HW->OutBacklog * perbyte : FRAME_DRAIN;
+  }
+  return Max2(Min2(delay, FRAME_LATENCY), drain);
+}
+
+/* return when the next frame of HW is due, or NULL if it has nothing to send or must wait */
+static timevalue *FrameDueTimeHW(timevalue *due, byte changed) {
+  timevalue delay = {(tany)0, (tany)0};
+
+  /* the worker thread owns the fields of HW until its frame is synced: test this first */
+  if (FrameBusyHW(HW) || (!changed && !HW->RedrawVideo) ||
+      (HW->NeedHW & NEEDFromPreviousFlushHW))
+    return NULL;
+  delay.Fraction = FrameDelayHW();
+  return SumTime(due, &HW->FrameTime, &delay);
+}
+
+/* return ttrue if some display would get a frame now, if there was something to draw */
+byte FrameDueHW(void) {
+  timevalue due;
+  byte got = tfalse;
+
+  forHWNoSync {
+    if (FrameDueTimeHW(&due, ttrue) && CmpTime(&due, &All->Now) <= 0)
+      got = ttrue;
+  }
+  return got;
+}
+
+/*
+ * shorten the main loop sleep so that frames delayed by PacedFlushHW() are sent in time.
+ * if pending is ttrue, there is also damage not drawn yet that needs a frame.
+ */
+struct timeval *FrameSleepTime(struct timeval *sleeptime, struct timeval *timeout, byte pending) {
+  timevalue due, delta;
+  struct timeval t;
+  byte got = tfalse;
+
+  forHWNoSync {
+    if (!FrameDueTimeHW(&due, HW->ChangedVideoFlag || pending))
+      continue;
+    if (CmpTime(&due, &All->Now) > 0)
+      SubTime(&delta, &due, &All->Now);
+    else
+      delta.Seconds = delta.Fraction = (tany)0;
+
+    t.tv_sec = delta.Seconds;
+    t.tv_usec = delta.Fraction / (1 MicroSECs);
+    if (!timeout || t.tv_sec < timeout->tv_sec ||
+        (t.tv_sec == timeout->tv_sec && t.tv_usec < timeout->tv_usec)) {
+      *sleeptime = t;
+      timeout = sleeptime;
+      got = ttrue;
+    }
+  }
+  return got ? sleeptime : timeout;
+}
+
+/*
+ * send a frame to HW, with the globals of FlushVideoHW() already swapped in.
+ * if flush is tfalse, leave the call to HW->FlushHW() to the caller.
+ */
+static void FrameVideoHW(byte doBeep, byte flush) {
+  timevalue start, end;
+  byte frame = ChangedVideoFlag || HW->RedrawVideo;
+
+  if (frame)
+    InstantNow(&start);
+
+  if (ChangedVideoFlag && ValidOldVideo && !HW->RedrawVideo && HW->CanDragArea)
+    /* this may set HW->RedrawVideo */
+    DetectScrollVideoHW();
+
+  if (HW->RedrawVideo) {
+    DirtyVideo(HW->RedrawLeft, HW->RedrawUp, HW->RedrawRight, HW->RedrawDown);
+    /* the OldVideo[] caching would make all this stuff useless otherwise */
+    if (HW->RedrawLeft <= 0 && HW->RedrawUp <= 0 && HW->RedrawRight >= DisplayWidth - 1 &&
+        HW->RedrawDown >= DisplayHeight - 1)
+      ValidOldVideo = tfalse;
+    else if (ValidOldVideo)
+      InvalidateOldVideo(HW->RedrawLeft, HW->RedrawUp, HW->RedrawRight, HW->RedrawDown);
+  }
+  if (ChangedVideoFlag && ValidOldVideo)
+    OptimizeChangedVideo();
+
+  if (doBeep)
+    HW->Beep();
+
+  HW->FlushVideo();
+
+  HW->RedrawVideo = tfalse;
+
+  if (flush && (HW->NeedHW & NEEDFlushHW))
+    HW->FlushHW();
+
+  if (ChangedVideoFlag) {
+    if (OldVideo)
+      SyncOldVideo();
+    else
+      ClearChangedVideo();
+  }
+  ChangedVideoFlag = tfalse;
+  ValidOldVideo = OldVideo != NULL;
+
+  if (frame) {
+    InstantNow(&end);
+    SubTime(&end, &end, &start);
+    HW->FrameCost = (HW->FrameCost * 7 + (end.Seconds ? 1 FullSECs : end.Fraction)) / 8;
+    HW->FrameTime = start;
+  }
+}
+
+/*
+ * threaded FlushVideo().
+ *
+ * a display with FlHWThreadedFlushVideo gets a worker thread, started at its first frame.
+ * instead of sending a frame itself, FlushVideoHW() publishes it: the damaged spans
+ * of Video[] are copied into a per-display snapshot, which therefore always matches
+ * Video[] as of the last published frame, and the damage itself is handed over
+ * by swapping HW->ChangedVideo[] with the frame one. the worker then runs FrameVideoHW()
+ * with the THREAD_LOCAL globals pointing to the frame, while the main loop goes on
+ * with other displays and events. when it is done it wakes up the main loop through
+ * FrameWakeFd, and the output is sent with HW->FlushHW() from the main thread.
+ *
+ * while a frame is in flight, new damage just accumulates in HW->ChangedVideo[]
+ * and nobody else touches the display: forHW and SetHW() wait for the frame to be finished.
+ */
+#ifdef HAVE_THREAD_LOCAL
+
+static int FrameWakeFd[2] = {NOFD, NOFD};
+
+static void *FrameThreadMain(void *arg) {
+  display_hw hw = (display_hw)arg;
+  frame_thread FT = hw->FrameThread;
+  char c = '\0';
+
+  HW = hw;
+  QueuedFullScreen = &FT->QueuedFullScreen;
+
+  pthread_mutex_lock(&FT->Mutex);
+  for (;;) {
+    while (!FT->Busy && !FT->Quit)
+      pthread_cond_wait(&FT->Cond, &FT->Mutex);
+    if (FT->Quit)
+      break;
+    pthread_mutex_unlock(&FT->Mutex);
+
+    Video = FT->Video;
+    OldVideo = hw->OldVideo;
+    ChangedVideo = FT->ChangedVideo;
+    ChangedVideoFlag = FT->ChangedVideoFlag;
+    ValidOldVideo = FT->ValidOldVideo;
+    CursorX = FT->CursorX;
+    CursorY = FT->CursorY;
+    CursorType = FT->CursorType;
+
+    FrameVideoHW(FT->doBeep, tfalse);
+
+    FT->ValidOldVideo = ValidOldVideo;
+
+    pthread_mutex_lock(&FT->Mutex);
+    FT->Busy = tfalse;
+    FT->Done = ttrue;
+    pthread_cond_broadcast(&FT->Cond);
+    /* if the pipe is full, the main loop is already going to wake up */
+    if (write(FrameWakeFd[1], &c, 1) < 0)
+      ;
+  }
+  pthread_mutex_unlock(&FT->Mutex);
+
+  if (ScrollHash)
+    FreeMem(ScrollHash);
+  if (ScrollVote)
+    FreeMem(ScrollVote);
+  return NULL;
+}
+
+/* a frame was sent by the worker thread of hw: send its output */
+static void FinishFrameHW(display_hw hw) {
+  frame_thread FT = hw->FrameThread;
+  SaveHW;
+
+  FT->Published = FT->Done = tfalse;
+  hw->ValidOldVideo = FT->ValidOldVideo;
+
+  if (hw->NeedHW & NEEDFlushHW) {
+    HW = hw;
+    hw->FlushHW();
+  }
+  RestoreHW;
+}
+
+/* finish the frame of hw if its worker thread is done with it, without waiting */
+static void PollFrameHW(display_hw hw) {
+  frame_thread FT = hw->FrameThread;
+  byte done;
+
+  if (FT && FT->Published) {
+    pthread_mutex_lock(&FT->Mutex);
+    done = FT->Done;
+    pthread_mutex_unlock(&FT->Mutex);
+    if (done)
+      FinishFrameHW(hw);
+  }
+}
+
+void SyncFrameHW(display_hw hw) {
+  frame_thread FT;
+
+  if (hw && (FT = hw->FrameThread) && FT->Published) {
+    pthread_mutex_lock(&FT->Mutex);
+    while (!FT->Done)
+      pthread_cond_wait(&FT->Cond, &FT->Mutex);
+    pthread_mutex_unlock(&FT->Mutex);
+    FinishFrameHW(hw);
+  }
+}
+
+/* the main loop was woken up by a worker thread */
+static void FrameWakeIO(int Fd, uldat Slot) {
+  display_hw hw;
+  char buf[64];
+
+  while (read(Fd, buf, sizeof(buf)) > 0)
+    ;
+  for (hw = All->FirstDisplayHW; hw; hw = hw->Next)
+    PollFrameHW(hw);
+}
+
+static byte OpenFrameWakeFd(void) {
+  if (FrameWakeFd[0] != NOFD)
+    return ttrue;
+  if (pipe(FrameWakeFd) < 0) {
+    FrameWakeFd[0] = FrameWakeFd[1] = NOFD;
+    return tfalse;
+  }
+  fcntl(FrameWakeFd[0], F_SETFL, O_NONBLOCK);
+  fcntl(FrameWakeFd[1], F_SETFL, O_NONBLOCK);
+  fcntl(FrameWakeFd[0], F_SETFD, FD_CLOEXEC);
+  fcntl(FrameWakeFd[1], F_SETFD, FD_CLOEXEC);
+
+  if (RegisterRemoteFd(FrameWakeFd[0], FrameWakeIO) == NOSLOT) {
+    close(FrameWakeFd[0]);
+    close(FrameWakeFd[1]);
+    FrameWakeFd[0] = FrameWakeFd[1] = NOFD;
+    return tfalse;
+  }
+  return ttrue;
+}
+
+static byte StartFrameThreadHW(void) {
+  frame_thread FT;
+  sigset_t mask, old;
+  byte ok;
+
+  if (!OpenFrameWakeFd() || !(FT = (frame_thread)AllocMem0(sizeof(struct s_frame_thread), 1)))
+    return tfalse;
+
+  pthread_mutex_init(&FT->Mutex, NULL);
+  pthread_cond_init(&FT->Cond, NULL);
+  HW->FrameThread = FT;
+
+  /* signals must be delivered to the main thread */
+  sigfillset(&mask);
+  pthread_sigmask(SIG_SETMASK, &mask, &old);
+  ok = pthread_create(&FT->Thread, NULL, FrameThreadMain, HW) == 0;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (!ok) {
+    HW->FrameThread = NULL;
+    pthread_cond_destroy(&FT->Cond);
+    pthread_mutex_destroy(&FT->Mutex);
+    FreeMem(FT);
+  }
+  return ok;
+}
+
+static void StopFrameThreadHW(display_hw D_HW) {
+  frame_thread FT = D_HW->FrameThread;
+
+  if (!FT)
+    return;
+  SyncFrameHW(D_HW);
+
+  pthread_mutex_lock(&FT->Mutex);
+  FT->Quit = ttrue;
+  pthread_cond_broadcast(&FT->Cond);
+  pthread_mutex_unlock(&FT->Mutex);
+  pthread_join(FT->Thread, NULL);
+
+  pthread_cond_destroy(&FT->Cond);
+  pthread_mutex_destroy(&FT->Mutex);
+  if (FT->Video)
+    FreeMem(FT->Video);
+  if (FT->ChangedVideo)
+    FreeMem(FT->ChangedVideo);
+  FreeMem(FT);
+  D_HW->FrameThread = NULL;
+}
+
+/* copy the damaged spans of Video[] into the snapshot of HW. return tfalse if out of memory */
+static byte SnapshotVideoHW(frame_thread FT) {
+  ldat i, start;
+  dat k;
+  tcell *V;
+  dirty_row *R;
+
+  if (FT->Width != DisplayWidth || FT->Height != DisplayHeight) {
+    if (!(V = (tcell *)ReAllocMem(FT->Video, (ldat)DisplayWidth * DisplayHeight * sizeof(tcell))))
+      return tfalse;
+    FT->Video = V;
+    if (!(R = (dirty_row *)ReAllocMem(FT->ChangedVideo, (ldat)DisplayHeight * sizeof(dirty_row))))
+      return tfalse;
+    FT->ChangedVideo = R;
+    FT->Width = DisplayWidth;
+    FT->Height = DisplayHeight;
+    CopyMem(Video, FT->Video, (ldat)DisplayWidth * DisplayHeight * sizeof(tcell));
+    return ttrue;
+  }
+  for (i = 0; i < (ldat)DisplayHeight; i++) {
+    for (k = 0; k < ChangedVideo[i].N; k++) {
+      start = ChangedVideo[i].Span[k][0] + i * (ldat)DisplayWidth;
+      CopyMem(Video + start, FT->Video + start,
+              (ChangedVideo[i].Span[k][1] + 1 - ChangedVideo[i].Span[k][0]) * sizeof(tcell));
+    }
+  }
+  return ttrue;
+}
+
+/*
+ * hand the frame of HW over to its worker thread, with the globals of FlushVideoHW()
+ * already swapped in. return tfalse if out of memory.
+ */
+static byte PublishFrameHW(byte doBeep) {
+  frame_thread FT = HW->FrameThread;
+  dirty_row *R;
+
+  if (!SnapshotVideoHW(FT))
+    return tfalse;
+
+  R = FT->ChangedVideo;
+  FT->ChangedVideo = ChangedVideo;
+  ChangedVideo = HW->ChangedVideo = R;
+  ClearChangedVideo();
+
+  FT->ChangedVideoFlag = ChangedVideoFlag;
+  FT->ValidOldVideo = ValidOldVideo;
+  FT->QueuedFullScreen = QueuedDrawArea2FullScreen;
+  FT->doBeep = doBeep;
+  FT->CursorX = CursorX;
+  FT->CursorY = CursorY;
+  FT->CursorType = CursorType;
+  ChangedVideoFlag = tfalse;
+
+  pthread_mutex_lock(&FT->Mutex);
+  FT->Busy = ttrue;
+  pthread_cond_signal(&FT->Cond);
+  pthread_mutex_unlock(&FT->Mutex);
+  FT->Published = ttrue;
+  return ttrue;
+}
+
+/* keep the snapshot of HW matching Video[] when DragAreaHW() drags it */
+static void DragFrameHW(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp) {
+  frame_thread FT = HW->FrameThread;
+
+  if (FT && FT->Video && FT->Width == DisplayWidth && FT->Height == DisplayHeight)
+    DragTCellArea(FT->Video, Left, Up, Rgt, Dwn, DstLeft, DstUp);
+}
+
+#else /* !HAVE_THREAD_LOCAL */
+
+#define PollFrameHW(hw)                                                                            \
+  do {                                                                                             \
+  } while (0)
+#define StartFrameThreadHW() tfalse
+#define PublishFrameHW(doBeep) tfalse
+#define DragFrameHW(Left, Up, Rgt, Dwn, DstLeft, DstUp)                                           \
+  do {                                                                                             \
+  } while (0)
+
+void SyncFrameHW(display_hw hw) {
+}
+
+static void StopFrameThreadHW(display_hw D_HW) {
+}
+
+#endif /* HAVE_THREAD_LOCAL */
+
+/*
+ * flush a single display: add the shared ChangedVideo[] to its own,
+ * then let its FlushVideo() run with the global OldVideo, ChangedVideo,
+ * ValidOldVideo and ChangedVideoFlag pointing to its own copies.
+ *
+ * this way each display diffs Video[] against what *it* shows,
+ * and an area redrawn on one display (HW->RedrawVideo, soft mouse...)
+ * is not sent again to the other ones.
+ *
+ * if paced is ttrue and the next frame of the display is not due yet,
+ * or its previous frame is still in flight on its worker thread,
+ * its damage just waits in its own ChangedVideo[].
+ */
+static void FlushVideoHW(byte doBeep, byte paced) {
+  tcell *sharedOldVideo = OldVideo;
+  dirty_row *sharedChangedVideo = ChangedVideo;
+  byte sharedChangedVideoFlag = ChangedVideoFlag, sharedValidOldVideo = ValidOldVideo;
+  timevalue due;
+  ldat i;
+  dat k;
+
+  if (!HW->ChangedVideo)
+    ResizeVideoHW(HW);
+
+  if (paced && !doBeep)
+    PollFrameHW(HW);
+  else
+    SyncFrameHW(HW);
+
+  if ((HW->FlagsHW & FlHWThreadedFlushVideo) && !HW->FrameThread && !HW->Quitted &&
+      !StartFrameThreadHW())
+    HW->FlagsHW &= ~FlHWThreadedFlushVideo;
+
+  OldVideo = HW->OldVideo;
+  ChangedVideo = HW->ChangedVideo;
+  ChangedVideoFlag = HW->ChangedVideoFlag;
+  ValidOldVideo = HW->ValidOldVideo && OldVideo;
+
+  if (sharedChangedVideoFlag) {
+    for (i = 0; i < (ldat)DisplayHeight; i++) {
+      for (k = 0; k < sharedChangedVideo[i].N; k++)
+        DirtyVideo(sharedChangedVideo[i].Span[k][0], i, sharedChangedVideo[i].Span[k][1], i);
     }
   }
+
+  if (FrameBusyHW(HW))
+    /* wait for the frame in flight */
+    ;
+  else if (!paced || doBeep || !(ChangedVideoFlag || HW->RedrawVideo) ||
+           (FrameDueTimeHW(&due, ChangedVideoFlag) && CmpTime(&due, &All->Now) <= 0)) {
+    /* empty frames only update the cursor: not worth a trip to the worker thread */
+    if (!HW->FrameThread || !(doBeep || ChangedVideoFlag || HW->RedrawVideo) ||
+        !PublishFrameHW(doBeep))
+      FrameVideoHW(doBeep, ttrue);
+  } else if (HW->NeedHW & NEEDFlushHW)
+    /* keep sending what is still queued */
+    HW->FlushHW();
+
+  HW->ChangedVideoFlag = ChangedVideoFlag;
+  HW->ValidOldVideo = ValidOldVideo;
+
+  OldVideo = sharedOldVideo;
+  ChangedVideo = sharedChangedVideo;
+  ChangedVideoFlag = sharedChangedVideoFlag;
+  ValidOldVideo = sharedValidOldVideo;
 }
 
 #define MaxRecentBeepHW ((byte)30)
 
-void FlushHW(void) {
+static void FlushAllHW(byte paced) {
   static timevalue LastBeep = {(tany)0, (tany)0};
   timevalue tmp = {(tany)0, 100 MilliSECs};
-  byte doBeep = tfalse, saved = tfalse, mangled = tfalse;
-  byte saveChangedVideoFlag, saveValidOldVideo;
-  /*
-   * we can NEVER get (saved == tfalse && mangled == ttrue)
-   * as it would mean we have irreversibly lost ChangedVideo[]
-   */
+  byte doBeep = tfalse;
 
   /*
    * displaying on ourselves can cause infine beeping loops...
@@ -871,6 +1609,8 @@ void FlushHW(void) {
 
   if (QueuedDrawArea2FullScreen) {
     QueuedDrawArea2FullScreen = tfalse;
+    /* windows may have changed without being drawn */
+    ClearBackStores();
     DirtyVideo(0, 0, DisplayWidth - 1, DisplayHeight - 1);
     DrawArea2(FULL_SCREEN);
     UpdateCursor();
@@ -882,57 +1622,32 @@ void FlushHW(void) {
   if (!(All->SetUp->Flags & SETUP_BLINK))
     DiscardBlinkVideo();
 
-  if (NeedOldVideo && ValidOldVideo)
-    OptimizeChangedVideo();
-
-  forHW {
-    /*
-     * adjust ChangedVideoFlag and ChangedVideo[]
-     * to include HW supplied area HW->Redraw*
-     *
-     * we do not save/restore ChangedVideoFlagAgain since it's used
-     * to decide buffering strategies, so must reflect whether
-     * some display had to draw something or not.
-     */
-    if (mangled) {
-      ValidOldVideo = saveValidOldVideo;
-      ChangedVideoFlag = saveChangedVideoFlag;
-      CopyMem(saveChangedVideo, ChangedVideo, (ldat)DisplayHeight * sizeof(dat) * 4);
-      mangled = tfalse;
-    }
-    if (HW->RedrawVideo ||
-        ((HW->FlagsHW & FlHWSoftMouse) && (HW->FlagsHW & FlHWChangedMouseFlag))) {
-      if (!saved) {
-        saveValidOldVideo = ValidOldVideo;
-        saveChangedVideoFlag = ChangedVideoFlag;
-        CopyMem(ChangedVideo, saveChangedVideo, (ldat)DisplayHeight * sizeof(dat) * 4);
-        saved = ttrue;
-      }
-      if (HW->RedrawVideo) {
-        DirtyVideo(HW->RedrawLeft, HW->RedrawUp, HW->RedrawRight, HW->RedrawDown);
-        ValidOldVideo = tfalse;
-        /* the OldVideo[] caching would make all this stuff useless otherwise */
-      }
-      mangled = ttrue;
-    }
-    if (doBeep)
-      HW->Beep();
-
-    HW->FlushVideo();
-
-    HW->RedrawVideo = tfalse;
-
-    if (HW->NeedHW & NEEDFlushHW)
-      HW->FlushHW();
+  forHWNoSync {
+    FlushVideoHW(doBeep, paced);
+  }
+  if (!paced) {
+    /* FlushHW() must return with all frames sent */
+    for (HW = All->FirstDisplayHW; HW; HW = HW->Next)
+      SyncFrameHW(HW);
   }
   if (NeedHW & NEEDFlushStdout)
     fflush(stdout), NeedHW &= ~NEEDFlushStdout;
 
-  if (ChangedVideoFlag && NeedOldVideo)
-    SyncOldVideo();
-
+  /* every display merged the shared damage into its own ChangedVideo[] */
+  ClearChangedVideo();
   ChangedVideoFlag = tfalse;
-  ValidOldVideo = ttrue;
+
+  FrameDrawCtxStats();
+}
+
+/* send everything to all displays now */
+void FlushHW(void) {
+  FlushAllHW(tfalse);
+}
+
+/* as FlushHW(), but each display only gets a frame when FrameDueTimeHW() says so */
+void PacedFlushHW(void) {
+  FlushAllHW(ttrue);
 }
 
 void SyntheticKey(widget W, udat Code, udat ShiftFlags, byte Len, CONST char *Seq) {
@@ -1004,7 +1719,9 @@ void FillOldVideo(dat Xstart, dat Ystart, dat Xend, dat Yend, tcell Attrib) {
 }
 
 void RefreshVideo(void) {
-  ValidOldVideo = tfalse;
+  forHW {
+    HW->ValidOldVideo = tfalse;
+  }
   QueuedDrawArea2FullScreen = ttrue;
   /* safer than DirtyVideo(0, 0, DisplayWidth - 1, DisplayHeight - 1),
    * and also updates the cursor */
@@ -1012,17 +1729,15 @@ void RefreshVideo(void) {
 
 INLINE uldat Plain_countDirtyVideo(dat X1, dat Y1, dat X2, dat Y2) {
   uldat t = 0;
-  dat a, b;
+  dat a, b, k;
 
   for (; Y1 <= Y2; Y1++) {
-    a = ChangedVideo[Y1][0][0];
-    b = ChangedVideo[Y1][0][1];
-    if (a != -1 && a <= X2 && b >= X1)
-      t += Min2(b, X2) - Max2(a, X1) + 1;
-    if (a != -1) {
-      a = ChangedVideo[Y1][1][0];
-      b = ChangedVideo[Y1][1][0];
-      if (a != -1 && a <= X2 && b >= X1)
+    for (k = 0; k < ChangedVideo[Y1].N; k++) {
+      a = ChangedVideo[Y1].Span[k][0];
+      b = ChangedVideo[Y1].Span[k][1];
+      if (a > X2)
+        break;
+      if (b >= X1)
         t += Min2(b, X2) - Max2(a, X1) + 1;
     }
   }
@@ -1089,6 +1804,10 @@ byte AllHWCanDragAreaNow(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat Ds
 void DragAreaHW(dat Left, dat Up, dat Rgt, dat Dwn, dat DstLeft, dat DstUp) {
   forHW {
     HW->DragArea(Left, Up, Rgt, Dwn, DstLeft, DstUp);
+    if (HW->OldVideo)
+      DragTCellArea(HW->OldVideo, Left, Up, Rgt, Dwn, DstLeft, DstUp);
+    /* the frame snapshot must keep matching Video[] outside the damage */
+    DragFrameHW(Left, Up, Rgt, Dwn, DstLeft, DstUp);
   }
 }
 
@@ -1104,6 +1823,8 @@ byte MouseEventCommon(dat x, dat y, dat dx, dat dy, udat Buttons) {
   byte ret = ttrue;
   byte alsoMotionEvents = All->MouseMotionN > 0;
 
+  InputTime = All->Now;
+
   OldState = &HW->MouseState;
   OldButtons = OldState->keys;
   prev_x = OldState->x;
@@ -1178,6 +1899,8 @@ byte KeyboardEventCommon(udat Code, udat ShiftFlags, udat Len, CONST char *Seq)
   if (HW->FlagsHW & FlHWNoInput)
     return ttrue;
 
+  InputTime = All->Now;
+
   if ((Msg = Do(Create, Msg)(FnMsg, MSG_KEY, Len))) {
     Event = &Msg->Event.EventKeyboard;
 
@@ -15,12 +15,10 @@
  */
 
 extern byte StrategyFlag;
-extern tany StrategyDelay;
 /* strategy */
 #define HW_UNSET 0
 #define HW_ACCEL 1
 #define HW_BUFFER 2
-#define HW_DELAY 3
 
 void StrategyReset(void);
 byte Strategy4Video(dat Xstart, dat Ystart, dat Xend, dat Yend);
@@ -41,6 +39,10 @@ void FillVideo(dat Xstart, dat Ystart, dat Xend, dat Yend, tcell Attrib);
 void RefreshVideo(void);
 byte ResizeDisplay(void);
 
+void PacedFlushHW(void);
+byte FrameDueHW(void);
+struct timeval *FrameSleepTime(struct timeval *sleeptime, struct timeval *timeout, byte pending);
+
 void RunNoHW(byte print_info);
 void UpdateFlagsHW(void);
 
@@ -15,11 +15,11 @@
  * i.e. intended to be used only by hw/hw_*.c drivers
  */
 
-extern dat (*ChangedVideo)[2][2];
-extern byte ChangedVideoFlag;
+extern THREAD_LOCAL dirty_row *ChangedVideo;
+extern THREAD_LOCAL byte ChangedVideoFlag;
 
-extern dat CursorX, CursorY;
-extern uldat CursorType;
+extern THREAD_LOCAL dat CursorX, CursorY;
+extern THREAD_LOCAL uldat CursorType;
 
 extern dat DisplayWidth, DisplayHeight;
 
@@ -30,11 +30,14 @@ void saveDisplaySize(void);
 
 void NeedRedrawVideo(dat Left, dat Up, dat Right, dat Down);
 
-extern display_hw HW;
+extern THREAD_LOCAL display_hw HW;
+
+/* wait until the worker thread of hw, if any, finished flushing its last frame */
+void SyncFrameHW(display_hw hw);
 
 #define SaveHW display_hw s_hw = HW
 
-#define SetHW(hw) (HW = (hw))
+#define SetHW(hw) (HW = (hw), SyncFrameHW(HW))
 
 #define RestoreHW (HW = s_hw)
 
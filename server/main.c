@@ -34,6 +34,7 @@
 #include "hw_multi.h"
 #include "scroller.h"
 #include "util.h"
+#include "hist.h"
 #include "remote.h"
 #include "version.h"
 
@@ -127,6 +128,10 @@ static void Usage(void) {
         " -s, --share              start display as shared (default)\n"
         " -x, --excl               start display as exclusive\n"
         " --nohw                   start in background without display\n"
+        " --backstore=<KB>         memory for copies of windows that redraw them faster\n"
+        "                          when exposed (default 4096, 0 = none)\n"
+        " --drawthreads=<N>        threads drawing the whole screen at once\n"
+        "                          (default 0 = one per CPU, 1 = none)\n"
         " --hw=<display>[,options] start with the given display (multiple --hw=... allowed)\n"
         "                          (default: autoprobe all displays until one succeeds)\n"
         "Currently known display drivers: \n"
@@ -231,12 +236,8 @@ static void MergeHyphensArgv(int argc, char **argv) {
   }
 }
 
-#define MAXDELAY 50 MilliSECs
-#define MINDELAY 10000
-
 int main(int argc, char *argv[]) {
   msgport CurrPort;
-  timevalue Old, Cut;
   fd_set read_fds, write_fds, *pwrite_fds;
   struct timeval sel_timeout, *this_timeout;
   int num_fds;
@@ -288,24 +289,6 @@ int main(int argc, char *argv[]) {
      */
     this_timeout = CalcSleepTime(&sel_timeout, All->FirstMsgPort, Now);
 
-    if (ExpensiveFlushVideo) {
-      /* decide what to do... sleep a little if we can (HW_DELAY),
-       * otherwise revert to one of the other strategies */
-      if (!ChangedVideoFlagAgain || StrategyDelay >= MAXDELAY) {
-        StrategyDelay = (tany)0;
-        if (StrategyFlag == HW_DELAY)
-          StrategyFlag = HW_BUFFER;
-      } else {
-        if ((!this_timeout && (this_timeout = &sel_timeout)) || this_timeout->tv_sec ||
-            this_timeout->tv_usec > MINDELAY) {
-          this_timeout->tv_sec = (tany)0;
-          this_timeout->tv_usec = MINDELAY;
-        }
-        StrategyFlag = HW_DELAY;
-        ChangedVideoFlagAgain = tfalse;
-      }
-    }
-
     do {
       /* synchronously handle signals */
       if (GotSignals)
@@ -332,8 +315,14 @@ int main(int argc, char *argv[]) {
       if (NeedHW & NEEDPanicHW)
         PanicHW();
 
-      if (StrategyFlag != HW_DELAY)
-        FlushHW();
+      /* terminals that deferred drawing their bulk output draw it only when a frame is due */
+      if (TtyDirty && FrameDueHW())
+        DrawTtyDirty();
+
+      /* each display gets a new frame only when its frame pacing allows it */
+      PacedFlushHW();
+      /* ...so wake up in time for the frames it delayed */
+      this_timeout = FrameSleepTime(&sel_timeout, this_timeout, TtyDirty != NULL);
 
       if (NeedHW & NEEDPanicHW || All->FirstMsgPort->FirstMsg) {
         /*
@@ -346,6 +335,10 @@ int main(int argc, char *argv[]) {
         this_timeout = &sel_timeout;
       }
 
+      /* compress the scrollback filled since last time, before going to sleep */
+      if (HistPending)
+        CompressHist();
+
       read_fds = save_rfds;
 
       if (!FdWQueued)
@@ -362,19 +355,8 @@ int main(int argc, char *argv[]) {
       /* ach, problem. */
       num_fds = 0, RemoteParanoia();
 
-    if (StrategyFlag == HW_DELAY) {
-      /* keep track of how much we are delaying the flush */
-      CopyMem(Now, &Old, sizeof(timevalue));
-      InstantNow(Now);
-      SubTime(&Cut, Now, &Old);
-      if (Cut.Seconds || Cut.Fraction >= MAXDELAY)
-        StrategyDelay = MAXDELAY;
-      else
-        StrategyDelay += Cut.Fraction;
-    } else {
-      InstantNow(Now);
-      StrategyReset();
-    }
+    InstantNow(Now);
+    StrategyReset();
 
     /*
      * handle mouse, keyboard and connections to other programs
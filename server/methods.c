@@ -28,6 +28,7 @@
 #include "util.h"
 #include "hw.h"
 #include "hw_multi.h"
+#include "hist.h"
 
 #include <Tw/Tw.h>
 #include <Tw/Twstat.h>
@@ -426,9 +427,10 @@ static void UnMapWidget(widget W) {
       }
 
       Remove(W);
-      if (IS_WINDOW(W))
+      if (IS_WINDOW(W)) {
+        DeleteBackStore((window)W);
         DrawAreaWindow2((window)W);
-      else
+      } else
         DrawAreaWidget(W);
 
       if (IS_SCREEN(Parent)) {
@@ -829,15 +831,19 @@ static struct s_fn_gadget _FnGadget = {
 
 static byte InitTtyData(window Window, dat ScrollBackLines) {
   ttydata *Data = Window->USE.C.TtyData;
-  ldat count = Window->WLogic * Window->HLogic;
+  ldat count = Window->WLogic * (Window->HLogic - ScrollBackLines);
   tcell *p = Window->USE.C.Contents, h;
 
-  if (!Data && !(Window->USE.C.TtyData = Data = (ttydata *)AllocMem(sizeof(ttydata))))
+  if (!Data && !(Window->USE.C.TtyData = Data = (ttydata *)AllocMem0(sizeof(ttydata), 1)))
     return tfalse;
 
   if (!p && !(Window->USE.C.Contents = p = (tcell *)AllocMem(count * sizeof(tcell))))
     return tfalse;
 
+  if (ScrollBackLines > 0 && !Window->USE.C.Hist &&
+      !(Window->USE.C.Hist = CreateHist(ScrollBackLines, Window->WLogic)))
+    return tfalse;
+
   h = TCELL(COL(WHITE, BLACK), ' ');
   while (count--)
     *p++ = h;
@@ -857,8 +863,10 @@ static byte InitTtyData(window Window, dat ScrollBackLines) {
   Data->Bottom = Data->SizeY;
   Data->saveX = Data->X = Window->CurX = 0;
   Data->saveY = Data->Y = 0;
-  Data->Pos = Data->Start = Window->USE.C.Contents + Data->ScrollBack * Window->WLogic;
-  Data->Split = Window->USE.C.Contents + Window->WLogic * Window->HLogic;
+  Data->Pos = Data->Start = Window->USE.C.Contents;
+  Data->Split = Window->USE.C.Contents + Window->WLogic * Data->SizeY;
+  Data->DirtyY1 = 0;
+  Data->DirtyY2 = -1;
 
   Window->CursorType = LINECURSOR;
   /* respect the WINDOWFL_CURSOR_ON set by the client and don't force it on */
@@ -887,6 +895,224 @@ static byte InitTtyData(window Window, dat ScrollBackLines) {
 
 /* window */
 
+/*
+ * index of the rows of a USEROWS window, to find them by number and by Code
+ * without walking the list.
+ *
+ * rows are mostly appended at the end and dropped from the start (message and log windows),
+ * which InsertRow() and RemoveRow() follow in O(1). any other change just marks Row[] stale,
+ * and the next lookup rebuilds it from the list. the Code hash is rebuilt by the first
+ * FindRowByCode() after any change, since Code is often set right after inserting a row.
+ * windows with few rows, as menus, are not indexed.
+ */
+#define ROWINDEX_MIN 32
+
+struct s_rowindex {
+  row *Row;       /* the rows are Row[Off ... Off + Len - 1] */
+  ldat Off, Len, Max;
+  ldat *Hash;     /* number of the first row with each Code, or -1. open addressing */
+  ldat HashSize;  /* power of two */
+  byte Stale, HashStale;
+};
+
+static void DeleteRowIndex(window W) {
+  rowindex *I = W->USE.R.Index;
+
+  if (I) {
+    if (I->Row)
+      FreeMem(I->Row);
+    if (I->Hash)
+      FreeMem(I->Hash);
+    FreeMem(I);
+    W->USE.R.Index = NULL;
+  }
+}
+
+/* make room for one more row after Row[Off + Len - 1] */
+static byte GrowRowIndex(rowindex *I) {
+  row *R;
+  ldat Max;
+
+  if (I->Off + I->Len < I->Max)
+    return ttrue;
+  if (I->Off >= I->Max / 4) {
+    /* reuse the slots of the rows dropped from the start */
+    MoveMem(I->Row + I->Off, I->Row, I->Len * sizeof(row));
+    I->Off = 0;
+    return ttrue;
+  }
+  Max = I->Max * 2 + ROWINDEX_MIN;
+  if (!(R = (row *)ReAllocMem(I->Row, Max * sizeof(row))))
+    return tfalse;
+  I->Row = R;
+  I->Max = Max;
+  return ttrue;
+}
+
+/* return the index of W, building it if needed, or NULL if W has too few rows to need one */
+static rowindex *GetRowIndex(window W) {
+  rowindex *I = W->USE.R.Index;
+  row Row, *R;
+  ldat n;
+
+  if (W->HLogic < ROWINDEX_MIN && !I)
+    return NULL;
+  if (!I) {
+    if (!(I = W->USE.R.Index = (rowindex *)AllocMem0(sizeof(rowindex), 1)))
+      return NULL;
+    I->Stale = ttrue;
+  }
+  if (!I->Stale && I->Len == W->HLogic)
+    return I;
+
+  if (I->Max < W->HLogic) {
+    n = W->HLogic + W->HLogic / 2 + ROWINDEX_MIN;
+    if (!(R = (row *)ReAllocMem(I->Row, n * sizeof(row))))
+      return NULL;
+    I->Row = R;
+    I->Max = n;
+  }
+  for (n = 0, Row = W->USE.R.FirstRow; Row && n < I->Max; Row = Row->Next)
+    I->Row[n++] = Row;
+  if (Row)
+    /* HLogic is wrong, don't trust the index */
+    return NULL;
+  I->Off = 0;
+  I->Len = n;
+  I->Stale = tfalse;
+  I->HashStale = ttrue;
+  return I;
+}
+
+/* call after linking Row into W */
+static void RowIndexInsert(window W, row Row) {
+  rowindex *I = W->USE.R.Index;
+
+  if (!I || I->Stale)
+    return;
+  I->HashStale = ttrue;
+  if (!Row->Next && GrowRowIndex(I))
+    I->Row[I->Off + I->Len++] = Row;
+  else if (!Row->Prev && I->Off) {
+    I->Row[--I->Off] = Row;
+    I->Len++;
+  } else
+    I->Stale = ttrue;
+}
+
+/* call before unlinking Row from W */
+static void RowIndexRemove(window W, row Row) {
+  rowindex *I = W->USE.R.Index;
+
+  if (!I || I->Stale)
+    return;
+  I->HashStale = ttrue;
+  if (!Row->Next && I->Len)
+    I->Len--;
+  else if (!Row->Prev && I->Len) {
+    I->Off++;
+    I->Len--;
+  } else
+    I->Stale = ttrue;
+}
+
+#define ROWINDEX_HASH(Code, Size) ((ldat)(((uldat)(Code)*0x9E3779B1u) >> 15) & ((Size)-1))
+
+static byte HashRowIndex(rowindex *I) {
+  ldat *H, Size, n, h;
+  udat Code;
+
+  for (Size = 64; Size < 2 * I->Len && Size < 2 * 65536; Size *= 2)
+    ;
+  if (I->HashSize != Size) {
+    if (!(H = (ldat *)ReAllocMem(I->Hash, Size * sizeof(ldat))))
+      return tfalse;
+    I->Hash = H;
+    I->HashSize = Size;
+  }
+  for (h = 0; h < Size; h++)
+    I->Hash[h] = -1;
+
+  for (n = 0; n < I->Len; n++) {
+    Code = I->Row[I->Off + n]->Code;
+    for (h = ROWINDEX_HASH(Code, Size); I->Hash[h] >= 0; h = (h + 1) & (Size - 1))
+      if (I->Row[I->Off + I->Hash[h]]->Code == Code)
+        break;
+    if (I->Hash[h] < 0)
+      I->Hash[h] = n;
+  }
+  I->HashStale = tfalse;
+  return ttrue;
+}
+
+/* slabs of rows appended in bulk, see struct s_rowslab */
+
+#define ROWSLAB_MINROW 256
+#define ROWSLAB_MINTEXT (ROWSLAB_MINROW * 64)
+
+static void UnRefRowSlab(rowslab *Slab) {
+  if (!--Slab->Refs)
+    FreeMem(Slab);
+}
+
+/* return the slab of W, after replacing it if it has no room for NRow rows and NText trunes */
+rowslab *GetRowSlab(window W, uldat NRow, uldat NText) {
+  rowslab *Slab = W->USE.R.Slab;
+  uldat MaxRow, MaxText;
+
+  if (Slab && Slab->NRow + NRow <= Slab->MaxRow && Slab->NText + NText <= Slab->MaxText)
+    return Slab;
+
+  MaxRow = Max2(NRow, ROWSLAB_MINROW);
+  MaxText = Max2(NText, ROWSLAB_MINTEXT);
+  if (!(Slab = (rowslab *)AllocMem(sizeof(rowslab) + MaxRow * sizeof(struct s_row) +
+                                   MaxText * (sizeof(trune) + sizeof(tcolor)))))
+    return NULL;
+  Slab->Refs = 1;
+  Slab->NRow = Slab->NText = 0;
+  Slab->MaxRow = MaxRow;
+  Slab->MaxText = MaxText;
+  Slab->Row = (struct s_row *)(Slab + 1);
+  Slab->Text = (trune *)(Slab->Row + MaxRow);
+  Slab->ColText = (tcolor *)(Slab->Text + MaxText);
+
+  if (W->USE.R.Slab)
+    UnRefRowSlab(W->USE.R.Slab);
+  return W->USE.R.Slab = Slab;
+}
+
+/*
+ * as CreateRow(), carving the row and room for Len trunes of text from Slab,
+ * which must have been returned by GetRowSlab(). the row is empty.
+ */
+row CreateSlabRow(rowslab *Slab, udat Code, byte Flags, uldat Len, byte DefaultCol) {
+  row Row;
+
+  if (Code >= COD_RESERVED)
+    return (row)0;
+
+  Row = Slab->Row + Slab->NRow;
+  memset(Row, '\0', sizeof(struct s_row));
+  if (!AssignId((fn_obj)FnRow, (obj)Row))
+    return (row)0;
+  (Row->Fn = FnRow)->Used++;
+  FnRow->Fn_Obj->Used++;
+  Slab->NRow++;
+  Slab->Refs++;
+
+  Row->Slab = Slab;
+  Row->Code = Code;
+  Row->Flags = Flags;
+  if (Len) {
+    Row->Text = Slab->Text + Slab->NText;
+    if (!(Flags & ROW_DEFCOL) && !DefaultCol)
+      Row->ColText = Slab->ColText + Slab->NText;
+    Slab->NText += Len;
+    Row->MaxLen = Len;
+  }
+  return Row;
+}
+
 static window CreateWindow(fn_window Fn_Window, msgport Owner, dat TitleLen, CONST char *Title,
                            CONST tcolor *ColTitle, menu Menu, tcolor ColText, uldat CursorType,
                            uldat Attrib, uldat Flags, dat XWidth, dat YWidth, dat ScrollBackLines) {
@@ -986,12 +1212,22 @@ static void DeleteWindow(window W) {
   if (W->ColName)
     FreeMem(W->ColName);
   if (W_USE(W, USECONTENTS)) {
-    if (W->USE.C.TtyData)
+    if (W->USE.C.TtyData) {
+      ForgetTtyDirty(W);
+      if (W->USE.C.TtyData->DirtyX1)
+        FreeMem(W->USE.C.TtyData->DirtyX1);
       FreeMem(W->USE.C.TtyData);
+    }
     if (W->USE.C.Contents)
       FreeMem(W->USE.C.Contents);
-  } else if (W_USE(W, USEROWS))
+    if (W->USE.C.Hist)
+      DeleteHist(W->USE.C.Hist);
+  } else if (W_USE(W, USEROWS)) {
     DeleteList(W->USE.R.FirstRow);
+    DeleteRowIndex(W);
+    if (W->USE.R.Slab)
+      UnRefRowSlab(W->USE.R.Slab);
+  }
 
   (Fn_Widget->Delete)((widget)W);
   if (!--Fn_Widget->Used)
@@ -1060,12 +1296,14 @@ static void ChangeFieldWindow(window W, udat field, uldat CLEARMask, uldat XORMa
       }
     } break;
     case TWS_window_Flags:
-      mask = WINDOWFL_CURSOR_ON;
+      mask = WINDOWFL_CURSOR_ON | WINDOWFL_BACKSTORE;
       CLEARMask &= mask;
       XORMask &= mask;
       i = (W->Flags & ~CLEARMask) ^ XORMask;
       if ((i & mask) != (W->Flags & mask)) {
         W->Flags = i;
+        if (!(i & WINDOWFL_BACKSTORE))
+          DeleteBackStore(W);
         if (ContainsCursor((widget)W))
           UpdateCursor();
       }
@@ -1141,6 +1379,8 @@ static void SetTitleWindow(window W, dat titlelen, char *title) {
 
 static void SetColTextWindow(window W, tcolor ColText) {
   W->ColText = ColText;
+  /* the contents are drawn with ColText */
+  DeleteBackStore(W);
 }
 
 static void SetColorsWindow(window W, udat Bitmap, tcolor ColGadgets, tcolor ColArrows,
@@ -1167,6 +1407,8 @@ static void SetColorsWindow(window W, udat Bitmap, tcolor ColGadgets, tcolor Col
     W->ColDisabled = ColDisabled;
   if (Bitmap & 0x100)
     W->ColSelectDisabled = ColSelectDisabled;
+  if (Bitmap & 0x1E0)
+    DeleteBackStore(W);
   if (W->Parent)
     DrawBorderWindow(W, BORDER_ANY);
 }
@@ -1328,33 +1570,41 @@ tpos FakeFindBorderWindow(window W, dat u, dat v, byte Border, tcell *PtrAttr) {
 
 static row FindRow(window Window, ldat Row) {
   row CurrRow, ElPossib[4];
+  rowindex *I;
   byte Index;
   ldat k, ElNumRows[4], ElDist[4];
 
-  ElPossib[0] = Window->USE.R.RowOne;
-  ElPossib[1] = Window->USE.R.RowSplit;
-  ElPossib[2] = Window->USE.R.FirstRow;
-  ElPossib[3] = Window->USE.R.LastRow;
-  ElNumRows[0] = Window->USE.R.NumRowOne;
-  ElNumRows[1] = Window->USE.R.NumRowSplit;
-  ElNumRows[2] = (ldat)0;
-  ElNumRows[3] = Window->HLogic - (ldat)1;
-  ElDist[0] = (ElPossib[0] && ElNumRows[0] ? Abs(ElNumRows[0] - Row) : TW_MAXLDAT);
-  ElDist[1] = (ElPossib[1] && ElNumRows[1] ? Abs(ElNumRows[1] - Row) : TW_MAXLDAT);
-  ElDist[2] = Row;
-  ElDist[3] = Abs(ElNumRows[3] - Row);
-
-  Index = Minimum((byte)4, ElDist);
-  CurrRow = ElPossib[Index];
-  k = ElNumRows[Index];
-
-  if (CurrRow) {
-    if (k < Row)
-      while (k < Row && (CurrRow = CurrRow->Next))
-        k++;
-    else if (k > Row)
-      while (k > Row && (CurrRow = CurrRow->Prev))
-        k--;
+  if (Row < 0 || Row >= Window->HLogic)
+    return (row)0;
+
+  if ((I = GetRowIndex(Window)))
+    CurrRow = I->Row[I->Off + Row];
+  else {
+    ElPossib[0] = Window->USE.R.RowOne;
+    ElPossib[1] = Window->USE.R.RowSplit;
+    ElPossib[2] = Window->USE.R.FirstRow;
+    ElPossib[3] = Window->USE.R.LastRow;
+    ElNumRows[0] = Window->USE.R.NumRowOne;
+    ElNumRows[1] = Window->USE.R.NumRowSplit;
+    ElNumRows[2] = (ldat)0;
+    ElNumRows[3] = Window->HLogic - (ldat)1;
+    ElDist[0] = (ElPossib[0] && ElNumRows[0] ? Abs(ElNumRows[0] - Row) : TW_MAXLDAT);
+    ElDist[1] = (ElPossib[1] && ElNumRows[1] ? Abs(ElNumRows[1] - Row) : TW_MAXLDAT);
+    ElDist[2] = Row;
+    ElDist[3] = Abs(ElNumRows[3] - Row);
+
+    Index = Minimum((byte)4, ElDist);
+    CurrRow = ElPossib[Index];
+    k = ElNumRows[Index];
+
+    if (CurrRow) {
+      if (k < Row)
+        while (k < Row && (CurrRow = CurrRow->Next))
+          k++;
+      else if (k > Row)
+        while (k > Row && (CurrRow = CurrRow->Prev))
+          k--;
+    }
   }
   if (CurrRow && IS_MENUITEM(CurrRow))
     ((menuitem)CurrRow)->WCurY = Row;
@@ -1362,8 +1612,21 @@ static row FindRow(window Window, ldat Row) {
 }
 
 static row FindRowByCode(window Window, udat Code, ldat *NumRow) {
+  rowindex *I;
   row Row;
-  ldat Num = (ldat)0;
+  ldat Num = (ldat)0, h;
+
+  if ((I = GetRowIndex(Window)) && (!I->HashStale || HashRowIndex(I))) {
+    for (h = ROWINDEX_HASH(Code, I->HashSize); (Num = I->Hash[h]) >= 0;
+         h = (h + 1) & (I->HashSize - 1)) {
+      if ((Row = I->Row[I->Off + Num])->Code == Code) {
+        if (NumRow)
+          *NumRow = Num;
+        return Row;
+      }
+    }
+    return (row)0;
+  }
 
   if ((Row = Window->USE.R.FirstRow))
     while (Row && Row->Code != Code) {
@@ -1416,6 +1679,7 @@ static struct s_fn_window _FnWindow = {
     RowWriteAscii,
     RowWriteTRune,
     (byte(*)(window, dat, dat, uldat, CONST tcell *))AlwaysFalse,
+    RowAppendTRune, /* exported by resize.c */
 
     GotoXYWindow,
     SetTitleWindow,
@@ -1749,6 +2013,7 @@ static void InsertRow(row Row, window Parent, row Prev, row Next) {
   if (!Row->Window && Parent && W_USE(Parent, USEROWS)) {
     InsertGeneric((obj)Row, (obj_parent)&Parent->USE.R.FirstRow, (obj)Prev, (obj)Next,
                   &Parent->HLogic);
+    RowIndexInsert(Parent, Row);
     Row->Window = Parent;
     Parent->USE.R.NumRowOne = Parent->USE.R.NumRowSplit = (ldat)0;
   }
@@ -1757,6 +2022,7 @@ static void InsertRow(row Row, window Parent, row Prev, row Next) {
 static void RemoveRow(row Row) {
   if (Row->Window && W_USE(Row->Window, USEROWS)) {
     Row->Window->USE.R.NumRowOne = Row->Window->USE.R.NumRowSplit = (ldat)0;
+    RowIndexRemove(Row->Window, Row);
     RemoveGeneric((obj)Row, (obj_parent)&Row->Window->USE.R.FirstRow, &Row->Window->HLogic);
     Row->Window = (window)0;
   }
@@ -1768,12 +2034,21 @@ static void DeleteRow(row Row) {
     window W = Row->Window;
 
     Remove(Row);
-    if (Row->Text)
-      FreeMem(Row->Text);
-    if (Row->ColText)
-      FreeMem(Row->ColText);
+    if (!ROW_TEXT_IN_SLAB(Row)) {
+      if (Row->Text)
+        FreeMem(Row->Text);
+      if (Row->ColText)
+        FreeMem(Row->ColText);
+    }
 
-    (Fn_Obj->Delete)((obj)Row);
+    if (Row->Slab) {
+      /* as DeleteObj(), but the memory belongs to the slab */
+      DropId((obj)Row);
+      if (!--Row->Fn->Used)
+        FreeMem(Row->Fn);
+      UnRefRowSlab(Row->Slab);
+    } else
+      (Fn_Obj->Delete)((obj)Row);
     if (!--Fn_Obj->Used)
       FreeMem(Fn_Obj);
 
@@ -2818,6 +3093,10 @@ static void DeleteDisplayHW(display_hw DisplayHW) {
   Remove(DisplayHW);
   if (DisplayHW->NameLen && DisplayHW->Name)
     FreeMem(DisplayHW->Name);
+  if (DisplayHW->OldVideo)
+    FreeMem(DisplayHW->OldVideo);
+  if (DisplayHW->ChangedVideo)
+    FreeMem(DisplayHW->ChangedVideo);
 
   (Fn_Obj->Delete)((obj)DisplayHW);
   if (!--Fn_Obj->Used)
@@ -17,6 +17,8 @@ byte FakeWriteString(window Window, uldat Len, CONST char *String);
 byte FakeWriteTRune(window Window, uldat Len, CONST trune *TRune);
 byte FakeWriteTCell(window Window, dat x, dat y, uldat Len, CONST tcell *Attr);
 tpos FakeFindBorderWindow(window W, dat u, dat v, byte Border, tcell *PtrAttr);
+rowslab *GetRowSlab(window W, uldat NRow, uldat NText);
+row CreateSlabRow(rowslab *Slab, udat Code, byte Flags, uldat Len, byte DefaultCol);
 
 extern fn Fn;
 #define FnObj (Fn.f_obj)
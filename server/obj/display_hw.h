@@ -106,6 +106,9 @@ struct s_display_hw {
    *				  in the meantime, in order to merge the flush operations.
    * FlHWNoInput		: set if the display HW should be used as view-only,
    * 				  ignoring all input from it.
+   * FlHWThreadedFlushVideo	: set if FlushVideo() can run on a worker thread, i.e. if it only
+   *				  uses HW, the THREAD_LOCAL globals and its own private data.
+   *				  FlushHW() is still called from the main thread.
    */
 
   byte NeedHW;
@@ -130,7 +133,7 @@ struct s_display_hw {
    *
    * the upper layer (i.e. hw.c) automagically updates
    * ChangedVideoFlag and ChangedVideo[] to include this area
-   * for your display.
+   * for your display only.
    */
 
   uldat keyboard_slot, mouse_slot;
@@ -166,6 +169,29 @@ struct s_display_hw {
 
   uldat AttachSlot; /* slot of client that told us to attach to this display */
 
+  tcell *OldVideo;
+  /*
+   * what this display currently shows, if it needs OldVideo[] (FlHWNeedOldVideo).
+   * FlushHW() swaps it into the global OldVideo while calling this display's FlushVideo().
+   */
+  struct s_dirty_row *ChangedVideo;
+  /*
+   * areas of Video[] not yet sent to this display.
+   * FlushHW() swaps it into the global ChangedVideo while calling FlushVideo().
+   */
+  byte ValidOldVideo, ChangedVideoFlag;
+
+  timevalue FrameTime; /* when FlushHW() last sent a frame to this display */
+  tany FrameCost;      /* average time needed to send a frame, used for frame pacing */
+  uldat OutBacklog;    /* bytes sent by FlushHW() that the device did not consume yet */
+  uldat DrainRate;     /* bytes per second the device was seen to consume, 0 if unknown */
+
+  struct s_frame_thread *FrameThread;
+  /*
+   * the worker thread running FlushVideo() if FlHWThreadedFlushVideo is set,
+   * and the frame it is working on. managed by hw_multi.c
+   */
+
   dat XY[2]; /* hw-dependent cursor position */
   uldat TT;  /* hw-dependent cursor type */
 };
@@ -189,6 +215,7 @@ struct s_fn_display_hw {
 #define FlHWNeedOldVideo ((byte)0x04)
 #define FlHWExpensiveFlushVideo ((byte)0x08)
 #define FlHWNoInput ((byte)0x10)
+#define FlHWThreadedFlushVideo ((byte)0x20)
 
 /* DisplayHW->NeedHW */
 #define NEEDFlushStdout ((byte)0x01)
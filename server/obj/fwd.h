@@ -16,6 +16,10 @@
 typedef struct s_draw_ctx draw_ctx;
 typedef struct s_obj_parent *obj_parent;
 typedef struct s_ttydata ttydata;
+typedef struct s_ttyhist ttyhist;
+typedef struct s_rowindex rowindex;
+typedef struct s_rowslab rowslab;
+typedef struct s_backstore backstore;
 typedef struct s_remotedata remotedata;
 
 typedef struct s_obj *obj;
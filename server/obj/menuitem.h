@@ -27,6 +27,7 @@ struct s_menuitem {
   uldat Gap, LenGap;
   trune *Text;
   tcolor *ColText;
+  rowslab *Slab;
   /* menuitem */
   window Window;
   dat Left, ShortCut;
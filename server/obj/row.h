@@ -29,6 +29,7 @@ struct s_row {
   uldat Gap, LenGap;
   trune *Text;
   tcolor *ColText;
+  rowslab *Slab; /* if the row was carved from a rowslab */
 };
 
 struct s_fn_row {
@@ -52,4 +53,23 @@ struct s_fn_row {
 #define ROW_IGNORE ((byte)0x02)
 #define ROW_DEFCOL ((byte)0x04)
 
+/*
+ * rows appended in bulk by RowAppendTRune() are carved, with their text, from a rowslab
+ * of their window instead of being allocated one by one. a slab is freed when all its rows
+ * are deleted and its window has moved on to another slab.
+ * the text of a row leaves the slab as soon as it must grow, see EnsureLenRow().
+ */
+struct s_rowslab {
+  uldat Refs;           /* rows carved from the slab, plus one while it is the window's slab */
+  uldat NRow, MaxRow;   /* rows carved, room for rows */
+  uldat NText, MaxText; /* trunes carved, room for trunes */
+  struct s_row *Row;
+  trune *Text;
+  tcolor *ColText;
+};
+
+#define ROW_TEXT_IN_SLAB(Row)                                                                      \
+  ((Row)->Slab && (Row)->Text >= (Row)->Slab->Text &&                                              \
+   (Row)->Text < (Row)->Slab->Text + (Row)->Slab->MaxText)
+
 #endif /* _TWIN_ROW_H */
@@ -57,12 +57,15 @@ struct s_WR { /* for WINDOWFL_USEROWS windows */
   ldat NumRowOne, NumRowSplit; /*RESERVED: updated automatically by WriteRow. To insert */
                                /*or remove manually rows, you must zero out NumRowOne */
                                /*and NumRowSplit forcing twin to recalculate them */
+  rowindex *Index;             /* rows by number and by Code, see FindRow() */
+  rowslab *Slab;               /* where RowAppendTRune() carves new rows from */
 };
 
 struct s_WC { /* for WINDOWFL_USECONTENTS windows */
-  tcell *Contents;
+  tcell *Contents; /* visible lines, see hist.h */
   ttydata *TtyData;
-  ldat HSplit;
+  ldat HSplit;   /* index in Contents of the first visible line */
+  ttyhist *Hist; /* scrollback lines */
 };
 
 struct s_window {
@@ -107,6 +110,7 @@ struct s_window {
   dat MaxXWidth, MaxYWidth;
   ldat WLogic, HLogic;  /* window interior logic size */
   trune CONST *Charset; /* the byte -> trune translation to use */
+  backstore *Store;     /* cells as last drawn, see draw.h */
 };
 
 struct s_fn_window {
@@ -150,6 +154,7 @@ struct s_fn_window {
   byte (*RowWriteString)(window, uldat Len, CONST char *String);
   byte (*RowWriteTRune)(window, uldat Len, CONST trune *TRune);
   byte (*RowWriteTCell)(window, dat x, dat y, uldat Len, CONST tcell *Attr);
+  byte (*RowAppendTRune)(window, uldat Len, CONST trune *TRune);
 
   void (*GotoXY)(window, ldat X, ldat Y);
   void (*SetTitle)(window, dat titlelen, char *title);
@@ -195,6 +200,7 @@ typedef enum e_window_flag {
   WINDOWFL_ROWS_INSERT = 0x0100,
   WINDOWFL_ROWS_DEFCOL = 0x0200,
   WINDOWFL_ROWS_SELCURRENT = 0x0400,
+  WINDOWFL_BACKSTORE = 0x1000,
   WINDOWFL_NOTVISIBLE = 0x8000,
 } window_flag;
 
@@ -316,20 +316,75 @@ void RemotePidIsDead(pid_t pid) {
   }
 }
 
+/*
+ * fds of windows (i.e. of terminals) are served after all the others, so that
+ * keyboard, mouse and clients never wait behind a terminal flooding output.
+ * the focused window is served first and may read up to WINDOW_FD_FOCUS_BUDGET bytes
+ * per main loop iteration, the others are served round-robin with WINDOW_FD_BUDGET bytes each
+ * until WINDOW_FD_TIME has passed since the focused one started: the ones left are the first
+ * served at next iteration. the first of them is served anyway, so that a busy focused window
+ * cannot keep the others from ever being read.
+ */
+#define WINDOW_FD_BUDGET (16 * TW_BIGBUFF)
+#define WINDOW_FD_FOCUS_BUDGET (64 * TW_BIGBUFF)
+#define WINDOW_FD_TIME (10 MilliSECs)
+
+/* max bytes the handler of a window fd should read when called */
+uldat WindowFdBudget = WINDOW_FD_BUDGET;
+
+/* slot where round-robin restarts */
+static uldat WindowFdNext;
+
+INLINE byte IsWindowSlot(uldat Slot) {
+  return LS.HandlerData && IS_WINDOW(LS.HandlerData);
+}
+
+INLINE byte IsReadySlot(uldat Slot, fd_set *FdSet) {
+  return Slot < FdTop && LS.Fd >= 0 && FD_ISSET(LS.Fd, FdSet);
+}
+
 void RemoteEvent(int FdCount, fd_set *FdSet) {
-  uldat Slot;
-  int fd;
+  timevalue now, limit = {(tany)0, WINDOW_FD_TIME};
+  uldat Slot, Focus = NOSLOT, n;
+  byte served = tfalse;
+  widget W;
+
   for (Slot = 0; Slot < FdTop && FdCount; Slot++) {
-    if ((fd = LS.Fd) >= 0) {
-      if (FD_ISSET(fd, FdSet)) {
-        FdCount--;
-        if (LS.HandlerData)
-          LS.HandlerIO.D(fd, LS.HandlerData);
-        else
-          LS.HandlerIO.S(fd, Slot);
-      }
+    if (IsReadySlot(Slot, FdSet) && !IsWindowSlot(Slot)) {
+      FdCount--;
+      if (LS.HandlerData)
+        LS.HandlerIO.D(LS.Fd, LS.HandlerData);
+      else
+        LS.HandlerIO.S(LS.Fd, Slot);
     }
   }
+  if (!FdCount)
+    return;
+
+  IncrTime(&limit, InstantNow(&now));
+
+  if ((W = All->FirstScreen->FocusW) && IS_WINDOW(W) &&
+      IsReadySlot(Slot = ((window)W)->RemoteData.FdSlot, FdSet) && LS.HandlerData == (obj)W) {
+    Focus = Slot;
+    FdCount--;
+    WindowFdBudget = WINDOW_FD_FOCUS_BUDGET;
+    LS.HandlerIO.D(LS.Fd, LS.HandlerData);
+  }
+
+  WindowFdBudget = WINDOW_FD_BUDGET;
+  for (n = 0, Slot = WindowFdNext; n < FdTop && FdCount; n++, Slot++) {
+    if (Slot >= FdTop)
+      Slot = 0;
+    if (Slot == Focus || !IsReadySlot(Slot, FdSet) || !IsWindowSlot(Slot))
+      continue;
+    if (served && CmpTime(InstantNow(&now), &limit) >= 0)
+      /* out of time */
+      break;
+    served = ttrue;
+    FdCount--;
+    LS.HandlerIO.D(LS.Fd, LS.HandlerData);
+  }
+  WindowFdNext = Slot;
 }
 
 void RemoteParanoia(void) {
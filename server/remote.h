@@ -28,6 +28,7 @@ msgport RemoteGetMsgPort(uldat Slot);
 
 void RemoteFlushAll(void);
 void RemoteEvent(int FdNum, fd_set *FdSet);
+extern uldat WindowFdBudget;
 void RemoteParanoia(void);
 
 /*
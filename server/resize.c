@@ -36,6 +36,8 @@
 #include "printk.h"
 #include "resize.h"
 #include "util.h"
+#include "utf8.h"
+#include "hist.h"
 
 #include "hw.h"
 
@@ -119,11 +121,45 @@ byte CheckResizeWindowContents(window Window) {
   return ttrue;
 }
 
+/*
+ * Contents is a ring of at least SizeY lines, starting at Data->Start:
+ * if only the height changes and the ring is large enough, just move Data->Start.
+ */
+static void ResizeContentsHeight(window Window, dat y, tcell h) {
+  ttydata *Data = Window->USE.C.TtyData;
+  ttyhist *Hist = Window->USE.C.Hist;
+  tcell *line = Data->Start, *base = Window->USE.C.Contents;
+  ldat x = Window->WLogic, i;
+  dat kept = Data->SizeY;
+
+  /* lines that no longer fit above the cursor go to the scrollback */
+  for (i = Data->Y + 1 - y; i > 0; i--, kept--) {
+    if (Hist)
+      PushHist(Hist, line);
+    if ((line += x) >= Data->Split)
+      line = base;
+  }
+  Data->Start = line;
+
+  /* new lines at the bottom are blank */
+  if (kept < y) {
+    if ((line += kept * x) >= Data->Split)
+      line -= Data->Split - base;
+    for (; kept < y; kept++) {
+      for (i = 0; i < x; i++)
+        line[i] = h;
+      if ((line += x) >= Data->Split)
+        line = base;
+    }
+  }
+}
+
 byte ResizeWindowContents(window Window) {
   tcell *NewCont, *saveNewCont, *OldCont, *max, h;
-  ldat count, common, left;
+  ldat count, common, left, rows;
   ttydata *Data = Window->USE.C.TtyData;
-  dat x = Window->XWidth, y = Window->YWidth + Data->ScrollBack;
+  ttyhist *Hist = Window->USE.C.Hist;
+  dat x = Window->XWidth, y = Window->YWidth;
 
   if (!(Window->Flags & WINDOWFL_BORDERLESS))
     x -= 2, y -= 2;
@@ -131,26 +167,32 @@ byte ResizeWindowContents(window Window) {
   h = TCELL(Window->ColText, ' ');
 
   /* safety check: */
-  if (x > 0 && y > 0) {
+  if (x > 0 && y > 0 && Window->USE.C.Contents && x == Window->WLogic &&
+      (rows = (Data->Split - Window->USE.C.Contents) / x) >= y) {
+
+    ResizeContentsHeight(Window, y, h);
+    saveNewCont = Window->USE.C.Contents;
+
+  } else if (x > 0 && y > 0) {
     if (!(saveNewCont = NewCont = (tcell *)AllocMem(x * y * sizeof(tcell))))
       return tfalse;
+    rows = y;
 
     /*
-     * copy the Contents. Quite non-trivial for two reasons:
-     * 1. always preserve the cursor line
-     * 2. copy as much scrollback as possible
+     * copy the visible lines, always preserving the cursor line:
+     * the ones that no longer fit above it go to the scrollback.
      */
-    if ((max = OldCont = Window->USE.C.Contents)) {
-      max += Window->WLogic * Window->HLogic;
+    if ((OldCont = Window->USE.C.Contents)) {
+      max = Data->Split;
       common = Min2(Window->WLogic, x);
-      count = Min2(Window->HLogic, y);
-      OldCont += Window->USE.C.HSplit * Window->WLogic;
-
-      /* ok, now check for the cursor line */
-      if (Window->CurY >= y) {
-        OldCont += (Window->CurY + 1 - y) * Window->WLogic;
-        if (OldCont > max)
-          OldCont -= Window->WLogic * Window->HLogic;
+      count = Min2(Data->SizeY, y);
+      OldCont = Data->Start;
+
+      for (left = Data->Y + 1 - y; left > 0; left--) {
+        if (Hist)
+          PushHist(Hist, OldCont);
+        if ((OldCont += Window->WLogic) >= max)
+          OldCont = Window->USE.C.Contents;
       }
 
       while (count--) {
@@ -168,35 +210,51 @@ byte ResizeWindowContents(window Window) {
     left = (saveNewCont + x * y) - NewCont;
     while (left--)
       *NewCont++ = h;
+
+    Data->Start = saveNewCont;
+
+    if (Hist && !ResizeHist(Hist, x, h)) {
+      /* cannot keep the scrollback at the new width */
+      DeleteHist(Hist);
+      Window->USE.C.Hist = NULL;
+      Data->ScrollBack = 0;
+    }
   } else {
     x = y = 0;
+    rows = 0;
     if (Window->USE.C.Contents)
       FreeMem(Window->USE.C.Contents);
-    saveNewCont = NULL;
+    saveNewCont = Data->Start = NULL;
   }
 
   Window->XLogic = 0;
   Window->YLogic = Data->ScrollBack;
-  Window->WLogic = x;       /* Contents width */
-  Window->HLogic = y;       /* Y visible + scrollback */
-  Window->USE.C.HSplit = 0; /* splitline == 0 */
+  Window->WLogic = x;                             /* Contents width */
+  Window->HLogic = y ? y + Data->ScrollBack : 0; /* Y visible + scrollback */
   Window->USE.C.Contents = saveNewCont;
+  Window->USE.C.HSplit = x ? (Data->Start - saveNewCont) / x : 0;
 
-  if (Window->CurY >= y)
-    Window->CurY = y - 1;
+  if (Window->CurX >= Window->WLogic)
+    Window->CurX = Max2(Window->WLogic - 1, 0);
+  if (Window->CurY >= Window->HLogic)
+    Window->CurY = Window->HLogic - 1;
   else if (Window->CurY < Window->YLogic)
     Window->CurY = Window->YLogic;
 
   Data->SizeX = x;
-  Data->SizeY = Window->YWidth - 2;
+  Data->SizeY = y;
   Data->Top = 0;
   Data->Bottom = Data->SizeY;
 
-  Data->Start = Window->USE.C.Contents + x * Data->ScrollBack;
-  Data->Split = Window->USE.C.Contents + x * y;
+  Data->Split = Window->USE.C.Contents + x * rows;
   Data->saveX = Data->X = Window->CurX;
   Data->saveY = Data->Y = Window->CurY - Data->ScrollBack;
-  Data->Pos = Window->USE.C.Contents + Window->CurY * x + Window->CurX;
+  Data->Pos = Data->Start + Data->Y * x + Window->CurX;
+  if (Data->Pos >= Data->Split)
+    Data->Pos -= Data->Split - Window->USE.C.Contents;
+  /* everything is redrawn below */
+  Data->DirtyY1 = 0;
+  Data->DirtyY2 = -1;
 
   if (!(Window->Attrib & WINDOW_WANT_CHANGES) && Window->USE.C.TtyData &&
       Window->RemoteData.FdSlot != NOSLOT)
@@ -236,7 +294,23 @@ byte EnsureLenRow(row Row, uldat Len, byte DefaultCol) {
 
   if (Len > Row->MaxLen) {
     NewLen = (Len + (Len >> 1)) | All->SetUp->MinAllocSize;
-    if ((tempText = (trune *)ReAllocMem(Row->Text, NewLen * sizeof(trune)))) {
+    if (ROW_TEXT_IN_SLAB(Row)) {
+      /* the slab has no room to grow into: move the text out of it */
+      if (!(tempText = (trune *)AllocMem(NewLen * sizeof(trune))))
+        return tfalse;
+      tempColText = NULL;
+      if (!(Row->Flags & ROW_DEFCOL) && !DefaultCol &&
+          !(tempColText = (tcolor *)AllocMem(NewLen * sizeof(tcolor)))) {
+        FreeMem(tempText);
+        return tfalse;
+      }
+      CopyMem(Row->Text, tempText, Row->Len * sizeof(trune));
+      if (tempColText && Row->ColText)
+        CopyMem(Row->ColText, tempColText, Row->Len * sizeof(tcolor));
+      Row->Text = tempText;
+      Row->ColText = tempColText;
+      Row->MaxLen = NewLen;
+    } else if ((tempText = (trune *)ReAllocMem(Row->Text, NewLen * sizeof(trune)))) {
       if (!(Row->Flags & ROW_DEFCOL) && !DefaultCol) {
         if ((tempColText = (tcolor *)ReAllocMem(Row->ColText, NewLen * sizeof(tcolor))))
           Row->ColText = tempColText;
@@ -253,7 +327,6 @@ byte EnsureLenRow(row Row, uldat Len, byte DefaultCol) {
 
 byte RowWriteAscii(window Window, uldat Len, CONST char *Text) {
   row CurrRow;
-  CONST char *_Text;
   byte ModeInsert;
   trune CONST *to_UTF_32;
   ldat x, y, max;
@@ -282,10 +355,12 @@ byte RowWriteAscii(window Window, uldat Len, CONST char *Text) {
       CurrRow = Act(FindRow, Window)(Window, y);
     }
 
-    RowLen = 0;
-    _Text = Text;
-    while (RowLen < Len && *_Text != '\n' && *_Text != '\r')
-      ++RowLen, ++_Text;
+    /* skip runs of printable ASCII in bulk, then check the byte that stopped them */
+    for (RowLen = 0; RowLen < Len; RowLen++) {
+      RowLen += Utf8AsciiRun((CONST byte *)Text + RowLen, Len - RowLen);
+      if (RowLen >= Len || Text[RowLen] == '\n' || Text[RowLen] == '\r')
+        break;
+    }
 
     /*	WINDOWFL_INSERT non implementato */
     /*  Gap non implementato				 */
@@ -437,6 +512,65 @@ byte RowWriteTRune(window Window, uldat Len, CONST trune *Text) {
   return ttrue;
 }
 
+/*
+ * append the lines in Text, separated by '\n', after the last row of Window
+ * and move the cursor to the start of the row after them.
+ * the rows and their text are carved from the rowslab of Window,
+ * and the whole block is drawn at once.
+ */
+byte RowAppendTRune(window Window, uldat Len, CONST trune *Text) {
+  rowslab *Slab;
+  row CurrRow;
+  CONST trune *End, *Line, *Eol;
+  uldat NumRows, RowLen, MaxLen = 0;
+  ldat y;
+  byte DefaultCol;
+
+  if (!Window || !Len || !Text || !W_USE(Window, USEROWS))
+    return tfalse;
+
+  /* a final '\n' does not start another line */
+  End = Text + Len;
+  for (NumRows = 0, Line = Text; Line < End; Line = Eol + 1, NumRows++)
+    for (Eol = Line; Eol < End && *Eol != '\n'; Eol++)
+      ;
+
+  if (!(Slab = GetRowSlab(Window, NumRows, Len)))
+    return tfalse;
+
+  y = Window->HLogic;
+  DefaultCol = Window->Flags & WINDOWFL_ROWS_DEFCOL;
+
+  for (Line = Text; Line < End; Line = Eol + 1) {
+    for (Eol = Line; Eol < End && *Eol != '\n'; Eol++)
+      ;
+    RowLen = Eol - Line;
+    if (!(CurrRow = CreateSlabRow(Slab, 0, ROW_ACTIVE, RowLen, DefaultCol)))
+      break;
+    if (RowLen) {
+      CopyMem(Line, CurrRow->Text, RowLen * sizeof(trune));
+      if (CurrRow->ColText)
+        memset(CurrRow->ColText, Window->ColText, RowLen * sizeof(tcolor));
+      CurrRow->Len = RowLen;
+      MaxLen = Max2(MaxLen, RowLen);
+    }
+    Act(Insert, CurrRow)(CurrRow, Window, Window->USE.R.LastRow, NULL);
+  }
+
+  if (Window->HLogic > y) {
+    if (MaxLen)
+      DrawLogicWidget((widget)Window, 0, y, (ldat)MaxLen - 1, Window->HLogic - 1);
+    DrawBorderWindow(Window, BORDER_RIGHT);
+  }
+  Window->CurX = (ldat)0;
+  Window->CurY = Window->HLogic;
+
+  if (Window == FindCursorWindow())
+    UpdateCursor();
+
+  return Line >= End;
+}
+
 void ExposeWidget2(widget W, dat XWidth, dat YWidth, dat Left, dat Up, dat Pitch, CONST char *Text,
                    CONST trune *Font, CONST tcell *Attr) {
   if (w_USE(W, USEEXPOSE)) {
@@ -670,6 +804,7 @@ void ResizeFirstScreen(dat DeltaY) {
   Rgt = DWidth - 1;
   Dwn = DHeight - 1 - Max2((ldat)DeltaY, 0);
   Screen->YLimit += DeltaY;
+  InvalidateVisibleRegions();
 
   if (DeltaY < 0) {
     if (Up <= Dwn)
@@ -806,6 +941,7 @@ void DragFirstWindow(dat i, dat j) {
 
   Window->Left += i;
   Window->Up += j;
+  InvalidateVisibleRegions();
 
   if (Shade)
     /* update the window's shadow */
@@ -1086,6 +1222,7 @@ void ResizeRelFirstWindow(dat i, dat j) {
     Dwn += DeltaY;
   }
   if (DeltaX || DeltaY) {
+    InvalidateVisibleRegions();
     DrawBorderWindow(Window, BORDER_ANY);
     if (Window == (window)Screen->FocusW)
       UpdateCursor();
@@ -1205,6 +1342,10 @@ void ScrollFirstWindowArea(dat X1, dat Y1, dat X2, dat Y2, ldat DeltaX, ldat Del
   if (X1 > X2 || X1 > XWidth - 3 || X2 < 0 || Y1 > Y2 || Y1 > YWidth - 3 || Y2 < 0)
     return;
 
+  /* scroll the backing store too, including the parts of the area not on the display */
+  ScrollBackStore(Window, (ldat)X1 + 1, (ldat)Y1 + 1, Min2((ldat)X2, XWidth - 3) + 1,
+                  Min2((ldat)Y2, YWidth - 3) + 1, DeltaX, DeltaX ? 0 : DeltaY);
+
   if (DeltaX >= XWidth || -DeltaX >= XWidth || DeltaY >= YWidth || -DeltaY >= YWidth) {
     DrawWidget((widget)Window, (dat)0, (dat)0, TW_MAXDAT, TW_MAXDAT, tfalse);
     return;
@@ -1761,10 +1902,7 @@ void RaiseWidget(widget W, byte alsoFocus) {
 
     if (Screen->FirstW != W) {
       MoveFirst(W, (widget)Screen, W);
-      if (IS_WINDOW(W))
-        DrawAreaWindow2((window)W);
-      else
-        DrawAreaWidget(W);
+      DrawRestackedWidget(W);
     }
     if (Screen == All->FirstScreen) {
       if (alsoFocus)
@@ -1785,10 +1923,7 @@ void LowerWidget(widget W, byte alsoUnFocus) {
 
     if (Screen->LastW != W) {
       MoveLast(W, (widget)Screen, W);
-      if (IS_WINDOW(W))
-        DrawAreaWindow2((window)W);
-      else
-        DrawAreaWidget(W);
+      DrawRestackedWidget(W);
     }
     if (Screen == All->FirstScreen) {
       if (alsoUnFocus) {
@@ -12,6 +12,7 @@
 byte EnsureLenRow(row Row, uldat Len, byte DefaultCol);
 byte RowWriteAscii(window Window, uldat Len, CONST char *Text);
 byte RowWriteTRune(window Window, uldat Len, CONST trune *Text);
+byte RowAppendTRune(window Window, uldat Len, CONST trune *Text);
 
 void ExposeWidget2(widget W, dat XWidth, dat YWidth, dat Left, dat Up, dat Pitch, CONST char *Text,
                    CONST trune *Font, CONST tcell *Attr);
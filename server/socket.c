@@ -369,6 +369,7 @@ static void sockWriteAsciiWindow(window Window, uldat Len, CONST char *Ascii);
 static void sockWriteStringWindow(window Window, uldat Len, CONST char *String);
 static void sockWriteTRuneWindow(window Window, uldat Len, CONST trune *TRune);
 static void sockWriteTCellWindow(window Window, dat x, dat y, uldat Len, CONST tcell *Attr);
+static void sockAppendRowsWindow(window Window, uldat Len, CONST trune *TRune);
 static void sockSetTitleWindow(window Window, dat titlelen, CONST char *title);
 
 static row sockFindRowByCodeWindow(window Window, dat Code);
@@ -1249,6 +1250,11 @@ static void sockWriteTCellWindow(window Window, dat x, dat y, uldat Len, CONST t
   }
 }
 
+static void sockAppendRowsWindow(window Window, uldat Len, CONST trune *TRune) {
+  if (Window && (Window->Flags & WINDOWFL_USEANY) == WINDOWFL_USEROWS)
+    Act(RowAppendTRune, Window)(Window, Len, TRune);
+}
+
 static void sockSetTitleWindow(window Window, dat titlelen, CONST char *title) {
   char *_title = NULL;
 
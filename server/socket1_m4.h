@@ -271,6 +271,12 @@ case order_WriteTCellWindow:
     break;
 
 
+case order_AppendRowsWindow:
+    if (N >= 3)
+	sockAppendRowsWindow((window)a[1]_obj, (uldat)a[2]_any, (CONST trune *)a[3]_vec);
+    break;
+
+
 case order_GotoXYWindow:
     if (N >= 3)
 	Act(GotoXY,(window)a[1]_obj)((window)a[1]_obj, (ldat)a[2]_any, (ldat)a[3]_any);
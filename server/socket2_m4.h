@@ -154,6 +154,9 @@
 { 0, 0, "WriteTCellWindow",
     "0" "v" TWS_void_STR"x" window_magic_STR"_" TWS_dat_STR"_" TWS_dat_STR"_" TWS_uldat_STR"V" TWS_tcell_STR },
 
+{ 0, 0, "AppendRowsWindow",
+    "0" "v" TWS_void_STR"x" window_magic_STR"_" TWS_uldat_STR"V" TWS_trune_STR },
+
 { 0, 0, "GotoXYWindow",
     "2" "v" TWS_void_STR"x" window_magic_STR"_" TWS_ldat_STR"_" TWS_ldat_STR },
 { 0, 0, "SetTitleWindow",
@@ -282,7 +282,8 @@ static byte sockStatWindow(window x, tsfield TSF) {
   default:
     if (W_USE((window)x, USECONTENTS)) {
       switch (TSF->hash) {
-        TWScasevecUSE(window, C, Contents, tcell, x->WLogic * x->HLogic);
+        /* the whole ring of lines, which may have more than SizeY of them */
+        TWScasevecUSE(window, C, Contents, tcell, x->USE.C.TtyData->Split - x->USE.C.Contents);
         TWScaseUSE(window, C, HSplit, ldat);
       default:
         return tfalse;
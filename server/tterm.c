@@ -11,12 +11,16 @@
  */
 
 #include "twin.h"
+#include "algo.h"
 #include "alloc.h"
 #include "extreg.h"
 #include "data.h"
 #include "methods.h"
+#include "draw.h"
 #include "obj/id.h" // Id2Obj()
 
+#include "main.h"
+#include "fdlist.h"
 #include "remote.h"
 #include "pty.h"
 #include "util.h"
@@ -31,15 +35,22 @@ static char *default_args[3];
 
 static msgport Term_MsgPort;
 
+extern fdlist *FdList;
+extern uldat FdTop;
+#define LS FdList[Slot]
+
 static void TwinTermH(msgport MsgPort);
 static void TwinTermIO(int Fd, window Window);
 
+static void TermPasteForget(window Window);
+
 static void termShutDown(widget W) {
   window Window;
   if (IS_WINDOW(W)) {
     Window = (window)W;
     if (Window->RemoteData.Fd != NOFD)
       close(Window->RemoteData.Fd);
+    TermPasteForget(Window);
     UnRegisterWindowFdIO(Window);
   }
 }
@@ -50,7 +61,7 @@ static window newTermWindow(CONST char *title) {
   Window = Do(Create, Window)(
       FnWindow, Term_MsgPort, strlen(title), title, NULL, Term_Menu, COL(WHITE, BLACK), LINECURSOR,
       WINDOW_WANT_KEYS | WINDOW_DRAG | WINDOW_RESIZE | WINDOW_Y_BAR | WINDOW_CLOSE,
-      WINDOWFL_CURSOR_ON | WINDOWFL_USECONTENTS,
+      WINDOWFL_CURSOR_ON | WINDOWFL_USECONTENTS | WINDOWFL_BACKSTORE,
       /*width*/ 80, /*height*/ 25, /*scrollbacklines*/ 1000);
 
   if (Window) {
@@ -96,18 +107,88 @@ static window OpenTerm(CONST char *arg0, CONST char *CONST *argv) {
   return NULL;
 }
 
-static void TermWriteTRuneWindow(window W, uldat len, CONST trune *hwData) {
+/*
+ * pasting a selection: instead of converting and queuing it all at once,
+ * keep the MSG_SELECTIONNOTIFY holding it and queue TW_BIGBUFF bytes at time,
+ * each time the previous ones have been written to the pty.
+ * pastes not written yet are a list in the PrivateData of the window slot.
+ */
+typedef struct s_termpaste termpaste;
+struct s_termpaste {
+  termpaste *Next;
+  msg Msg;
+  uldat Off; /* trunes or bytes of Msg already queued */
+};
+
+/* called by RemoteFlush() after writing the queue of Slot */
+static void TermPasteMore(uldat Slot) {
+  static byte buf[TW_BIGBUFF];
+  window W = (window)LS.HandlerData;
   trune (*inv_charset)(trune) = W->USE.C.TtyData->InvCharset;
-  byte *Data, *sData;
-  uldat n;
+  event_selectionnotify *Event;
+  termpaste *P;
+  CONST trune *text;
+  uldat n, i, len;
+
+  while (LS.WQlen < TW_BIGBUFF && (P = (termpaste *)LS.PrivateData)) {
+    Event = &P->Msg->Event.EventSelectionNotify;
+    if (Event->Magic == SEL_TRUNEMAGIC) {
+      len = Event->Len / sizeof(trune);
+      n = Min2(len - P->Off, TW_BIGBUFF);
+      text = (CONST trune *)Event->Data + P->Off;
+      for (i = 0; i < n; i++)
+        buf[i] = (byte)inv_charset(text[i]);
+      if (n && !RemoteWriteQueue(Slot, n, buf))
+        break;
+    } else {
+      len = Event->Len;
+      n = Min2(len - P->Off, TW_BIGBUFF);
+      if (n && !RemoteWriteQueue(Slot, n, Event->Data + P->Off))
+        break;
+    }
+    if ((P->Off += n) >= len) {
+      LS.PrivateData = P->Next;
+      Delete(P->Msg);
+      FreeMem(P);
+    }
+  }
+  if (LS.WQlen)
+    /* wake up when the pty can take it */
+    FD_SET(LS.Fd, &save_wfds);
+  if (!LS.PrivateData)
+    LS.PrivateAfterFlush = NULL;
+}
+
+/* queue Msg for pasting into W. return tfalse if it must be deleted by the caller */
+static byte TermPaste(window W, msg Msg) {
+  uldat Slot = W->RemoteData.FdSlot;
+  termpaste *P, **pP;
+
+  if (Slot >= FdTop || LS.Fd == NOFD || !(P = (termpaste *)AllocMem(sizeof(termpaste))))
+    return tfalse;
+  P->Next = NULL;
+  P->Msg = Msg;
+  P->Off = 0;
+  for (pP = (termpaste **)&LS.PrivateData; *pP; pP = &(*pP)->Next)
+    ;
+  *pP = P;
+  LS.PrivateAfterFlush = TermPasteMore;
+  TermPasteMore(Slot);
+  return ttrue;
+}
 
-  if ((Data = sData = (byte *)AllocMem(n = len))) {
-    while (n--)
-      *Data++ = (byte)inv_charset(*hwData++);
+static void TermPasteForget(window W) {
+  uldat Slot = W->RemoteData.FdSlot;
+  termpaste *P;
 
-    RemoteWindowWriteQueue(W, len, sData);
-    FreeMem(sData);
+  if (Slot >= FdTop || LS.Fd == NOFD)
+    return;
+  while ((P = (termpaste *)LS.PrivateData)) {
+    LS.PrivateData = P->Next;
+    Delete(P->Msg);
+    FreeMem(P);
   }
+  LS.PrivateAfterFlush = NULL;
 }
 
 static void TwinTermH(msgport MsgPort) {
@@ -136,14 +217,10 @@ static void TwinTermH(msgport MsgPort) {
 
     } else if (Msg->Type == MSG_SELECTIONNOTIFY) {
 
-      if ((Win = (window)Id2Obj(window_magic_id, Event->EventSelectionNotify.ReqPrivate))) {
-        if (Event->EventSelectionNotify.Magic == SEL_TRUNEMAGIC)
-          TermWriteTRuneWindow(Win, Event->EventSelectionNotify.Len / sizeof(trune),
-                               (trune *)Event->EventSelectionNotify.Data);
-        else
-          (void)RemoteWindowWriteQueue(Win, Event->EventSelectionNotify.Len,
-                                       Event->EventSelectionNotify.Data);
-      }
+      if ((Win = (window)Id2Obj(window_magic_id, Event->EventSelectionNotify.ReqPrivate)) &&
+          IS_WINDOW(Win) && TermPaste(Win, Msg))
+        /* Msg now belongs to the paste */
+        Msg = NULL;
     } else if (Msg->Type == MSG_WIDGET_MOUSE) {
       if (Win) {
         char buf[10];
@@ -178,25 +255,39 @@ static void TwinTermH(msgport MsgPort) {
           OpenTerm(NULL, NULL);
       }
     }
-    Delete(Msg);
+    if (Msg)
+      Delete(Msg);
   }
 }
 
 static void TwinTermIO(int Fd, window Window) {
   static char buf[TW_BIGBUFF];
-  uldat got = 0, chunk = 0;
+  uldat got, chunk = 0, left = WindowFdBudget;
 
+  /* read up to WindowFdBudget bytes, the budget RemoteEvent() gives to each window */
   do {
+    got = 0;
+    do {
+      /*
+       * TW_BIGBUFF - 1 to avoid silly windows...
+       * linux ttys buffer up to 4095 bytes.
+       */
+      chunk = read(Fd, buf + got, TW_BIGBUFF - 1 - got);
+    } while (chunk && chunk != (uldat)-1 && (got += chunk) < TW_BIGBUFF - 1);
+
+    if (!got)
+      break;
     /*
-     * TW_BIGBUFF - 1 to avoid silly windows...
-     * linux ttys buffer up to 4095 bytes.
+     * a full buffer means more output is coming: do not draw it now,
+     * the main loop will when a display frame is due or the pty gets idle
      */
-    chunk = read(Fd, buf + got, TW_BIGBUFF - 1 - got);
-  } while (chunk && chunk != (uldat)-1 && (got += chunk) < TW_BIGBUFF - 1);
-
-  if (got)
+    TtyDeferDraw = got == TW_BIGBUFF - 1;
     Act(TtyWriteAscii, Window)(Window, got, buf);
-  else if (chunk == (uldat)-1 && errno != EINTR && errno != EWOULDBLOCK)
+    TtyDeferDraw = tfalse;
+    left -= Min2(left, got);
+  } while (got == TW_BIGBUFF - 1 && left);
+
+  if (!got && chunk == (uldat)-1 && errno != EINTR && errno != EWOULDBLOCK)
     /* something bad happened to our child :( */
     Delete(Window);
 }
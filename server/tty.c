@@ -27,12 +27,15 @@
 #include "hw.h"
 #include "common.h"
 #include "tty.h"
+#include "hist.h"
 
 #include <Tw/Tw.h>
 #include <Tw/Twstat.h>
 #include <Tw/Twstat_defs.h>
 #include <Tutf/Tutf.h>
 
+#include "utf8.h"
+
 /*
  * VT102 emulator
  */
@@ -45,10 +48,6 @@ static udat *Flags;
 /* enable keypad by default */
 static udat kbdFlags = TTY_KBDAPPLIC | TTY_AUTOWRAP, defaultFlags = TTY_KBDAPPLIC | TTY_AUTOWRAP;
 
-static dat dirty[2][4];
-static ldat dirtyS[2];
-static byte dirtyN;
-
 #define ColText Win->ColText
 #define DState Data->State
 #define Effects Data->Effects
@@ -65,6 +64,10 @@ static byte dirtyN;
 #define Start Data->Start
 #define Split Data->Split
 #define Pos Data->Pos
+#define DirtyX1 Data->DirtyX1
+#define DirtyX2 Data->DirtyX2
+#define DirtyY1 Data->DirtyY1
+#define DirtyY2 Data->DirtyY2
 #define Color Data->Color
 #define DefColor Data->DefColor
 #define saveColor Data->saveColor
@@ -105,62 +108,73 @@ static byte dirtyN;
       *Flags &= ~(bit);                                                                            \
   } while (0)
 
+/* mark rows y1 ... y2 as clean, when they enter the DirtyY1 ... DirtyY2 range */
+INLINE void clean_rows(dat y1, dat y2) {
+  for (; y1 <= y2; y1++) {
+    DirtyX1[y1] = TW_MAXDAT;
+    DirtyX2[y1] = -1;
+  }
+}
+
 /*
+ * damage is kept as a span of columns for each row, merged in flush_tty()
+ * into as few rectangles as possible.
+ * if there is no room for the spans, whole rows DirtyY1 ... DirtyY2 are redrawn.
+ *
  * for better cleannes, dirty_tty()
  * should be used *before* actually touching Win->Contents[]
  */
 static void dirty_tty(dat x1, dat y1, dat x2, dat y2) {
-  byte i;
-  ldat S[2] = {0, 0};
-  dat xy[2][4];
+  dat *d;
 
-  if (dirtyN == TW_MAXBYTE || x1 > x2 || x1 >= SizeX || y1 > y2 || y1 >= SizeY)
+  if (x1 > x2 || x1 >= SizeX || y1 > y2 || y1 >= SizeY)
     return;
 
   x2 = Min2(x2, SizeX - 1);
   y2 = Min2(y2, SizeY - 1);
 
-  for (i = 0; i < dirtyN; i++) {
-    xy[i][0] = Min2(dirty[i][0], x1);
-    xy[i][1] = Min2(dirty[i][1], y1);
-    xy[i][2] = Max2(dirty[i][2], x2);
-    xy[i][3] = Max2(dirty[i][3], y2);
-    S[i] += (xy[0][2] - xy[0][0] + 1) * (xy[0][3] - xy[0][1] + 1);
-    S[!i] += dirtyS[i];
+  if (DirtyY1 > DirtyY2) {
+    if (Data->DirtyMax < SizeY && (d = (dat *)ReAllocMem(DirtyX1, 2 * SizeY * sizeof(dat)))) {
+      DirtyX1 = d;
+      DirtyX2 = d + SizeY;
+      Data->DirtyMax = SizeY;
+    }
+    DirtyY1 = y1;
+    DirtyY2 = y2;
+    if (Data->DirtyMax < SizeY)
+      return;
+    clean_rows(y1, y2);
+  } else {
+    if (y1 < DirtyY1) {
+      if (Data->DirtyMax >= SizeY)
+        clean_rows(y1, DirtyY1 - 1);
+      DirtyY1 = y1;
+    }
+    if (y2 > DirtyY2) {
+      if (Data->DirtyMax >= SizeY)
+        clean_rows(DirtyY2 + 1, y2);
+      DirtyY2 = y2;
+    }
+    if (Data->DirtyMax < SizeY)
+      return;
   }
-  if (dirtyN < 2)
-    S[dirtyN] += (x2 - x1 + 1) * (y2 - y1 + 1);
 
-  i = dirtyN && S[0] > S[1];
-
-  if (S[i] >= SizeX * SizeY * 3 / 4) {
-    dirtyN = TW_MAXBYTE;
-    return;
-  } else if (i < dirtyN) {
-    CopyMem(xy[i], dirty[i], 4 * sizeof(dat));
-  } else {
-    dirtyN++;
-    dirty[i][0] = x1;
-    dirty[i][1] = y1;
-    dirty[i][2] = x2;
-    dirty[i][3] = y2;
+  for (; y1 <= y2; y1++) {
+    DirtyX1[y1] = Min2(DirtyX1[y1], x1);
+    DirtyX2[y1] = Max2(DirtyX2[y1], x2);
   }
-  dirtyS[i] = (dirty[i][2] - dirty[i][0] + 1) * (dirty[i][3] - dirty[i][1] + 1);
 }
 
 static void flush_tty(void) {
   byte doupdate = tfalse;
-  dat i;
 
-  /* first, draw on screen whatever changed in the window */
-  if (dirtyN) {
-    if (dirtyN == TW_MAXBYTE)
-      DrawLogicWidget((widget)Win, 0, ScrollBack, SizeX - 1, SizeY - 1 + ScrollBack);
-    else
-      for (i = 0; i < dirtyN; i++)
-        DrawLogicWidget((widget)Win, dirty[i][0], dirty[i][1] + ScrollBack, dirty[i][2],
-                        dirty[i][3] + ScrollBack);
-    dirtyN = 0;
+  /* first, draw on screen whatever changed in the window... unless asked to do it later */
+  if (!TtyDeferDraw)
+    DrawTtyDamage(Win);
+  else if (DirtyY1 <= DirtyY2 && !Data->DirtyQueued) {
+    Data->DirtyQueued = ttrue;
+    Data->DirtyNext = TtyDirty;
+    TtyDirty = Win;
   }
 
   /* then update cursor */
@@ -168,7 +182,7 @@ static void flush_tty(void) {
 
     Win->CurX = (ldat)X;
     Win->CurY = (ldat)Y + ScrollBack;
-    Pos = Base + Win->CurX + (Win->CurY + Win->USE.C.HSplit) * SizeX;
+    Pos = Start + X + (ldat)Y * SizeX;
     if (Pos >= Split)
       Pos -= Split - Base;
 
@@ -350,6 +364,7 @@ static void fill(tcell *s, tcell c, ldat len) {
 
 static void scrollup(dat t, dat b, dat nr) {
   tcell *d, *s;
+  dat i;
   byte accel = tfalse;
 
   if (t + nr >= b)
@@ -357,23 +372,26 @@ static void scrollup(dat t, dat b, dat nr) {
   if (b > SizeY || t >= b || nr < 1)
     return;
 
-  /* try to accelerate this */
-  if ((widget)Win == All->FirstScreen->FirstW) {
+  /* try to accelerate this, unless drawing is deferred anyway */
+  if (!TtyDeferDraw && (widget)Win == All->FirstScreen->FirstW) {
     accel = ttrue;
     flush_tty();
   } else
     dirty_tty(0, t, SizeX - 1, b - 1);
 
   if (t == 0 && b == SizeY) {
-    /* full screen scrolls. use splitline+scrollback */
-
-    Win->USE.C.HSplit += nr;
-    if (Win->USE.C.HSplit >= Win->HLogic)
-      Win->USE.C.HSplit -= Win->HLogic;
+    /* full screen scrolls. move the top lines to the scrollback, then reuse them */
+    if (Win->USE.C.Hist)
+      for (d = Start, i = 0; i < nr; i++) {
+        PushHist(Win->USE.C.Hist, d);
+        if ((d += SizeX) >= Split)
+          d = Base;
+      }
 
     Start += nr * SizeX;
     if (Start >= Split)
       Start -= Split - Base;
+    Win->USE.C.HSplit = (Start - Base) / SizeX;
 
     Pos += nr * SizeX;
     if (Pos >= Split)
@@ -405,8 +423,8 @@ static void scrolldown(dat t, dat b, dat nr) {
   if (b > SizeY || t >= b || nr < 1)
     return;
 
-  /* try to accelerate this */
-  if ((widget)Win == All->FirstScreen->FirstW) {
+  /* try to accelerate this, unless drawing is deferred anyway */
+  if (!TtyDeferDraw && (widget)Win == All->FirstScreen->FirstW) {
     accel = ttrue;
     flush_tty();
   } else
@@ -476,7 +494,7 @@ static void csi_J(int vpar) {
   switch (vpar) {
   case 0: /* erase from cursor to end of display */
     dirty_tty(0, Y, SizeX - 1, SizeY - 1);
-    count = (SizeY - Y) * (ldat)SizeX + SizeX - X;
+    count = (SizeY - Y) * (ldat)SizeX - X;
     start = Pos;
     break;
   case 1: /* erase from start to cursor */
@@ -994,434 +1012,737 @@ static void clear_newtitle(void) {
   newLen = newMax = 0;
 }
 
-INLINE void write_ctrl(byte c) {
-  /*
-   *  Control characters can be used in the _middle_
-   *  of an escape sequence.
-   */
-  switch (c) {
-  case 0:
-    return;
-  case 7:
-    if (DState != ESxterm_ignore && DState != ESxterm_title) {
-      BeepHW();
-      return;
-    }
-    if (DState == ESxterm_title)
-      set_newtitle();
-    DState = ESnormal;
-    return;
-  case 8:
-    bs();
-    return;
-  case 9: /* TAB */
-    Pos -= X;
-    while (X < SizeX - 1) {
-      X++;
-      if (TabStop[X >> 5] & (1 << (X & 31)))
-        break;
-    }
-    Pos += X;
+/*
+ * escape sequences are parsed with tables, in the style of DEC-compatible parsers:
+ *
+ * tty_ctrl_class[c] is the action of control character c, executed in any state.
+ * otherwise tty_state[DState] consumes c and returns the next state: ESC and CSI
+ * sequences look up the action of their final character in tty_esc_class[]
+ * and tty_csi_class[]. the tables are generated at compile time by TTY_TABLE().
+ */
+#define TTY_ROW(F, c)                                                                              \
+  F(c), F(c + 1), F(c + 2), F(c + 3), F(c + 4), F(c + 5), F(c + 6), F(c + 7), F(c + 8), F(c + 9),  \
+      F(c + 10), F(c + 11), F(c + 12), F(c + 13), F(c + 14), F(c + 15)
+
+#define TTY_TABLE(F)                                                                               \
+  TTY_ROW(F, 0x00), TTY_ROW(F, 0x10), TTY_ROW(F, 0x20), TTY_ROW(F, 0x30), TTY_ROW(F, 0x40),        \
+      TTY_ROW(F, 0x50), TTY_ROW(F, 0x60), TTY_ROW(F, 0x70), TTY_ROW(F, 0x80), TTY_ROW(F, 0x90),    \
+      TTY_ROW(F, 0xA0), TTY_ROW(F, 0xB0), TTY_ROW(F, 0xC0), TTY_ROW(F, 0xD0), TTY_ROW(F, 0xE0),    \
+      TTY_ROW(F, 0xF0)
+
+/* control characters */
+typedef enum e_tty_ctrl {
+  CT_NONE,
+  CT_NUL,
+  CT_BEL,
+  CT_BS,
+  CT_HT,
+  CT_LF,
+  CT_CR,
+  CT_SO,
+  CT_SI,
+  CT_CAN,
+  CT_ESC,
+  CT_DEL,
+  CT_CSI,
+} tty_ctrl_code;
+
+#define CTRL_CLASS(c)                                                                              \
+  ((c) == 0 ? CT_NUL                                                                               \
+   : (c) == 7 ? CT_BEL                                                                             \
+   : (c) == 8 ? CT_BS                                                                              \
+   : (c) == 9 ? CT_HT                                                                              \
+   : (c) >= 10 && (c) <= 12 ? CT_LF                                                                \
+   : (c) == 13 ? CT_CR                                                                             \
+   : (c) == 14 ? CT_SO                                                                             \
+   : (c) == 15 ? CT_SI                                                                             \
+   : (c) == 24 || (c) == 26 ? CT_CAN                                                               \
+   : (c) == 27 ? CT_ESC                                                                            \
+   : (c) == 127 ? CT_DEL                                                                           \
+   : (c) == 128 + 27 ? CT_CSI                                                                      \
+                     : CT_NONE)
+
+static CONST byte tty_ctrl_class[256] = {TTY_TABLE(CTRL_CLASS)};
+
+static void ctrl_nul(void) {
+}
+
+static void ctrl_bel(void) {
+  if (DState != ESxterm_ignore && DState != ESxterm_title) {
+    BeepHW();
     return;
-  case 10:
-  case 11:
-  case 12:
-    lf();
-    if (!(*Flags & TTY_CRLF))
-      return;
-    /* FALLTHROUGH */
-  case 13:
+  }
+  if (DState == ESxterm_title)
+    set_newtitle();
+  DState = ESnormal;
+}
+
+static void ctrl_bs(void) {
+  bs();
+}
+
+static void ctrl_ht(void) {
+  Pos -= X;
+  while (X < SizeX - 1) {
+    X++;
+    if (TabStop[X >> 5] & (1 << (X & 31)))
+      break;
+  }
+  Pos += X;
+}
+
+static void ctrl_lf(void) {
+  lf();
+  if (*Flags & TTY_CRLF)
     cr();
-    return;
-  case 14:
-    G = 1;
-    setCharset(G1);
-    *Flags |= TTY_DISPCTRL;
-    return;
-  case 15:
-    G = 0;
-    setCharset(G0);
-    *Flags &= ~TTY_DISPCTRL;
-    return;
-  case 24:
-  case 26:
-    DState = ESnormal;
-    return;
-  case 27:
-    DState = ESesc;
-    return;
-  case 127:
-    del();
-    return;
-  case 128 + 27:
-    DState = ESsquare;
-    return;
+}
+
+static void ctrl_cr(void) {
+  cr();
+}
+
+static void ctrl_so(void) {
+  G = 1;
+  setCharset(G1);
+  *Flags |= TTY_DISPCTRL;
+}
+
+static void ctrl_si(void) {
+  G = 0;
+  setCharset(G0);
+  *Flags &= ~TTY_DISPCTRL;
+}
+
+static void ctrl_can(void) {
+  DState = ESnormal;
+}
+
+static void ctrl_esc(void) {
+  DState = ESesc;
+}
+
+static void ctrl_del(void) {
+  del();
+}
+
+static void ctrl_csi(void) {
+  DState = ESsquare;
+}
+
+static void (*CONST tty_ctrl[])(void) = {
+    ctrl_nul, /* CT_NONE */
+    ctrl_nul, /* CT_NUL */
+    ctrl_bel, /* CT_BEL */
+    ctrl_bs,  /* CT_BS */
+    ctrl_ht,  /* CT_HT */
+    ctrl_lf,  /* CT_LF */
+    ctrl_cr,  /* CT_CR */
+    ctrl_so,  /* CT_SO */
+    ctrl_si,  /* CT_SI */
+    ctrl_can, /* CT_CAN */
+    ctrl_esc, /* CT_ESC */
+    ctrl_del, /* CT_DEL */
+    ctrl_csi, /* CT_CSI */
+};
+
+/* final characters of ESC sequences */
+typedef enum e_tty_esc {
+  ESC_NONE,
+  ESC_CSI,
+  ESC_OSC,
+  ESC_PERCENT,
+  ESC_NEL,
+  ESC_RI,
+  ESC_IND,
+  ESC_HTS,
+  ESC_DECID,
+  ESC_DECSC,
+  ESC_DECRC,
+  ESC_G0,
+  ESC_G1,
+  ESC_HASH,
+  ESC_RIS,
+  ESC_DECPNM,
+  ESC_DECPAM,
+} tty_esc_code;
+
+#define ESC_CLASS(c)                                                                               \
+  ((c) == '[' ? ESC_CSI                                                                            \
+   : (c) == ']' ? ESC_OSC                                                                          \
+   : (c) == '%' ? ESC_PERCENT                                                                      \
+   : (c) == 'E' ? ESC_NEL                                                                          \
+   : (c) == 'M' ? ESC_RI                                                                           \
+   : (c) == 'D' ? ESC_IND                                                                          \
+   : (c) == 'H' ? ESC_HTS                                                                          \
+   : (c) == 'Z' ? ESC_DECID                                                                        \
+   : (c) == '7' ? ESC_DECSC                                                                        \
+   : (c) == '8' ? ESC_DECRC                                                                        \
+   : (c) == '(' ? ESC_G0                                                                           \
+   : (c) == ')' ? ESC_G1                                                                           \
+   : (c) == '#' ? ESC_HASH                                                                         \
+   : (c) == 'c' ? ESC_RIS                                                                          \
+   : (c) == '>' ? ESC_DECPNM                                                                       \
+   : (c) == '=' ? ESC_DECPAM                                                                       \
+                : ESC_NONE)
+
+static CONST byte tty_esc_class[256] = {TTY_TABLE(ESC_CLASS)};
+
+static ttystate esc_none(void) {
+  return ESnormal;
+}
+
+static ttystate esc_csi(void) {
+  return ESsquare;
+}
+
+static ttystate esc_osc(void) {
+  return ESnonstd;
+}
+
+static ttystate esc_percent(void) {
+  return ESpercent;
+}
+
+static ttystate esc_nel(void) {
+  cr();
+  lf();
+  return ESnormal;
+}
+
+static ttystate esc_ri(void) {
+  ri();
+  return ESnormal;
+}
+
+static ttystate esc_ind(void) {
+  lf();
+  return ESnormal;
+}
+
+static ttystate esc_hts(void) {
+  TabStop[X >> 5] |= (1 << (X & 31));
+  return ESnormal;
+}
+
+static ttystate esc_decid(void) {
+  respond_ID();
+  return ESnormal;
+}
+
+static ttystate esc_decsc(void) {
+  save_current();
+  return ESnormal;
+}
+
+static ttystate esc_decrc(void) {
+  restore_current();
+  return ESnormal;
+}
+
+static ttystate esc_g0(void) {
+  return ESsetG0;
+}
+
+static ttystate esc_g1(void) {
+  return ESsetG1;
+}
+
+static ttystate esc_hash(void) {
+  return EShash;
+}
+
+static ttystate esc_ris(void) {
+  reset_tty(ttrue);
+  return ESnormal;
+}
+
+static ttystate esc_decpnm(void) { /* Numeric keypad */
+  *Flags &= ~TTY_KBDAPPLIC;
+  *Flags |= TTY_NEEDREFOCUS;
+  return ESnormal;
+}
+
+static ttystate esc_decpam(void) { /* Appl. keypad */
+  *Flags |= TTY_KBDAPPLIC | TTY_NEEDREFOCUS;
+  return ESnormal;
+}
+
+static ttystate (*CONST tty_esc[])(void) = {
+    esc_none,    /* ESC_NONE */
+    esc_csi,     /* ESC_CSI */
+    esc_osc,     /* ESC_OSC */
+    esc_percent, /* ESC_PERCENT */
+    esc_nel,     /* ESC_NEL */
+    esc_ri,      /* ESC_RI */
+    esc_ind,     /* ESC_IND */
+    esc_hts,     /* ESC_HTS */
+    esc_decid,   /* ESC_DECID */
+    esc_decsc,   /* ESC_DECSC */
+    esc_decrc,   /* ESC_DECRC */
+    esc_g0,      /* ESC_G0 */
+    esc_g1,      /* ESC_G1 */
+    esc_hash,    /* ESC_HASH */
+    esc_ris,     /* ESC_RIS */
+    esc_decpnm,  /* ESC_DECPNM */
+    esc_decpam,  /* ESC_DECPAM */
+};
+
+/*
+ * final characters of CSI sequences.
+ * the first ones are also meaningful after CSI ?, see tty_csi_ques[]
+ */
+typedef enum e_tty_csi {
+  CSI_NONE,
+  CSI_SM,
+  CSI_RM,
+  CSI_DA,
+  CSI_DSR,
+  CSI_SGR,
+  CSI_CUP,
+  CSI_ED,
+  CSI_EL,
+  CSI_CHA,
+  CSI_CUU,
+  CSI_CUD,
+  CSI_CUF,
+  CSI_CUB,
+  CSI_CNL,
+  CSI_CPL,
+  CSI_VPA,
+  CSI_IL,
+  CSI_DL,
+  CSI_DCH,
+  CSI_TBC,
+  CSI_DECSTBM,
+  CSI_SCP,
+  CSI_RCP,
+  CSI_ECH,
+  CSI_ICH,
+  CSI_SETTERM,
+} tty_csi_code;
+
+#define CSI_QUES_N (CSI_DA + 1)
+
+/* 'q' is DECLL, but leds are not supported */
+#define CSI_CLASS(c)                                                                               \
+  ((c) == 'h' ? CSI_SM                                                                             \
+   : (c) == 'l' ? CSI_RM                                                                           \
+   : (c) == 'c' ? CSI_DA                                                                           \
+   : (c) == 'n' ? CSI_DSR                                                                          \
+   : (c) == 'm' ? CSI_SGR                                                                          \
+   : (c) == 'H' || (c) == 'f' ? CSI_CUP                                                            \
+   : (c) == 'J' ? CSI_ED                                                                           \
+   : (c) == 'K' ? CSI_EL                                                                           \
+   : (c) == 'G' || (c) == '`' ? CSI_CHA                                                            \
+   : (c) == 'A' ? CSI_CUU                                                                          \
+   : (c) == 'B' || (c) == 'e' ? CSI_CUD                                                            \
+   : (c) == 'C' || (c) == 'a' ? CSI_CUF                                                            \
+   : (c) == 'D' ? CSI_CUB                                                                          \
+   : (c) == 'E' ? CSI_CNL                                                                          \
+   : (c) == 'F' ? CSI_CPL                                                                          \
+   : (c) == 'd' ? CSI_VPA                                                                          \
+   : (c) == 'L' ? CSI_IL                                                                           \
+   : (c) == 'M' ? CSI_DL                                                                           \
+   : (c) == 'P' ? CSI_DCH                                                                          \
+   : (c) == 'g' ? CSI_TBC                                                                          \
+   : (c) == 'r' ? CSI_DECSTBM                                                                      \
+   : (c) == 's' ? CSI_SCP                                                                          \
+   : (c) == 'u' ? CSI_RCP                                                                          \
+   : (c) == 'X' ? CSI_ECH                                                                          \
+   : (c) == '@' ? CSI_ICH                                                                          \
+   : (c) == ']' ? CSI_SETTERM                                                                      \
+                : CSI_NONE)
+
+static CONST byte tty_csi_class[256] = {TTY_TABLE(CSI_CLASS)};
+
+static void csi_none(void) {
+}
+
+static void csi_sm(void) {
+  set_mode(1);
+}
+
+static void csi_rm(void) {
+  set_mode(0);
+}
+
+static void csi_da(void) {
+  if (!Par[0])
+    respond_ID();
+}
+
+/* CSI ? c */
+static void csi_cursor_type(void) {
+  if (!Par[0])
+    Par[1] = Par[2] = Par[0];
+  else if (nPar == 1)
+    Par[2] = 0;
+  Win->CursorType = Par[0] | (Par[1] << 8) | (Par[2] << 16);
+  *Flags |= TTY_UPDATECURSOR;
+}
+
+static void csi_dsr(void) {
+  if (Par[0] == 5)
+    status_report();
+  else if (Par[0] == 6)
+    cursor_report();
+}
+
+static void csi_sgr(void) {
+  csi_m();
+}
+
+static void csi_cup(void) {
+  if (Par[0])
+    Par[0]--;
+  if (!nPar)
+    Par[1] = 0;
+  else if (Par[1])
+    Par[1]--;
+  goto_axy(Par[1], Par[0]);
+}
+
+static void csi_ed(void) {
+  csi_J(Par[0]);
+}
+
+static void csi_el(void) {
+  csi_K(Par[0]);
+}
+
+static void csi_cha(void) {
+  if (Par[0])
+    Par[0]--;
+  goto_xy(Par[0], Y);
+}
+
+static void csi_cuu(void) {
+  if (!Par[0])
+    Par[0]++;
+  goto_xy(X, Y - Par[0]);
+}
+
+static void csi_cud(void) {
+  if (!Par[0])
+    Par[0]++;
+  goto_xy(X, Y + Par[0]);
+}
+
+static void csi_cuf(void) {
+  if (!Par[0])
+    Par[0]++;
+  goto_xy(X + Par[0], Y);
+}
+
+static void csi_cub(void) {
+  if (!Par[0])
+    Par[0]++;
+  goto_xy(X - Par[0], Y);
+}
+
+static void csi_cnl(void) {
+  if (!Par[0])
+    Par[0]++;
+  goto_xy(0, Y + Par[0]);
+}
+
+static void csi_cpl(void) {
+  if (!Par[0])
+    Par[0]++;
+  goto_xy(0, Y - Par[0]);
+}
+
+static void csi_vpa(void) {
+  if (Par[0])
+    Par[0]--;
+  goto_axy(X, Par[0]);
+}
+
+static void csi_il(void) {
+  csi_L(Par[0]);
+}
+
+static void csi_dl(void) {
+  csi_M(Par[0]);
+}
+
+static void csi_dch(void) {
+  csi_P(Par[0]);
+}
+
+static void csi_tbc(void) {
+  if (!Par[0])
+    TabStop[X >> 5] &= ~(1 << (X & 31));
+  else if (Par[0] == 3)
+    TabStop[0] = TabStop[1] = TabStop[2] = TabStop[3] = TabStop[4] = 0;
+}
+
+static void csi_decstbm(void) {
+  if (!Par[0])
+    Par[0]++;
+  if (!nPar || !Par[1])
+    Par[1] = SizeY;
+  /* Minimum allowed region is 2 lines */
+  if (Par[0] < Par[1] && SizeY >= 0 && Par[1] <= (uldat)SizeY) {
+    Top = Par[0] - 1;
+    Bottom = Par[1];
+    goto_axy(0, 0);
   }
+}
 
-  /* DState machine */
+static void csi_scp(void) {
+  save_current();
+}
 
-  /* mask out ESques for now */
-  switch (DState & ESany) {
+static void csi_rcp(void) {
+  restore_current();
+}
 
-  case ESesc:
-    switch (c) {
-    case '[':
-      DState = ESsquare;
-      return;
-    case ']':
-      DState = ESnonstd;
-      return;
-    case '%':
-      DState = ESpercent;
-      return;
-    case 'E':
-      cr();
-      lf();
-      break;
-    case 'M':
-      ri();
-      break;
-    case 'D':
-      lf();
-      break;
-    case 'H':
-      TabStop[X >> 5] |= (1 << (X & 31));
-      break;
-    case 'Z':
-      respond_ID();
-      break;
-    case '7':
-      save_current();
-      break;
-    case '8':
-      restore_current();
-      break;
-    case '(':
-      DState = ESsetG0;
-      return;
-    case ')':
-      DState = ESsetG1;
-      return;
-    case '#':
-      DState = EShash;
-      return;
-    case 'c':
-      reset_tty(ttrue);
-      break;
-    case '>': /* Numeric keypad */
-      *Flags &= ~TTY_KBDAPPLIC;
-      *Flags |= TTY_NEEDREFOCUS;
-      break;
-    case '=': /* Appl. keypad */
-      *Flags |= TTY_KBDAPPLIC | TTY_NEEDREFOCUS;
-      break;
-    }
-    break;
+static void csi_ech(void) {
+  csi_X(Par[0]);
+}
 
-  case ESnonstd:
-    if (c == 'P') { /* Palette escape sequence */
-      nPar = 0;
-      memset((byte *)&Par, 0, NPAR * sizeof(ldat));
-      DState = ESrgb;
-      return;
-    } else if (c == 'R') /* Reset palette */
-      ResetPaletteHW();
-    else if (c == '1') {
-      /* may be xterm set window icon title */
-      DState = ESxterm_ignore_;
-      return;
-    } else if (c == '0' || c == '2' || c == '7') {
-      /* may be xterm "set icon name & window title" or xterm "set window title" or OS X "set
-       * current directory title"
-       */
-      DState = ESxterm_title_;
-      return;
-    }
-    break;
+static void csi_ich(void) {
+  csi_at(Par[0]);
+}
 
-  case ESrgb:
-    if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f')) {
-      Par[nPar++] = (c > '9' ? (c & 0xDF) - 'A' + 10 : c - '0');
-      if (nPar == 7)
-        SetPaletteHW(Par[0], Par[1] * 16 + Par[2], Par[3] * 16 + Par[4], Par[5] * 16 + Par[6]);
-      else
-        return; /* avoid resetting DState */
-    }
-    break;
+static void csi_setterm(void) {
+  setterm_command();
+}
 
-  case ESsquare:
-    Par[0] = nPar = 0;
-    /*memset((byte *)&Par, 0, NPAR * sizeof(ldat));*/
-    DState = ESgetpars;
-    if (c == '[') { /* Function key */
-      DState = ESfunckey;
-      return;
-    }
-    if (c == '?') {
-      DState = (ttystate)(DState | ESques);
-      return;
-    }
-    /* FALLTHROUGH */
+static void (*CONST tty_csi[])(void) = {
+    csi_none,    /* CSI_NONE */
+    csi_sm,      /* CSI_SM */
+    csi_rm,      /* CSI_RM */
+    csi_da,      /* CSI_DA */
+    csi_dsr,     /* CSI_DSR */
+    csi_sgr,     /* CSI_SGR */
+    csi_cup,     /* CSI_CUP */
+    csi_ed,      /* CSI_ED */
+    csi_el,      /* CSI_EL */
+    csi_cha,     /* CSI_CHA */
+    csi_cuu,     /* CSI_CUU */
+    csi_cud,     /* CSI_CUD */
+    csi_cuf,     /* CSI_CUF */
+    csi_cub,     /* CSI_CUB */
+    csi_cnl,     /* CSI_CNL */
+    csi_cpl,     /* CSI_CPL */
+    csi_vpa,     /* CSI_VPA */
+    csi_il,      /* CSI_IL */
+    csi_dl,      /* CSI_DL */
+    csi_dch,     /* CSI_DCH */
+    csi_tbc,     /* CSI_TBC */
+    csi_decstbm, /* CSI_DECSTBM */
+    csi_scp,     /* CSI_SCP */
+    csi_rcp,     /* CSI_RCP */
+    csi_ech,     /* CSI_ECH */
+    csi_ich,     /* CSI_ICH */
+    csi_setterm, /* CSI_SETTERM */
+};
+
+static void (*CONST tty_csi_ques[CSI_QUES_N])(void) = {
+    csi_none,
+    csi_sm,
+    csi_rm,
+    csi_cursor_type,
+};
+
+/* states: consume c and return the next state */
+
+static ttystate state_end(byte c) {
+  return ESnormal;
+}
 
-  case ESgetpars:
-    if (c == ';' && nPar < NPAR - 1) {
-      Par[++nPar] = 0;
-      return;
-    } else if (c >= '0' && c <= '9') {
-      Par[nPar] *= 10;
-      Par[nPar] += c - '0';
-      return;
-    } else
-      DState = (ttystate)(ESgotpars | (DState & ESques));
-    /* FALLTHROUGH */
+static ttystate state_esc(byte c) {
+  return tty_esc[tty_esc_class[c]]();
+}
 
-  case ESgotpars:
-    switch (c) {
-    case 'h':
-      set_mode(1);
-      break;
-    case 'l':
-      set_mode(0);
-      break;
-    case 'c':
-      if (DState & ESques) {
-        if (!Par[0])
-          Par[1] = Par[2] = Par[0];
-        else if (nPar == 1)
-          Par[2] = 0;
-        Win->CursorType = Par[0] | (Par[1] << 8) | (Par[2] << 16);
-        *Flags |= TTY_UPDATECURSOR;
-      }
-    case 'm':
-      /* selection complement mask */
-      break;
-    case 'n':
-      if (!(DState & ESques)) {
-        if (Par[0] == 5)
-          status_report();
-        else if (Par[0] == 6)
-          cursor_report();
-      }
-      break;
-    }
-    if (DState & ESques)
-      break;
+static ttystate state_gotpars(byte c) {
+  byte k = tty_csi_class[c];
 
-    switch (c) {
-    case 'm':
-      csi_m();
-      break;
-    case 'H':
-    case 'f':
-      if (Par[0])
-        Par[0]--;
-      if (!nPar)
-        Par[1] = 0;
-      else if (Par[1])
-        Par[1]--;
-      goto_axy(Par[1], Par[0]);
-      break;
-    case 'J':
-      csi_J(Par[0]);
-      break;
-    case 'K':
-      csi_K(Par[0]);
-      break;
-    case 'G':
-    case '`':
-      if (Par[0])
-        Par[0]--;
-      goto_xy(Par[0], Y);
-      break;
-    case 'A':
-      if (!Par[0])
-        Par[0]++;
-      goto_xy(X, Y - Par[0]);
-      break;
-    case 'B':
-    case 'e':
-      if (!Par[0])
-        Par[0]++;
-      goto_xy(X, Y + Par[0]);
-      break;
-    case 'C':
-    case 'a':
-      if (!Par[0])
-        Par[0]++;
-      goto_xy(X + Par[0], Y);
-      break;
-    case 'D':
-      if (!Par[0])
-        Par[0]++;
-      goto_xy(X - Par[0], Y);
-      break;
-    case 'E':
-      if (!Par[0])
-        Par[0]++;
-      goto_xy(0, Y + Par[0]);
-      break;
-    case 'F':
-      if (!Par[0])
-        Par[0]++;
-      goto_xy(0, Y - Par[0]);
-      break;
-    case 'd':
-      if (Par[0])
-        Par[0]--;
-      goto_axy(X, Par[0]);
-      break;
-    case 'L':
-      csi_L(Par[0]);
-      break;
-    case 'M':
-      csi_M(Par[0]);
-      break;
-    case 'P':
-      csi_P(Par[0]);
-      break;
-    case 'c':
-      if (!Par[0])
-        respond_ID();
-      break;
-    case 'g':
-      if (!Par[0])
-        TabStop[X >> 5] &= ~(1 << (X & 31));
-      else if (Par[0] == 3)
-        TabStop[0] = TabStop[1] = TabStop[2] = TabStop[3] = TabStop[4] = 0;
-      break;
-    case 'q': /* DECLL - but only 3 leds */
-              /* map 0,1,2,3 to 0,1,2,4 */
-#if 0
-	    if (Par[0] < 4)
-		setledstate(kbd_table,
-			    (Par[0] < 3) ? Par[0] : 4);
-#endif
-      break;
-    case 'r':
-      if (!Par[0])
-        Par[0]++;
-      if (!nPar || !Par[1])
-        Par[1] = SizeY;
-      /* Minimum allowed region is 2 lines */
-      if (Par[0] < Par[1] && SizeY >= 0 && Par[1] <= (uldat)SizeY) {
-        Top = Par[0] - 1;
-        Bottom = Par[1];
-        goto_axy(0, 0);
-      }
-      break;
-    case 's':
-      save_current();
-      break;
-    case 'u':
-      restore_current();
-      break;
-    case 'X':
-      csi_X(Par[0]);
-      break;
-    case '@':
-      csi_at(Par[0]);
-      break;
-    case ']': /* setterm functions */
-      setterm_command();
-      break;
-    }
-    break;
+  if (!(DState & ESques))
+    tty_csi[k]();
+  else if (k < CSI_QUES_N)
+    tty_csi_ques[k]();
+  return ESnormal;
+}
 
-  case ESpercent:
-    switch (c) {
-    case '@': /* defined in ISO 2022 */
-      utf8 = 0;
-      break;
-    case 'G': /* prelim official escape code */
-    case '8': /* retained for compatibility */
-      utf8 = 1;
-      break;
-    }
-    break;
-  case ESfunckey:
-    break;
+static ttystate state_getpars(byte c) {
+  if (c == ';' && nPar < NPAR - 1) {
+    Par[++nPar] = 0;
+    return DState;
+  } else if (c >= '0' && c <= '9') {
+    Par[nPar] *= 10;
+    Par[nPar] += c - '0';
+    return DState;
+  }
+  DState = (ttystate)(ESgotpars | (DState & ESques));
+  return state_gotpars(c);
+}
 
-  case EShash:
-    if (c == '8') {
-      /* DEC screen alignment test */
-      dirty_tty(0, 0, SizeX - 1, SizeY - 1);
-      fill(Start, TCELL(ColText, 'E'), (ldat)SizeX * SizeY);
-    }
-    break;
+static ttystate state_square(byte c) {
+  Par[0] = nPar = 0;
+  /*memset((byte *)&Par, 0, NPAR * sizeof(ldat));*/
+  if (c == '[') /* Function key */
+    return ESfunckey;
+  if (c == '?')
+    return (ttystate)(ESgetpars | ESques);
+  DState = ESgetpars;
+  return state_getpars(c);
+}
 
-  case ESsetG0:
-    switch (c) {
-    case '0':
-      G0 = VT100GR_MAP;
-      break;
-    case 'B':
-      G0 = LATIN1_MAP;
-      break;
-    case 'U':
-      G0 = IBMPC_MAP;
-      break;
-    case 'K':
-      G0 = USER_MAP;
-      break;
-    default:
-      break;
-    }
-    if (G == 0)
-      setCharset(G0);
-    break;
+static ttystate state_hash(byte c) {
+  if (c == '8') {
+    /* DEC screen alignment test */
+    dirty_tty(0, 0, SizeX - 1, SizeY - 1);
+    fill(Start, TCELL(ColText, 'E'), (ldat)SizeX * SizeY);
+  }
+  return ESnormal;
+}
 
-  case ESsetG1:
-    switch (c) {
-    case '0':
-      G1 = VT100GR_MAP;
-      break;
-    case 'B':
-      G1 = LATIN1_MAP;
-      break;
-    case 'U':
-      G1 = IBMPC_MAP;
-      break;
-    case 'K':
-      G1 = USER_MAP;
-      break;
-    default:
-      break;
-    }
-    if (G == 1)
-      setCharset(G1);
-    break;
+#define CHARSET_NONE 0xFF
 
-  case ESxterm_ignore_:
-    if (c == ';') {
-      DState = ESxterm_ignore;
-      return;
-    }
-    break;
+#define CHARSET_CLASS(c)                                                                           \
+  ((c) == '0' ? VT100GR_MAP                                                                        \
+   : (c) == 'B' ? LATIN1_MAP                                                                       \
+   : (c) == 'U' ? IBMPC_MAP                                                                        \
+   : (c) == 'K' ? USER_MAP                                                                         \
+                : CHARSET_NONE)
 
-  case ESxterm_ignore:
-    /* ignore, cannot set icon name */
-    return;
+static CONST byte tty_charset_class[256] = {TTY_TABLE(CHARSET_CLASS)};
 
-  case ESxterm_title_:
-    if (c == ';') {
-      DState = ESxterm_title;
-      return;
-    }
-    break;
+static ttystate state_setG0(byte c) {
+  if (tty_charset_class[c] != CHARSET_NONE)
+    G0 = tty_charset_class[c];
+  if (G == 0)
+    setCharset(G0);
+  return ESnormal;
+}
 
-  case ESxterm_title:
-    if (c >= ' ' && insert_newtitle(c))
-      return;
-    break;
+static ttystate state_setG1(byte c) {
+  if (tty_charset_class[c] != CHARSET_NONE)
+    G1 = tty_charset_class[c];
+  if (G == 1)
+    setCharset(G1);
+  return ESnormal;
+}
 
-  default:
-    break;
+static ttystate state_percent(byte c) {
+  if (c == '@') /* defined in ISO 2022 */
+    utf8 = 0;
+  else if (c == 'G' || c == '8') /* prelim official escape code, retained for compatibility */
+    utf8 = 1;
+  return ESnormal;
+}
+
+static ttystate state_nonstd(byte c) {
+  if (c == 'P') { /* Palette escape sequence */
+    nPar = 0;
+    memset((byte *)&Par, 0, NPAR * sizeof(ldat));
+    return ESrgb;
+  } else if (c == 'R') /* Reset palette */
+    ResetPaletteHW();
+  else if (c == '1')
+    /* may be xterm set window icon title */
+    return ESxterm_ignore_;
+  else if (c == '0' || c == '2' || c == '7')
+    /* may be xterm "set icon name & window title" or xterm "set window title" or OS X "set
+     * current directory title"
+     */
+    return ESxterm_title_;
+  return ESnormal;
+}
+
+static ttystate state_rgb(byte c) {
+  if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f')) {
+    Par[nPar++] = (c > '9' ? (c & 0xDF) - 'A' + 10 : c - '0');
+    if (nPar == 7)
+      SetPaletteHW(Par[0], Par[1] * 16 + Par[2], Par[3] * 16 + Par[4], Par[5] * 16 + Par[6]);
+    else
+      return ESrgb;
   }
+  return ESnormal;
+}
 
-  if (newName)
+static ttystate state_xterm_ignore_(byte c) {
+  return c == ';' ? ESxterm_ignore : ESnormal;
+}
+
+static ttystate state_xterm_ignore(byte c) {
+  /* ignore, cannot set icon name */
+  return ESxterm_ignore;
+}
+
+static ttystate state_xterm_title_(byte c) {
+  return c == ';' ? ESxterm_title : ESnormal;
+}
+
+static ttystate state_xterm_title(byte c) {
+  if (c >= ' ' && insert_newtitle(c))
+    return ESxterm_title;
+  return ESnormal;
+}
+
+/* in the order of ttystate */
+static ttystate (*CONST tty_state[])(byte c) = {
+    state_end,           /* ESnormal */
+    state_esc,           /* ESesc */
+    state_square,        /* ESsquare */
+    state_getpars,       /* ESgetpars */
+    state_gotpars,       /* ESgotpars */
+    state_end,           /* ESfunckey */
+    state_hash,          /* EShash */
+    state_setG0,         /* ESsetG0 */
+    state_setG1,         /* ESsetG1 */
+    state_percent,       /* ESpercent */
+    state_end,           /* ESignore */
+    state_nonstd,        /* ESnonstd */
+    state_rgb,           /* ESrgb */
+    state_xterm_ignore_, /* ESxterm_ignore_ */
+    state_xterm_ignore,  /* ESxterm_ignore */
+    state_xterm_title_,  /* ESxterm_title_ */
+    state_xterm_title,   /* ESxterm_title */
+};
+
+INLINE void write_ctrl(byte c) {
+  ttystate next;
+  byte k;
+
+  /*
+   *  Control characters can be used in the _middle_
+   *  of an escape sequence.
+   */
+  if ((k = tty_ctrl_class[c]) != CT_NONE) {
+    tty_ctrl[k]();
+    return;
+  }
+
+  /* mask out ESques, the states needing it check DState */
+  if ((next = tty_state[DState & ESany](c)) == ESnormal && newName)
     clear_newtitle();
+  DState = next;
+}
 
-  DState = ESnormal;
+/*
+ * accumulate the parameters of a CSI sequence from s[0 ... len-1],
+ * as state_getpars() would one byte at a time. return the number of bytes consumed
+ */
+static uldat write_params(CONST byte *s, uldat len) {
+  uldat i, n = nPar, p = Par[n];
+  byte d;
+
+  for (i = 0; i < len; i++) {
+    if ((d = (byte)(s[i] - '0')) < 10)
+      p = p * 10 + d;
+    else if (s[i] == ';' && n < NPAR - 1) {
+      Par[n++] = p;
+      p = 0;
+    } else
+      break;
+  }
+  Par[n] = p;
+  nPar = n;
+  return i;
 }
 
 widget TtyKbdFocus(widget newW) {
@@ -1513,9 +1834,85 @@ static tbool combine_utf8(trune *pc) {
   return tfalse;
 }
 
+/* max characters decoded at once by write_text_run() */
+#define TTY_RUN_MAX 256
+
+/* room left for printable text in the current row, after text_room() wrapped if needed */
+INLINE dat text_width(void) {
+  return *Flags & TTY_NEEDWRAP ? SizeX : SizeX - X;
+}
+
+/* before writing printable text: wrap if needed, and return the room left in the current row */
+INLINE dat text_room(void) {
+  if (*Flags & TTY_NEEDWRAP) {
+    cr();
+    lf();
+  }
+  return SizeX - X;
+}
+
+/*
+ * write n cells at the cursor, which must all fit in the current row: their characters
+ * are buf[0 ... n-1] if buf is not NULL, otherwise s[0 ... n-1] translated with applyG().
+ * same as writing them one by one, but with a single dirty_tty()
+ */
+static void write_cells(CONST trune *buf, CONST byte *s, dat n) {
+  tcell *p = Pos;
+  tcolor col = Color;
+  dat i;
+
+  dirty_tty(X, Y, X + n - 1, Y);
+
+  if (buf) {
+    for (i = 0; i < n; i++)
+      p[i] = TCELL(col, buf[i]);
+  } else {
+    for (i = 0; i < n; i++)
+      p[i] = TCELL(col, applyG(s[i]));
+  }
+
+  if (X + n == SizeX) {
+    X = SizeX - 1;
+    Pos = p + n - 1;
+    if (*Flags & TTY_AUTOWRAP)
+      *Flags |= TTY_NEEDWRAP;
+  } else {
+    X += n;
+    Pos = p + n;
+  }
+}
+
+/*
+ * fast path of TtyWriteAscii(): write the printable text at the beginning of s[0 ... len-1],
+ * up to the end of the current row. in UTF-8 mode, decode it in bulk.
+ * return the number of bytes written, or 0 if s does not start with printable text
+ * or a partial UTF-8 sequence is pending: the caller then decodes it one byte at a time.
+ */
+static uldat write_text_run(CONST byte *s, uldat len) {
+  trune buf[TTY_RUN_MAX];
+  uldat n, used, max = (uldat)text_width();
+
+  if (utf8 && !(*Flags & TTY_DISPCTRL)) {
+    if (utf8_count)
+      return 0;
+    /* used may be > 0 even if n == 0, when only invalid bytes were dropped */
+    if ((n = Utf8Decode(s, len, buf, Min2(max, TTY_RUN_MAX), &used)) != 0) {
+      text_room();
+      write_cells(buf, s, (dat)n);
+    }
+    return used;
+  }
+  if (!(n = Utf8AsciiRun(s, Min2(len, max))))
+    return 0;
+  text_room();
+  write_cells(NULL, s, (dat)n);
+  return n;
+}
+
 /* this is the main entry point */
 byte TtyWriteAscii(window Window, uldat Len, CONST char *AsciiSeq) {
   trune c;
+  uldat n;
   byte printable, utf8_in_use, disp_ctrl, state_normal;
 
   if (!Window || !W_USE(Window, USECONTENTS) || !Window->USE.C.TtyData)
@@ -1526,6 +1923,20 @@ byte TtyWriteAscii(window Window, uldat Len, CONST char *AsciiSeq) {
   common(Window);
 
   while (!(*Flags & TTY_STOPPED) && Len) {
+    /* runs of printable text are by far the most common case: write them in bulk */
+    if (DState == ESnormal && !(*Flags & (TTY_INSERT | TTY_SETMETA)) &&
+        (n = write_text_run((CONST byte *)AsciiSeq, Len)) != 0) {
+      AsciiSeq += n;
+      Len -= n;
+      continue;
+    }
+    /* and so are the parameters of CSI sequences */
+    if ((DState & ESany) == ESgetpars && (n = write_params((CONST byte *)AsciiSeq, Len)) != 0) {
+      AsciiSeq += n;
+      Len -= n;
+      continue;
+    }
+
     c = (byte)*AsciiSeq++;
     Len--;
 
@@ -1648,7 +2059,7 @@ byte TtyWriteTRune(window Window, uldat Len, CONST trune *TRune) {
  * (not even ESC or \n) and using current translation.
  */
 byte TtyWriteString(window Window, uldat Len, CONST char *String) {
-  trune c;
+  uldat n;
 
   if (!Window || !W_USE(Window, USECONTENTS) || !Window->USE.C.TtyData)
     return tfalse;
@@ -1657,27 +2068,12 @@ byte TtyWriteString(window Window, uldat Len, CONST char *String) {
 
   common(Window);
 
+  /* every byte is a cell: write a row at time */
   while (!(*Flags & TTY_STOPPED) && Len) {
-    c = applyG(*String++);
-
-    Len--;
-
-    /* Now try to find out how to display it */
-    if (*Flags & TTY_NEEDWRAP) {
-      cr();
-      lf();
-    }
-
-    dirty_tty(X, Y, X, Y);
-    *Pos = TCELL(Color, c);
-
-    if (X == SizeX - 1) {
-      if (*Flags & TTY_AUTOWRAP)
-        *Flags |= TTY_NEEDWRAP;
-    } else {
-      X++;
-      Pos++;
-    }
+    n = Min2(Len, (uldat)text_room());
+    write_cells(NULL, (CONST byte *)String, (dat)n);
+    String += n;
+    Len -= n;
   }
   flush_tty();
   return ttrue;
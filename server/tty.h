@@ -84,9 +84,14 @@ struct s_ttydata {
   dat Top, Bottom;  /* Y scrolling region. default 0...SizeY-1 */
   dat X, Y;         /* Cursor position in visible buffer */
   dat saveX, saveY;
-  tcell *Start, *Split; /* Start and Split of visible buffer */
-                        /* AfterSplit is just Window->Contents */
+  tcell *Start, *Split; /* first visible line and end of the ring of lines, */
+                        /* which starts at Window->Contents and may have more than SizeY lines */
   tcell *Pos;           /* Pointer to cursor position in buffer */
+  dat *DirtyX1, *DirtyX2; /* first and last damaged column of each row, DirtyMax rows */
+  dat DirtyMax;
+  dat DirtyY1, DirtyY2; /* damaged rows, none if DirtyY1 > DirtyY2. rows outside are undefined */
+  window DirtyNext;     /* next window in TtyDirty list, see draw.h */
+  byte DirtyQueued;
   tcolor Color, DefColor, saveColor, Underline, HalfInten;
   uldat TabStop[5];
   uldat nPar, Par[NPAR];
@@ -0,0 +1,156 @@
+/*
+ *  utf8.h  --  bulk UTF-8 decoding
+ *
+ *  Copyright (C) 2000-2020 by Massimiliano Ghilardi
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ */
+
+#ifndef _TWIN_UTF8_H
+#define _TWIN_UTF8_H
+
+/*
+ * small kernels used by the terminal emulator to decode whole chunks of text
+ * instead of feeding a byte-at-a-time state machine.
+ *
+ * Utf8AsciiRun() returns the number of leading bytes that are printable ASCII
+ * Utf8Decode()   decodes text exactly as the byte-at-a-time decoder of tty.c does,
+ *                i.e. dropping invalid bytes and interrupted sequences and keeping
+ *                overlong ones, up to the first byte it cannot decode by itself
+ *
+ * both stop at control characters (C0 and DEL, plus CSI for Utf8Decode()), and Utf8Decode()
+ * also stops at sequences truncated by the end of the text: callers handle them, and sequences
+ * split across two writes, with their own byte-at-a-time decoder.
+ *
+ * ASCII is checked and widened 16 bytes at a time if the compiler targets SSE2,
+ * multi-byte sequences are decoded one at a time in the same loop, so that text mixing
+ * the two does not pay for switching between them.
+ */
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define TW_UTF8_SSE2
+#endif
+
+#ifdef TW_UTF8_SSE2
+
+/* return the mask of printable ASCII bytes among s[0 ... 15] */
+INLINE unsigned int Utf8AsciiMask(CONST byte *s) {
+  __m128i v = _mm_loadu_si128((CONST __m128i *)s);
+  /* signed compares: bytes >= 0x80 are negative, so they fail v > 0x1F */
+  __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)),
+                             _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F)));
+  return (unsigned int)_mm_movemask_epi8(ok);
+}
+
+/* d[0 ... 15] = s[0 ... 15], which must be ASCII */
+INLINE void Utf8WidenAscii16(CONST byte *s, trune *d) {
+  __m128i zero = _mm_setzero_si128(), v = _mm_loadu_si128((CONST __m128i *)s);
+  __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+
+  _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(lo, zero));
+  _mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(lo, zero));
+  _mm_storeu_si128((__m128i *)(d + 8), _mm_unpacklo_epi16(hi, zero));
+  _mm_storeu_si128((__m128i *)(d + 12), _mm_unpackhi_epi16(hi, zero));
+}
+
+#endif /* TW_UTF8_SSE2 */
+
+INLINE uldat Utf8AsciiRun(CONST byte *s, uldat len) {
+  uldat i = 0;
+#ifdef TW_UTF8_SSE2
+  unsigned int m;
+
+  for (; i + 16 <= len; i += 16) {
+    if ((m = Utf8AsciiMask(s + i)) != 0xFFFF)
+      return i + __builtin_ctz(~m);
+  }
+#endif
+  while (i < len && s[i] >= 0x20 && s[i] < 0x7F)
+    i++;
+  return i;
+}
+
+/*
+ * decode printable text from s[0 ... len-1] into d[0 ... max-1].
+ * return the number of runes written, and store in *used the number of bytes decoded.
+ */
+INLINE uldat Utf8Decode(CONST byte *s, uldat len, trune *d, uldat max, uldat *used) {
+  uldat i = 0, n = 0, j;
+  trune c;
+  byte b;
+
+  while (i < len && n < max) {
+    b = s[i];
+    if (b < 0x80) {
+      if (b < 0x20 || b == 0x7F)
+        break;
+#ifdef TW_UTF8_SSE2
+      if (i + 16 <= len && n + 16 <= max && s[i + 1] >= 0x20 && s[i + 1] < 0x7F) {
+        /* widen 16 bytes, and keep those up to the first that is not printable ASCII */
+        unsigned int m = ~Utf8AsciiMask(s + i) & 0xFFFF;
+        j = m ? (uldat)__builtin_ctz(m) : 16;
+        Utf8WidenAscii16(s + i, d + n);
+        i += j, n += j;
+        continue;
+      }
+#endif
+      do
+        d[n++] = s[i++];
+      while (i < len && n < max && s[i] >= 0x20 && s[i] < 0x7F);
+      continue;
+    }
+    if (b < 0xC0 || b >= 0xF8) {
+      /* continuation byte without a lead byte, or invalid byte: dropped */
+      i++;
+      continue;
+    }
+    /*
+     * lead byte followed by 1 to 3 continuation bytes. if the text ends before them, stop:
+     * the caller keeps the partial sequence. if another byte comes before them, drop
+     * the partial sequence and go on from that byte
+     */
+    if (b < 0xE0) {
+      if (i + 1 >= len)
+        break;
+      if ((s[i + 1] & 0xC0) != 0x80) {
+        i++;
+        continue;
+      }
+      c = ((trune)(b & 0x1F) << 6) | (s[i + 1] & 0x3F);
+      j = 2;
+    } else if (b < 0xF0) {
+      if (i + 2 >= len)
+        break;
+      if ((s[i + 1] & 0xC0) != 0x80 || (s[i + 2] & 0xC0) != 0x80) {
+        i += (s[i + 1] & 0xC0) != 0x80 ? 1 : 2;
+        continue;
+      }
+      c = ((trune)(b & 0x0F) << 12) | ((trune)(s[i + 1] & 0x3F) << 6) | (s[i + 2] & 0x3F);
+      j = 3;
+    } else {
+      c = b & 0x07;
+      for (j = 1; j < 4 && i + j < len && (s[i + j] & 0xC0) == 0x80; j++)
+        c = (c << 6) | (s[i + j] & 0x3F);
+      if (j < 4) {
+        if (i + j >= len)
+          break;
+        i += j;
+        continue;
+      }
+    }
+    if (c < 0x20 || c == 0x7F || c == 0x9B)
+      /* control character, possibly from an overlong sequence */
+      break;
+    d[n++] = c;
+    i += j;
+  }
+  *used = i;
+  return n;
+}
+
+#endif /* _TWIN_UTF8_H */
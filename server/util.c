@@ -43,6 +43,7 @@
 #include "printk.h"
 #include "privilege.h"
 #include "util.h"
+#include "hist.h"
 
 #include "hw.h"
 
@@ -384,7 +385,7 @@ byte SetSelectionFromWindow(window Window) {
   }
 
   if (w_useC) {
-    tcell *hw;
+    CONST tcell *hw;
 
     /* normalize negative coords */
     if (Window->XendSel < 0) {
@@ -404,10 +405,6 @@ byte SetSelectionFromWindow(window Window) {
     if (!(sData = (trune *)AllocMem(sizeof(trune) * (slen = Window->WLogic))))
       return tfalse;
 
-    hw = Window->USE.C.Contents + (Window->YstSel + Window->USE.C.HSplit) * slen;
-    while (hw >= Window->USE.C.TtyData->Split)
-      hw -= Window->USE.C.TtyData->Split - Window->USE.C.Contents;
-
     {
       y = Window->YstSel;
       if (y < Window->YendSel)
@@ -416,19 +413,15 @@ byte SetSelectionFromWindow(window Window) {
         slen = Window->XendSel - Window->XstSel + 1;
       Data = sData;
       len = slen;
-      hw += Window->XstSel;
+      hw = ContentsLine(Window, y) + Window->XstSel;
       while (len--)
         *Data++ = TRUNE(*hw), hw++;
       ok &= SelectionStore(_SEL_MAGIC, NULL, slen * sizeof(trune), (CONST char *)sData);
     }
 
-    if (hw >= Window->USE.C.TtyData->Split)
-      hw -= Window->USE.C.TtyData->Split - Window->USE.C.Contents;
-
     slen = Window->WLogic;
     for (y = Window->YstSel + 1; ok && y < Window->YendSel; y++) {
-      if (hw >= Window->USE.C.TtyData->Split)
-        hw -= Window->USE.C.TtyData->Split - Window->USE.C.Contents;
+      hw = ContentsLine(Window, y);
       Data = sData;
       len = slen;
       while (len--)
@@ -437,8 +430,7 @@ byte SetSelectionFromWindow(window Window) {
     }
 
     if (ok && Window->YendSel > Window->YstSel) {
-      if (hw >= Window->USE.C.TtyData->Split)
-        hw -= Window->USE.C.TtyData->Split - Window->USE.C.Contents;
+      hw = ContentsLine(Window, Window->YendSel);
       Data = sData;
       len = slen = Window->XendSel + 1;
       while (len--)